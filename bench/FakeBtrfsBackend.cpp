@@ -0,0 +1,393 @@
+#include "FakeBtrfsBackend.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QXmlStreamWriter>
+
+#include <algorithm>
+#include <cerrno>
+
+namespace {
+
+// The snapshot dates count forward from here so the data doesn't depend on when the benchmark runs
+constexpr qint64 FIRST_SNAPSHOT_TIME = 1700000000;
+
+/**
+ * @brief Returns the id of the closest subvolume in @p subvolumes that @p name is nested in
+ */
+uint64_t findParentId(const SubvolumeMap &subvolumes, const QString &name)
+{
+    QString parentName = name;
+    while (true) {
+        const qsizetype slash = parentName.lastIndexOf('/');
+        if (slash < 0) {
+            return BTRFS_ROOT_ID;
+        }
+
+        parentName.truncate(slash);
+        const uint64_t id = subvolumes.idOf(parentName);
+        if (id != 0) {
+            return id;
+        }
+    }
+}
+
+} // namespace
+
+FakeBtrfsBackend::FakeBtrfsBackend(const QString &rootPath) : m_rootPath(QDir::cleanPath(rootPath)) {}
+
+QString FakeBtrfsBackend::addFilesystem()
+{
+    const QString uuid = QUuid::createUuid().toString(QUuid::WithoutBraces);
+
+    Filesystem filesystem;
+    filesystem.mountpoint = QDir(m_rootPath).filePath(uuid);
+    QDir().mkpath(filesystem.mountpoint);
+
+    Subvolume root;
+    root.id = BTRFS_ROOT_ID;
+    root.uuid = QUuid::createUuid();
+    root.generation = filesystem.generation;
+    root.filesystemUuid = uuid;
+    root.createdAt = FIRST_SNAPSHOT_TIME;
+    filesystem.subvolumes.insert(root);
+
+    m_filesystems.insert(uuid, filesystem);
+    return uuid;
+}
+
+void FakeBtrfsBackend::addSnapperSnapshots(const QString &uuid, const QString &target, int count)
+{
+    const auto it = m_filesystems.constFind(uuid);
+    if (it == m_filesystems.cend() || (!target.isEmpty() && it->subvolumes.idOf(target) == 0)) {
+        return;
+    }
+
+    const QUuid targetUuid = it->subvolumes.value(it->subvolumes.idOf(target)).uuid;
+    const QString snapshotsName = target.isEmpty() ? QStringLiteral(".snapshots") : target + QStringLiteral("/.snapshots");
+    if (it->subvolumes.idOf(snapshotsName) == 0) {
+        addSubvolume(uuid, snapshotsName);
+    }
+
+    // The snapshots are at <number>/snapshot and the numbered directories aren't subvolumes
+    uint number = 0;
+    const QList<uint64_t> existing = m_filesystems[uuid].subvolumes.childrenOf(m_filesystems[uuid].subvolumes.idOf(snapshotsName));
+    for (const uint64_t id : existing) {
+        number = std::max(number, m_filesystems[uuid].subvolumes.value(id).subvolName.section('/', -2, -2).toUInt());
+    }
+
+    for (int i = 0; i < count; ++i) {
+        ++number;
+        addSubvolume(uuid, snapshotsName + '/' + QString::number(number) + QStringLiteral("/snapshot"), targetUuid, true);
+        writeSnapperMeta(m_filesystems[uuid], snapshotsName, number);
+    }
+}
+
+uint64_t FakeBtrfsBackend::addSubvolume(const QString &uuid, const QString &name, const QUuid &parentUuid, bool readOnly)
+{
+    const auto it = m_filesystems.find(uuid);
+    if (it == m_filesystems.end() || name.isEmpty() || it->subvolumes.idOf(name) != 0) {
+        return 0;
+    }
+
+    ++it->generation;
+
+    Subvolume subvol;
+    subvol.id = it->nextId++;
+    subvol.parentId = findParentId(it->subvolumes, name);
+    subvol.subvolName = name;
+    subvol.uuid = QUuid::createUuid();
+    subvol.parentUuid = parentUuid;
+    subvol.generation = it->generation;
+    subvol.filesystemUuid = uuid;
+    subvol.flags = readOnly ? 0x1u : 0;
+    subvol.createdAt = FIRST_SNAPSHOT_TIME + static_cast<qint64>(subvol.id) * 3600;
+    subvol.kind = Btrfs::kindOf(name);
+
+    // Vary the sizes so sorting by them does some work
+    subvol.size = (subvol.id % 97 + 1) * 16 * 1024 * 1024;
+    subvol.exclusive = (subvol.id % 13 + 1) * 1024 * 1024;
+
+    it->subvolumes.insert(subvol);
+    return subvol.id;
+}
+
+QString FakeBtrfsBackend::generateFilesystem(int subvolumeCount)
+{
+    const QString uuid = addFilesystem();
+    const QStringList layout = {QStringLiteral("@"), QStringLiteral("@home"), QStringLiteral("@cache"), QStringLiteral("@log")};
+    for (const QString &name : layout) {
+        addSubvolume(uuid, name);
+    }
+
+    // The top level subvolume, the layout and the two .snapshots subvolumes
+    const int snapshotCount = std::max(0, subvolumeCount - static_cast<int>(layout.count()) - 3);
+    addSnapperSnapshots(uuid, QStringLiteral("@"), snapshotCount - snapshotCount / 4);
+    addSnapperSnapshots(uuid, QStringLiteral("@home"), snapshotCount / 4);
+
+    return uuid;
+}
+
+btrfs_util_error FakeBtrfsBackend::createSnapshot(const QString &source, const QString &dest, bool readOnly)
+{
+    QString sourceName;
+    QString destName;
+    const QString uuid = resolve(source, sourceName);
+    if (uuid.isEmpty() || resolve(dest, destName) != uuid) {
+        return BTRFS_UTIL_ERROR_NOT_BTRFS;
+    }
+
+    const SubvolumeMap &subvolumes = m_filesystems[uuid].subvolumes;
+    const uint64_t sourceId = subvolumes.idOf(sourceName);
+    if (sourceId == 0) {
+        return BTRFS_UTIL_ERROR_NOT_SUBVOLUME;
+    }
+
+    const QUuid sourceUuid = subvolumes.value(sourceId).uuid;
+    return addSubvolume(uuid, destName, sourceUuid, readOnly) != 0 ? BTRFS_UTIL_OK : BTRFS_UTIL_ERROR_SNAP_CREATE_FAILED;
+}
+
+btrfs_util_error FakeBtrfsBackend::deleteSubvolume(const QString &path)
+{
+    QString name;
+    const QString uuid = resolve(path, name);
+    if (uuid.isEmpty()) {
+        return BTRFS_UTIL_ERROR_NOT_BTRFS;
+    }
+
+    Filesystem &filesystem = m_filesystems[uuid];
+    const uint64_t id = filesystem.subvolumes.idOf(name);
+    if (id == 0 || id == BTRFS_ROOT_ID) {
+        return BTRFS_UTIL_ERROR_NOT_SUBVOLUME;
+    }
+
+    // Like the kernel, a subvolume that still has subvolumes nested in it can't be deleted
+    if (!filesystem.subvolumes.childrenOf(id).isEmpty()) {
+        return BTRFS_UTIL_ERROR_SNAP_DESTROY_FAILED;
+    }
+
+    ++filesystem.generation;
+    filesystem.subvolumes.remove(id);
+    return BTRFS_UTIL_OK;
+}
+
+QString FakeBtrfsBackend::findAnyMountpoint(const QString &uuid)
+{
+    const auto it = m_filesystems.constFind(uuid);
+    return it != m_filesystems.cend() ? it->mountpoint : QString();
+}
+
+QStringList FakeBtrfsBackend::listFilesystems() { return m_filesystems.keys(); }
+
+QString FakeBtrfsBackend::mountRoot(const QString &uuid) { return findAnyMountpoint(uuid); }
+
+BtrfsProgress FakeBtrfsBackend::readBalanceProgress(const QString &mountpoint)
+{
+    Q_UNUSED(mountpoint);
+
+    return BtrfsProgress();
+}
+
+int FakeBtrfsBackend::readChangedInodes(const QString &mountpoint, uint64_t subvolId, uint64_t generation, QVector<ChangedInode> &inodes)
+{
+    // Only the subvolumes exist in memory, they have no files that could change
+    Q_UNUSED(mountpoint);
+    Q_UNUSED(subvolId);
+    Q_UNUSED(generation);
+    inodes.clear();
+    return 0;
+}
+
+SubvolumeMap FakeBtrfsBackend::readChangedSubvolumes(const QString &uuid, const QString &mountpoint, const SubvolumeMap &previous)
+{
+    // Everything is already in memory so there is nothing to gain from reusing the previous read
+    Q_UNUSED(previous);
+    return readSubvolumes(uuid, mountpoint);
+}
+
+void FakeBtrfsBackend::readQgroups(const QString &mountpoint, SubvolumeMap &subvolumes)
+{
+    QString name;
+    const auto it = m_filesystems.constFind(resolve(mountpoint, name));
+    if (it == m_filesystems.cend()) {
+        return;
+    }
+
+    for (const Subvolume &stored : it->subvolumes) {
+        if (Subvolume *subvol = subvolumes.find(stored.id)) {
+            subvol->size = stored.size;
+            subvol->exclusive = stored.exclusive;
+        }
+    }
+}
+
+BtrfsProgress FakeBtrfsBackend::readScrubProgress(const QString &mountpoint)
+{
+    Q_UNUSED(mountpoint);
+
+    return BtrfsProgress();
+}
+
+std::optional<Subvolume> FakeBtrfsBackend::readSubvolume(const QString &uuid, const QString &path)
+{
+    QString name;
+    if (uuid.isEmpty() || resolve(path, name) != uuid) {
+        return std::nullopt;
+    }
+
+    const SubvolumeMap &subvolumes = m_filesystems[uuid].subvolumes;
+    const uint64_t id = subvolumes.idOf(name);
+    if (id == 0) {
+        return std::nullopt;
+    }
+
+    return subvolumes.value(id);
+}
+
+SubvolumeMap FakeBtrfsBackend::readSubvolumes(const QString &uuid, const QString &mountpoint)
+{
+    Q_UNUSED(mountpoint);
+
+    const auto it = m_filesystems.constFind(uuid);
+    return it != m_filesystems.cend() ? it->subvolumes : SubvolumeMap();
+}
+
+BtrfsFilesystem FakeBtrfsBackend::readUsage(const QString &uuid, const QString &mountpoint)
+{
+    Q_UNUSED(mountpoint);
+
+    BtrfsFilesystem btrfs;
+    const auto it = m_filesystems.constFind(uuid);
+    if (it == m_filesystems.cend()) {
+        return btrfs;
+    }
+
+    // A single 1TiB device with the data in single chunks and the metadata in DUP chunks
+    constexpr uint64_t GiB = 1024 * 1024 * 1024;
+    for (const Subvolume &subvol : it->subvolumes) {
+        btrfs.dataUsed += subvol.exclusive;
+    }
+    btrfs.dataSize = btrfs.dataUsed + GiB;
+    btrfs.metaUsed = static_cast<uint64_t>(it->subvolumes.count()) * 16 * 1024;
+    btrfs.metaSize = btrfs.metaUsed + GiB;
+    btrfs.sysSize = 32 * 1024 * 1024;
+    btrfs.sysUsed = 16 * 1024;
+
+    btrfs.totalSize = 1024 * GiB;
+    btrfs.allocatedSize = btrfs.dataSize + 2 * btrfs.metaSize + 2 * btrfs.sysSize;
+    btrfs.usedSize = btrfs.dataUsed + 2 * btrfs.metaUsed + 2 * btrfs.sysUsed;
+    btrfs.freeSize = btrfs.totalSize - btrfs.allocatedSize + btrfs.dataSize - btrfs.dataUsed;
+    btrfs.freeSizeMin = btrfs.freeSize;
+
+    return btrfs;
+}
+
+bool FakeBtrfsBackend::renameSubvolume(const QString &source, const QString &target)
+{
+    QString sourceName;
+    QString targetName;
+    const QString uuid = resolve(source, sourceName);
+    if (uuid.isEmpty() || resolve(target, targetName) != uuid) {
+        return false;
+    }
+
+    Filesystem &filesystem = m_filesystems[uuid];
+    const uint64_t id = filesystem.subvolumes.idOf(sourceName);
+    if (id == 0 || id == BTRFS_ROOT_ID || targetName.isEmpty() || filesystem.subvolumes.idOf(targetName) != 0) {
+        return false;
+    }
+
+    ++filesystem.generation;
+
+    // Everything nested in the subvolume moves along with it
+    QVector<Subvolume> subvols;
+    subvols.reserve(filesystem.subvolumes.count());
+    for (Subvolume subvol : filesystem.subvolumes) {
+        if (subvol.id == id) {
+            subvol.subvolName = targetName;
+            subvol.parentId = findParentId(filesystem.subvolumes, targetName);
+            subvol.generation = filesystem.generation;
+        } else if (subvol.subvolName.startsWith(sourceName + '/')) {
+            subvol.subvolName = targetName + subvol.subvolName.mid(sourceName.length());
+        }
+        subvol.kind = Btrfs::kindOf(subvol.subvolName);
+        subvols.append(subvol);
+    }
+    filesystem.subvolumes = SubvolumeMap(subvols);
+
+    return true;
+}
+
+int FakeBtrfsBackend::send(const QString &parentPath, const QString &childPath, uint64_t flags,
+                           const std::function<void(const char *, qsizetype)> &consumer)
+{
+    // Only the subvolumes exist in memory, there are no files to compare
+    Q_UNUSED(parentPath);
+    Q_UNUSED(childPath);
+    Q_UNUSED(flags);
+    Q_UNUSED(consumer);
+    return EOPNOTSUPP;
+}
+
+bool FakeBtrfsBackend::setSubvolumeReadOnly(const QString &path, bool readOnly)
+{
+    QString name;
+    const QString uuid = resolve(path, name);
+    if (uuid.isEmpty()) {
+        return false;
+    }
+
+    Filesystem &filesystem = m_filesystems[uuid];
+    Subvolume *subvol = filesystem.subvolumes.find(filesystem.subvolumes.idOf(name));
+    if (subvol == nullptr) {
+        return false;
+    }
+
+    ++filesystem.generation;
+    subvol->flags = readOnly ? 0x1u : 0;
+    subvol->generation = filesystem.generation;
+    return true;
+}
+
+uint64_t FakeBtrfsBackend::subvolumeId(const QString &path)
+{
+    QString name;
+    const auto it = m_filesystems.constFind(resolve(path, name));
+    return it != m_filesystems.cend() ? it->subvolumes.idOf(name) : 0;
+}
+
+QString FakeBtrfsBackend::resolve(const QString &path, QString &name) const
+{
+    const QString relative = QDir(m_rootPath).relativeFilePath(QDir::cleanPath(path));
+    const QString uuid = relative.section('/', 0, 0);
+    if (!m_filesystems.contains(uuid)) {
+        return QString();
+    }
+
+    name = relative.section('/', 1);
+    return uuid;
+}
+
+void FakeBtrfsBackend::writeSnapperMeta(const Filesystem &filesystem, const QString &snapshotsName, uint number)
+{
+    const QString dir = QDir::cleanPath(filesystem.mountpoint + '/' + snapshotsName + '/' + QString::number(number));
+    QFile file(dir + QStringLiteral("/info.xml"));
+    if (!QDir().mkpath(dir) || !file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return;
+    }
+
+    // The same layout snapper writes, the date is in UTC
+    const QDateTime date = QDateTime::fromSecsSinceEpoch(FIRST_SNAPSHOT_TIME + static_cast<qint64>(number) * 3600).toUTC();
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement(QStringLiteral("snapshot"));
+    xml.writeTextElement(QStringLiteral("type"), QStringLiteral("single"));
+    xml.writeTextElement(QStringLiteral("num"), QString::number(number));
+    xml.writeTextElement(QStringLiteral("date"), date.toString(QStringLiteral("yyyy-MM-dd HH:mm:ss")));
+    xml.writeTextElement(QStringLiteral("description"), QStringLiteral("timeline"));
+    xml.writeTextElement(QStringLiteral("cleanup"), QStringLiteral("timeline"));
+    xml.writeEndElement();
+    xml.writeEndDocument();
+}
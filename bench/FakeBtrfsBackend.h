@@ -0,0 +1,110 @@
+#ifndef FAKEBTRFSBACKEND_H
+#define FAKEBTRFSBACKEND_H
+
+#include "util/BtrfsBackend.h"
+
+#include <QMap>
+#include <QString>
+#include <QUuid>
+
+/**
+ * @brief The FakeBtrfsBackend class keeps whole btrfs filesystems in memory so the code above Btrfs can be run at any scale.
+ *
+ * Each filesystem appears to be mounted at <rootPath>/<uuid>.  Only the snapper info.xml files are written to that directory since
+ * Snapper reads them straight from disk, everything else only exists in memory.  Every change bumps the generation of the
+ * filesystem the same way a committed transaction would.
+ */
+class FakeBtrfsBackend : public BtrfsBackend {
+  public:
+    /**
+     * @param rootPath - An existing directory that the filesystems are placed under
+     */
+    explicit FakeBtrfsBackend(const QString &rootPath);
+
+    /**
+     * @brief Adds a filesystem that only contains the top level subvolume
+     * @return The UUID of the new filesystem
+     */
+    QString addFilesystem();
+
+    /**
+     * @brief Adds numbered snapper snapshots of @p target along with their info.xml files
+     *
+     * The snapshots are placed in the nested <target>/.snapshots subvolume which is created first if needed, the numbers continue
+     * from the highest one already there.
+     *
+     * @param uuid - The UUID of the filesystem
+     * @param target - The name of the subvolume to snapshot relative to the root of the filesystem
+     * @param count - The number of snapshots to add
+     */
+    void addSnapperSnapshots(const QString &uuid, const QString &target, int count);
+
+    /**
+     * @brief Adds a subvolume at @p name, the directories leading up to it don't need to exist
+     * @param uuid - The UUID of the filesystem
+     * @param name - The path of the new subvolume relative to the root of the filesystem
+     * @param parentUuid - The UUID of the subvolume this is a snapshot of or a null QUuid
+     * @param readOnly - Whether the subvolume is read-only
+     * @return The id of the new subvolume or 0 if @p uuid doesn't exist or @p name is taken
+     */
+    uint64_t addSubvolume(const QString &uuid, const QString &name, const QUuid &parentUuid = QUuid(), bool readOnly = false);
+
+    /**
+     * @brief Adds a filesystem with the usual @, @home, @cache and @log layout and snapper configs for @ and @home
+     *
+     * Everything beyond the base layout is a snapper snapshot, three quarters of them of @ and the rest of @home.
+     *
+     * @param subvolumeCount - The total number of subvolumes including the top level subvolume
+     * @return The UUID of the new filesystem
+     */
+    QString generateFilesystem(int subvolumeCount);
+
+    btrfs_util_error createSnapshot(const QString &source, const QString &dest, bool readOnly) override;
+    btrfs_util_error deleteSubvolume(const QString &path) override;
+    QString findAnyMountpoint(const QString &uuid) override;
+    QStringList listFilesystems() override;
+    QString mountRoot(const QString &uuid) override;
+    BtrfsProgress readBalanceProgress(const QString &mountpoint) override;
+    int readChangedInodes(const QString &mountpoint, uint64_t subvolId, uint64_t generation, QVector<ChangedInode> &inodes) override;
+    SubvolumeMap readChangedSubvolumes(const QString &uuid, const QString &mountpoint, const SubvolumeMap &previous) override;
+    void readQgroups(const QString &mountpoint, SubvolumeMap &subvolumes) override;
+    BtrfsProgress readScrubProgress(const QString &mountpoint) override;
+    std::optional<Subvolume> readSubvolume(const QString &uuid, const QString &path) override;
+    SubvolumeMap readSubvolumes(const QString &uuid, const QString &mountpoint) override;
+    BtrfsFilesystem readUsage(const QString &uuid, const QString &mountpoint) override;
+    bool renameSubvolume(const QString &source, const QString &target) override;
+    int send(const QString &parentPath, const QString &childPath, uint64_t flags,
+             const std::function<void(const char *, qsizetype)> &consumer) override;
+    bool setSubvolumeReadOnly(const QString &path, bool readOnly) override;
+    uint64_t subvolumeId(const QString &path) override;
+
+  private:
+    // The first id btrfs hands out to subvolumes
+    static constexpr uint64_t FIRST_SUBVOLUME_ID = 256;
+
+    struct Filesystem {
+        QString mountpoint;
+        uint64_t generation = 1;
+        uint64_t nextId = FIRST_SUBVOLUME_ID;
+        SubvolumeMap subvolumes;
+    };
+
+    /**
+     * @brief Splits an absolute @p path into the filesystem it is on and the name relative to the root of that filesystem
+     * @param path - An absolute path below one of the mountpoints
+     * @param name - Set to the name relative to the root of the filesystem
+     * @return The UUID of the filesystem or an empty string if @p path isn't below any of the mountpoints
+     */
+    QString resolve(const QString &path, QString &name) const;
+
+    /**
+     * @brief Writes the info.xml file snapper keeps next to snapshot @p number in the snapshot subvolume @p snapshotsName
+     */
+    void writeSnapperMeta(const Filesystem &filesystem, const QString &snapshotsName, uint number);
+
+    QString m_rootPath;
+    // The key is the UUID of the filesystem
+    QMap<QString, Filesystem> m_filesystems;
+};
+
+#endif // FAKEBTRFSBACKEND_H
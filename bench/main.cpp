@@ -0,0 +1,195 @@
+#include "FakeBtrfsBackend.h"
+#include "model/DiffModel.h"
+#include "model/SubvolModel.h"
+#include "util/Diff.h"
+#include "util/MetadataCache.h"
+#include "util/Snapper.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+/**
+ * @brief Returns the peak resident set size of the process in kB as reported by the kernel, or 0 if it can't be read
+ */
+qint64 peakRss()
+{
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return 0;
+    }
+
+    while (!status.atEnd()) {
+        const QByteArray line = status.readLine();
+        if (line.startsWith("VmHWM:")) {
+            return line.mid(6).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs @p function @p iterations times and prints the fastest and the median run along with the peak RSS so far
+ */
+void measure(const QString &name, int iterations, const std::function<void()> &function)
+{
+    QVector<qint64> times;
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        function();
+        times.append(timer.nsecsElapsed());
+    }
+    std::sort(times.begin(), times.end());
+
+    QTextStream(stdout) << QStringLiteral("%1 %2 ms %3 ms %4 MB")
+                               .arg(name, -32)
+                               .arg(static_cast<double>(times.first()) / 1e6, 10, 'f', 2)
+                               .arg(static_cast<double>(times.at(times.count() / 2)) / 1e6, 10, 'f', 2)
+                               .arg(static_cast<double>(peakRss()) / 1024, 10, 'f', 1)
+                        << Qt::endl;
+}
+
+/**
+ * @brief Writes a text file of about @p megabytes MB to @p oldPath and a copy with a changed line every @p changeInterval lines to
+ * @p newPath, every tenth change inserts or removes a line instead
+ * @return false if either file could not be written
+ */
+bool generateDiffFiles(const QString &oldPath, const QString &newPath, qint64 megabytes, int changeInterval)
+{
+    QFile oldFile(oldPath);
+    QFile newFile(newPath);
+    if (!oldFile.open(QIODevice::WriteOnly) || !newFile.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QByteArray oldChunk;
+    QByteArray newChunk;
+    qint64 written = 0;
+    for (qint64 line = 0; written < megabytes * 1024 * 1024; ++line) {
+        const QByteArray text = QByteArrayLiteral("2024-01-01T00:00:00 btrfs-assistant[1234]: generated log line ") +
+                                QByteArray::number(line) + '\n';
+        oldChunk.append(text);
+        written += text.size();
+
+        const qint64 change = line / changeInterval;
+        if (line % changeInterval != 0) {
+            newChunk.append(text);
+        } else if (change % 10 == 1) {
+            newChunk.append(text).append(QByteArrayLiteral("an inserted line\n"));
+        } else if (change % 10 != 2) {
+            newChunk.append(QByteArrayLiteral("a changed line ") + QByteArray::number(line) + '\n');
+        }
+
+        if (oldChunk.size() >= 1024 * 1024) {
+            oldFile.write(oldChunk);
+            newFile.write(newChunk);
+            oldChunk.clear();
+            newChunk.clear();
+        }
+    }
+
+    return oldFile.write(oldChunk) == oldChunk.size() && newFile.write(newChunk) == newChunk.size();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Times loading subvolumes and snapper snapshots from generated filesystems"));
+    parser.addHelpOption();
+
+    QCommandLineOption subvolumesOption(QStringLiteral("subvolumes"), QStringLiteral("The number of subvolumes on each filesystem"),
+                                        QStringLiteral("count"), QStringLiteral("100000"));
+    parser.addOption(subvolumesOption);
+    QCommandLineOption filesystemsOption(QStringLiteral("filesystems"), QStringLiteral("The number of filesystems"),
+                                         QStringLiteral("count"), QStringLiteral("1"));
+    parser.addOption(filesystemsOption);
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"), QStringLiteral("How many times each step is run"),
+                                        QStringLiteral("count"), QStringLiteral("5"));
+    parser.addOption(iterationsOption);
+    QCommandLineOption diffSizeOption(QStringLiteral("diff-size"), QStringLiteral("The size of each file that is diffed, 0 skips the diff"),
+                                      QStringLiteral("MB"), QStringLiteral("200"));
+    parser.addOption(diffSizeOption);
+    parser.process(app);
+
+    const int subvolumeCount = std::max(1, parser.value(subvolumesOption).toInt());
+    const int filesystemCount = std::max(1, parser.value(filesystemsOption).toInt());
+    const int iterations = std::max(1, parser.value(iterationsOption).toInt());
+    const qint64 diffSize = std::max(0LL, parser.value(diffSizeOption).toLongLong());
+
+    // The generated data must never end up in the cache of the real filesystems
+    MetadataCache::disable();
+
+    QTemporaryDir rootDir;
+    if (!rootDir.isValid()) {
+        QTextStream(stderr) << "Error: Failed to create a temporary directory" << Qt::endl;
+        return 1;
+    }
+
+    auto backend = std::make_unique<FakeBtrfsBackend>(rootDir.path());
+    QStringList uuids;
+    for (int i = 0; i < filesystemCount; ++i) {
+        uuids.append(backend->generateFilesystem(subvolumeCount));
+    }
+
+    QTextStream(stdout) << QStringLiteral("%1 filesystem(s) with %2 subvolumes each, best and median of %3 runs, peak RSS after each step")
+                               .arg(filesystemCount)
+                               .arg(subvolumeCount)
+                               .arg(iterations)
+                        << Qt::endl;
+
+    Btrfs btrfs(std::move(backend));
+
+    measure(QStringLiteral("Btrfs::loadSubvols"), iterations, [&btrfs, &uuids]() {
+        for (const QString &uuid : std::as_const(uuids)) {
+            btrfs.loadSubvols(uuid);
+        }
+    });
+
+    // Without D-Bus, a snapper command that always fails keeps the configs of the machine running the benchmark out of the results
+    Snapper snapper(&btrfs, QStringLiteral("false"), InitialLoad::Later);
+    snapper.disableDBus();
+    snapper.load();
+    measure(QStringLiteral("Snapper::loadSubvols"), iterations, [&snapper]() { snapper.loadSubvols(); });
+    measure(QStringLiteral("Snapper::createSubvolMap"), iterations, [&snapper]() { snapper.createSubvolMap(); });
+
+    SubvolumeModel model;
+    measure(QStringLiteral("SubvolumeModel::load"), iterations, [&model, &btrfs]() { model.load(btrfs.filesystems()); });
+
+    if (diffSize > 0) {
+        const QString oldPath = rootDir.filePath(QStringLiteral("diff-old.log"));
+        const QString newPath = rootDir.filePath(QStringLiteral("diff-new.log"));
+        if (!generateDiffFiles(oldPath, newPath, diffSize, 1000)) {
+            QTextStream(stderr) << "Error: Failed to write the files to diff" << Qt::endl;
+            return 1;
+        }
+
+        DiffResult result;
+        // The same as the diff viewer, the old file stands in for the live one and is copied while the new one is mapped
+        measure(QStringLiteral("Diff::compare"), iterations, [&result, &oldPath, &newPath]() {
+            result = Diff::compare(oldPath, newPath, DiffText::Access::Copy, DiffText::Access::Map);
+        });
+        QTextStream(stdout) << QStringLiteral("%1 MB per file, %2 hunks, %3 diff lines")
+                                   .arg(diffSize)
+                                   .arg(result.hunks.count())
+                                   .arg(result.lines.count())
+                            << Qt::endl;
+
+        DiffModel diffModel;
+        measure(QStringLiteral("DiffModel::setResult"), iterations, [&diffModel, &result]() { diffModel.setResult(result); });
+    }
+
+    return 0;
+}
@@ -1,21 +1,151 @@
 #include "ui/Cli.h"
 #include "ui/MainWindow.h"
 #include "util/BtrfsMaintenance.h"
+#include "util/MountTable.h"
 #include "util/Settings.h"
 #include "util/System.h"
+#include "util/Tracer.h"
 
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QDebug>
+#include <QEventLoop>
 #include <QFile>
+#include <QHash>
 #include <QTranslator>
 
+#include <algorithm>
+#include <cmath>
+
+/**
+ * @brief Finds the value of the long option @p name before the application object exists
+ *
+ * Tracing and benchmarking need to be set up before the Btrfs and Snapper objects are created since they run commands in their
+ * constructors.
+ */
+QString findOptionValue(int argc, char *argv[], const QString &name)
+{
+    const QString option = QStringLiteral("--") + name;
+    for (int i = 1; i < argc; ++i) {
+        const QString arg = QString::fromLocal8Bit(argv[i]);
+        if (arg == option && i + 1 < argc) {
+            return QString::fromLocal8Bit(argv[i + 1]);
+        } else if (arg.startsWith(option + '=')) {
+            return arg.mid(option.size() + 1);
+        }
+    }
+
+    return QString();
+}
+
 void setApplicationInfo()
 {
     QCoreApplication::setApplicationName(QCoreApplication::translate("main", "Btrfs Assistant"));
     QCoreApplication::setApplicationVersion("2.1.1");
 }
 
+/**
+ * @brief Returns the nearest-rank percentile @p p of @p sorted, which must be sorted in ascending order and not be empty
+ */
+qint64 percentile(const QVector<qint64> &sorted, double p)
+{
+    const auto rank = static_cast<int>(std::ceil(p / 100.0 * static_cast<double>(sorted.count())));
+    return sorted.at(std::clamp(rank - 1, 0, static_cast<int>(sorted.count()) - 1));
+}
+
+/**
+ * @brief Runs the startup sequence @p runs times without showing a window and prints the percentiles of each phase
+ *
+ * The metadata cache is used as it would be by a normal start, so every run after the first one measures a warm start.  Phases
+ * that only happen once per process, such as the first read of the mount table, only count towards the first run.  A run ends
+ * once the window has shown all the data loaded in the background.
+ */
+int benchmarkStartup(int argc, char *argv[], int runs, const QString &snapperPath, const QString &btrfsMaintenanceConfig)
+{
+    // The window is never shown so there is no need for a display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    setApplicationInfo();
+
+    Tracer &tracer = Tracer::instance();
+    tracer.enable();
+
+    // The durations of each phase in microseconds, phases that run more than once in a run are added together
+    QHash<QString, QVector<qint64>> durations;
+    // The offset from the start of the run at which each phase first began, used to list the phases in the order they ran
+    QHash<QString, qint64> firstStart;
+    for (int run = 0; run < runs; ++run) {
+        const qint64 runStart = tracer.timestamp();
+        {
+            TraceSpan span(QStringLiteral("Startup"));
+
+            if (!MountTable::instance().hasFilesystemType(QStringLiteral("btrfs"))) {
+                QTextStream(stderr) << QCoreApplication::translate("main", "Error: No Btrfs filesystems found") << Qt::endl;
+                return 1;
+            }
+
+            Btrfs btrfs(InitialLoad::Later);
+            std::unique_ptr<Snapper> snapper;
+            if (QFile::exists(snapperPath)) {
+                snapper = std::make_unique<Snapper>(&btrfs, snapperPath, InitialLoad::Later);
+            }
+            std::unique_ptr<BtrfsMaintenance> btrfsMaintenance;
+            if (QFile::exists(btrfsMaintenanceConfig)) {
+                btrfsMaintenance = std::make_unique<BtrfsMaintenance>(btrfsMaintenanceConfig);
+            }
+
+            MainWindow mainWindow(&btrfs, btrfsMaintenance.get(), snapper.get());
+            if (mainWindow.isLoading()) {
+                QEventLoop loop;
+                QObject::connect(&mainWindow, &MainWindow::loadingFinished, &loop, &QEventLoop::quit);
+                loop.exec();
+            }
+        }
+
+        QHash<QString, qint64> runDurations;
+        for (const TraceEvent &event : tracer.events(QStringLiteral("phase"), runStart)) {
+            runDurations[event.name] += event.duration;
+            if (!firstStart.contains(event.name) || event.start - runStart < firstStart.value(event.name)) {
+                firstStart.insert(event.name, event.start - runStart);
+            }
+        }
+        for (auto it = runDurations.cbegin(); it != runDurations.cend(); ++it) {
+            durations[it.key()].append(it.value());
+        }
+    }
+
+    QStringList phases = durations.keys();
+    std::sort(phases.begin(), phases.end(), [&firstStart](const QString &a, const QString &b) {
+        return firstStart.value(a) < firstStart.value(b) || (firstStart.value(a) == firstStart.value(b) && a < b);
+    });
+
+    QTextStream stream(stdout);
+    stream << QStringLiteral("%1 %2 %3 %4 %5 %6  %7\n")
+                  .arg(QStringLiteral("Runs"), 5)
+                  .arg(QStringLiteral("Min ms"), 10)
+                  .arg(QStringLiteral("p50 ms"), 10)
+                  .arg(QStringLiteral("p90 ms"), 10)
+                  .arg(QStringLiteral("p99 ms"), 10)
+                  .arg(QStringLiteral("Max ms"), 10)
+                  .arg(QStringLiteral("Phase"));
+    for (const QString &phase : std::as_const(phases)) {
+        QVector<qint64> sorted = durations.value(phase);
+        std::sort(sorted.begin(), sorted.end());
+        stream << QStringLiteral("%1 %2 %3 %4 %5 %6  %7\n")
+                      .arg(sorted.count(), 5)
+                      .arg(static_cast<double>(sorted.first()) / 1000.0, 10, 'f', 1)
+                      .arg(static_cast<double>(percentile(sorted, 50)) / 1000.0, 10, 'f', 1)
+                      .arg(static_cast<double>(percentile(sorted, 90)) / 1000.0, 10, 'f', 1)
+                      .arg(static_cast<double>(percentile(sorted, 99)) / 1000.0, 10, 'f', 1)
+                      .arg(static_cast<double>(sorted.last()) / 1000.0, 10, 'f', 1)
+                      .arg(phase);
+    }
+
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     QCommandLineParser parser;
@@ -34,26 +164,55 @@ int main(int argc, char *argv[])
                                      QCoreApplication::translate("main", "index of snapshot"));
     parser.addOption(restoreOption);
 
+    QCommandLineOption changesOption(
+        QStringList() << "c"
+                      << "changes",
+        QCoreApplication::translate("main", "List the files changed since a snapshot or between two snapshots separated by a comma"),
+        QCoreApplication::translate("main", "index[,index]"));
+    parser.addOption(changesOption);
+
+    QCommandLineOption traceOption(QStringList() << "trace",
+                                   QCoreApplication::translate("main", "Write a Chrome trace of the commands run to the given file"),
+                                   QCoreApplication::translate("main", "file"));
+    parser.addOption(traceOption);
+    Tracer::instance().setOutputPath(findOptionValue(argc, argv, QStringLiteral("trace")));
+
+    QCommandLineOption benchmarkStartupOption(
+        QStringList() << "benchmark-startup",
+        QCoreApplication::translate("main", "Start the given number of times without a window and print how long each phase took"),
+        QCoreApplication::translate("main", "runs"));
+    parser.addOption(benchmarkStartupOption);
+
     QString snapperPath = Settings::instance().value("snapper", "/usr/bin/snapper").toString();
     QString btrfsMaintenanceConfig = Settings::instance().value("bm_config", "/etc/default/btrfsmaintenance").toString();
 
+    const int benchmarkRuns = findOptionValue(argc, argv, QStringLiteral("benchmark-startup")).toInt();
+    if (benchmarkRuns > 0) {
+        return benchmarkStartup(argc, argv, benchmarkRuns, snapperPath, btrfsMaintenanceConfig);
+    }
+
     // Ensure we are running on a system with btrfs
-    if (!System::runCmd("findmnt --real -no fstype ", false).output.contains("btrfs")) {
+    if (!MountTable::instance().hasFilesystemType(QStringLiteral("btrfs"))) {
         QTextStream(stderr) << QCoreApplication::translate("main", "Error: No Btrfs filesystems found") << Qt::endl;
         return 1;
     }
 
+    // If $DISPLAY or $WAYLAND_DISPLAY is not empty, launch in GUI mode; else launch in CLI mode
+    const bool isGui = !qEnvironmentVariableIsEmpty("DISPLAY") || !qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY");
+
+    // In GUI mode the data is loaded in the background once the window is up
+    const InitialLoad initialLoad = isGui ? InitialLoad::Later : InitialLoad::Now;
+
     // The btrfs object is used to interact with the application
-    Btrfs btrfs;
+    Btrfs btrfs(initialLoad);
 
     // If Snapper is installed, instantiate the snapper object
     Snapper *snapper = nullptr;
     if (QFile::exists(snapperPath)) {
-        snapper = new Snapper(&btrfs, snapperPath);
+        snapper = new Snapper(&btrfs, snapperPath, initialLoad);
     }
 
-    // If $DISPLAY or $WAYLAND_DISPLAY is not empty, launch in GUI mode; else launch in CLI mode
-    if (!qEnvironmentVariableIsEmpty("DISPLAY") || !qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")) {
+    if (isGui) {
         qDebug() << "DISPLAY / WAYLAND_DISPLAY variable is set, launching in GUI mode";
         QApplication app(argc, argv);
 
@@ -68,12 +227,18 @@ int main(int argc, char *argv[])
 
         setApplicationInfo();
 
-        // Process CLI options
+        // Process CLI options, these need the data right away
         parser.process(app);
+        if ((parser.isSet(listOption) || parser.isSet(restoreOption) || parser.isSet(changesOption)) && snapper != nullptr) {
+            btrfs.loadVolumes();
+            snapper->load();
+        }
         if (parser.isSet(listOption) && snapper != nullptr) {
             return Cli::listSnapshots(snapper);
         } else if (parser.isSet(restoreOption) && snapper != nullptr) {
             return Cli::restore(&btrfs, snapper, parser.value(restoreOption).toInt());
+        } else if (parser.isSet(changesOption) && snapper != nullptr) {
+            return Cli::listChanges(&btrfs, snapper, parser.value(changesOption));
         }
 
         // Set the desktop name for Wayland
@@ -98,6 +263,8 @@ int main(int argc, char *argv[])
             return Cli::listSnapshots(snapper);
         } else if (parser.isSet(restoreOption) && snapper != nullptr) {
             return Cli::restore(&btrfs, snapper, parser.value(restoreOption).toInt());
+        } else if (parser.isSet(changesOption) && snapper != nullptr) {
+            return Cli::listChanges(&btrfs, snapper, parser.value(changesOption));
         } else {
             parser.showHelp();
             return 0;
@@ -0,0 +1,132 @@
+#include "model/DiffModel.h"
+
+#include <QColor>
+
+namespace {
+
+// Tabs are expanded to this many spaces since the views don't honour them
+const QString TAB_REPLACEMENT = QStringLiteral("    ");
+
+/**
+ * @brief Formats a range of lines like diff -u, a single line only has its start and an empty range starts at the line before it
+ */
+QString formatRange(qsizetype start, qsizetype count)
+{
+    if (count == 1) {
+        return QString::number(start + 1);
+    }
+
+    return QStringLiteral("%1,%2").arg(count == 0 ? start : start + 1).arg(count);
+}
+
+} // namespace
+
+int DiffModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    if (!m_message.isEmpty()) {
+        return 1;
+    }
+
+    return static_cast<int>(m_result.lines.count());
+}
+
+QVariant DiffModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return {};
+    }
+
+    if (role == Qt::SizeHintRole && m_rowSize.isValid()) {
+        return m_rowSize;
+    }
+
+    if (!m_message.isEmpty()) {
+        return role == Qt::DisplayRole ? QVariant(m_message) : QVariant();
+    }
+
+    const DiffLine &line = m_result.lines.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return lineText(line);
+    case Qt::ForegroundRole:
+        if (line.type == DiffLine::OldFile || line.type == DiffLine::Removed) {
+            return QColor(Qt::red);
+        } else if (line.type == DiffLine::NewFile || line.type == DiffLine::Added) {
+            return QColor(Qt::darkGreen);
+        }
+        break;
+    }
+
+    return QVariant();
+}
+
+QString DiffModel::lineText(const DiffLine &line) const
+{
+    switch (line.type) {
+    case DiffLine::OldFile:
+        return QStringLiteral("--- ") + m_result.oldText->path();
+    case DiffLine::NewFile:
+        return QStringLiteral("+++ ") + m_result.newText->path();
+    case DiffLine::Hunk: {
+        const DiffHunk &hunk = m_result.hunks.at(line.index);
+        return QStringLiteral("@@ -%1 +%2 @@").arg(formatRange(hunk.oldStart, hunk.oldCount), formatRange(hunk.newStart, hunk.newCount));
+    }
+    case DiffLine::Context:
+        return QLatin1Char(' ') + QString::fromUtf8(m_result.oldText->line(line.index)).replace(QLatin1Char('\t'), TAB_REPLACEMENT);
+    case DiffLine::Removed:
+        return QLatin1Char('-') + QString::fromUtf8(m_result.oldText->line(line.index)).replace(QLatin1Char('\t'), TAB_REPLACEMENT);
+    case DiffLine::Added:
+        return QLatin1Char('+') + QString::fromUtf8(m_result.newText->line(line.index)).replace(QLatin1Char('\t'), TAB_REPLACEMENT);
+    }
+
+    return QString();
+}
+
+void DiffModel::setResult(const DiffResult &result)
+{
+    beginResetModel();
+    m_result = result;
+    m_message.clear();
+    m_rowSize = QSize();
+
+    // Byte lengths are close enough to pick the widest line and don't need any of the lines to be decoded
+    m_longestRow = 0;
+    qsizetype longest = -1;
+    for (qsizetype row = 0; row < m_result.lines.count(); ++row) {
+        const DiffLine &line = m_result.lines.at(row);
+        qsizetype length = 0;
+        if (line.type == DiffLine::Context || line.type == DiffLine::Removed) {
+            length = m_result.oldText->line(line.index).size();
+        } else if (line.type == DiffLine::Added) {
+            length = m_result.newText->line(line.index).size();
+        } else {
+            length = lineText(line).size();
+        }
+        if (length > longest) {
+            longest = length;
+            m_longestRow = static_cast<int>(row);
+        }
+    }
+    endResetModel();
+}
+
+void DiffModel::setMessage(const QString &message)
+{
+    beginResetModel();
+    m_result = DiffResult();
+    m_message = message;
+    m_longestRow = 0;
+    m_rowSize = QSize();
+    endResetModel();
+}
+
+void DiffModel::setRowSize(const QSize &size)
+{
+    m_rowSize = size;
+    if (rowCount() > 0) {
+        emit dataChanged(index(0), index(rowCount() - 1), {Qt::SizeHintRole});
+    }
+}
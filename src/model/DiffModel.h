@@ -0,0 +1,57 @@
+#ifndef DIFFMODEL_H
+#define DIFFMODEL_H
+
+#include "util/Diff.h"
+
+#include <QAbstractListModel>
+#include <QSize>
+
+/**
+ * @brief The DiffModel class lists the lines of a unified diff, or a single message when there is nothing to show
+ *
+ * The text of a line is only read from the mapped files and formatted when a view asks for it, so a view with uniform item sizes
+ * only ever touches the lines on screen regardless of the size of the diff.
+ */
+class DiffModel : public QAbstractListModel {
+    Q_OBJECT
+
+  public:
+    explicit DiffModel(QObject *parent = nullptr) : QAbstractListModel(parent) {}
+
+    // Basic model functions
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    /**
+     * @brief Returns the row with the most characters, a view can size all the rows to fit it
+     */
+    int longestRow() const { return m_longestRow; }
+
+    /**
+     * @brief Shows the lines of @p result, the row size is reset
+     */
+    void setResult(const DiffResult &result);
+
+    /**
+     * @brief Shows @p message instead of a diff, the row size is reset
+     */
+    void setMessage(const QString &message);
+
+    /**
+     * @brief Sets the size reported for every row, an invalid size leaves the sizing to the view
+     */
+    void setRowSize(const QSize &size);
+
+  private:
+    /**
+     * @brief Returns the text shown for @p line
+     */
+    QString lineText(const DiffLine &line) const;
+
+    DiffResult m_result;
+    QString m_message;
+    int m_longestRow = 0;
+    QSize m_rowSize;
+};
+
+#endif // DIFFMODEL_H
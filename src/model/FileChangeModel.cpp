@@ -0,0 +1,87 @@
+#include "model/FileChangeModel.h"
+
+#include <QColor>
+
+QVariant FileChangeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation == Qt::Vertical) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+    case Column::Change:
+        return tr("Change");
+    case Column::Path:
+        return tr("Path");
+    case Column::OldPath:
+        return tr("Previous Path");
+    }
+
+    return QString();
+}
+
+int FileChangeModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return static_cast<int>(m_changes.count());
+}
+
+int FileChangeModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return ColumnCount;
+}
+
+QVariant FileChangeModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.column() >= ColumnCount || index.row() >= m_changes.count()) {
+        return {};
+    }
+
+    const FileChange &change = m_changes.at(index.row());
+
+    if (role == Qt::ForegroundRole && index.column() == Column::Change) {
+        if (change.type == FileChange::Deleted) {
+            return QColor(Qt::red);
+        } else if (change.type == FileChange::Created) {
+            return QColor(Qt::darkGreen);
+        }
+        return {};
+    }
+
+    if (role != Qt::DisplayRole) {
+        return {};
+    }
+
+    switch (index.column()) {
+    case Column::Change:
+        switch (change.type) {
+        case FileChange::Created:
+            return tr("Created");
+        case FileChange::Deleted:
+            return tr("Deleted");
+        case FileChange::Modified:
+            return tr("Modified");
+        case FileChange::Renamed:
+            return tr("Renamed");
+        }
+        break;
+    case Column::Path:
+        return change.path;
+    case Column::OldPath:
+        return change.oldPath;
+    }
+
+    return {};
+}
+
+void FileChangeModel::setChanges(const QVector<FileChange> &changes)
+{
+    beginResetModel();
+    m_changes = changes;
+    endResetModel();
+}
@@ -0,0 +1,34 @@
+#ifndef FILECHANGEMODEL_H
+#define FILECHANGEMODEL_H
+
+#include "util/Btrfs.h"
+
+#include <QAbstractTableModel>
+
+/**
+ * @brief The FileChangeModel class lists the files that differ between two subvolumes
+ */
+class FileChangeModel : public QAbstractTableModel {
+    Q_OBJECT
+
+  public:
+    enum Column { Change, Path, OldPath, ColumnCount };
+
+    explicit FileChangeModel(QObject *parent = nullptr) : QAbstractTableModel(parent) {}
+
+    // Basic model functions
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    /**
+     * @brief Replaces the rows with @p changes
+     */
+    void setChanges(const QVector<FileChange> &changes);
+
+  private:
+    QVector<FileChange> m_changes;
+};
+
+#endif // FILECHANGEMODEL_H
@@ -0,0 +1,31 @@
+#include "model/PathFilterModel.h"
+
+#include <QFileSystemModel>
+
+void PathFilterModel::setPaths(const QString &rootPath, const QStringList &paths)
+{
+    m_rootPath = rootPath;
+    m_paths.clear();
+    m_paths.reserve(paths.count());
+
+    // Files in the same directory share their parents so the walk up stops at the first parent that is already known
+    for (const QString &path : paths) {
+        QString current = path;
+        while (current.startsWith(m_rootPath + QLatin1Char('/')) && !m_paths.contains(current)) {
+            m_paths.insert(current);
+            current.truncate(current.lastIndexOf(QLatin1Char('/')));
+        }
+    }
+
+    invalidateFilter();
+}
+
+bool PathFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    const QString path = sourceModel()->index(sourceRow, 0, sourceParent).data(QFileSystemModel::FilePathRole).toString();
+    if (!path.startsWith(m_rootPath + QLatin1Char('/'))) {
+        return true;
+    }
+
+    return m_paths.contains(path);
+}
@@ -0,0 +1,39 @@
+#ifndef PATHFILTERMODEL_H
+#define PATHFILTERMODEL_H
+
+#include <QSet>
+#include <QSortFilterProxyModel>
+
+/**
+ * @brief Limits a QFileSystemModel below a root path to a set of files and the directories that lead to them
+ *
+ * Everything outside of the root path is left alone so the view can still be rooted anywhere below it.
+ */
+class PathFilterModel : public QSortFilterProxyModel {
+    Q_OBJECT
+
+  public:
+    explicit PathFilterModel(QObject *parent = nullptr) : QSortFilterProxyModel(parent) {}
+
+    /**
+     * @brief Shows only @p paths below @p rootPath along with their parent directories
+     * @param rootPath - The absolute path of the directory the filter applies to
+     * @param paths - Absolute paths of the entries to show
+     */
+    void setPaths(const QString &rootPath, const QStringList &paths);
+
+    /**
+     * @brief Sorts the source model so a QFileSystemModel keeps listing directories first, the rows keep the source order
+     */
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override { sourceModel()->sort(column, order); }
+
+  protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+  private:
+    QString m_rootPath;
+    // The shown entries and every directory between them and the root path
+    QSet<QString> m_paths;
+};
+
+#endif // PATHFILTERMODEL_H
@@ -0,0 +1,131 @@
+#include "model/SnapperModel.h"
+
+QVariant SnapperSnapshotModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    if (orientation == Qt::Vertical) {
+        return section;
+    }
+
+    switch (section) {
+    case Column::Number:
+        return tr("Number", "The number associated with a snapshot");
+    case Column::DateTime:
+        return tr("Date/Time");
+    case Column::Type:
+        return tr("Type");
+    case Column::Cleanup:
+        return tr("Cleanup");
+    case Column::Description:
+        return tr("Description");
+    }
+
+    return QString();
+}
+
+int SnapperSnapshotModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return ColumnCount;
+}
+
+QVariant SnapperSnapshotModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.column() >= ColumnCount || index.row() >= m_rows.count()) {
+        return {};
+    }
+
+    if (role != Qt::DisplayRole && role != Role::Sort) {
+        return {};
+    }
+
+    const SnapperSnapshot &snapshot = m_rows.at(index.row());
+    switch (index.column()) {
+    case Column::Number:
+        return snapshot.number;
+    case Column::DateTime:
+        if (role == Qt::DisplayRole) {
+            return m_locale.toString(snapshot.time, QLocale::ShortFormat);
+        } else {
+            return snapshot.time;
+        }
+    case Column::Type:
+        return snapshot.type;
+    case Column::Cleanup:
+        return snapshot.cleanup;
+    case Column::Description:
+        return snapshot.desc;
+    }
+
+    return QVariant();
+}
+
+QVariant SnapperSubvolumeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    if (orientation == Qt::Vertical) {
+        return section;
+    }
+
+    switch (section) {
+    case Column::Number:
+        return tr("Number", "The number associated with a snapshot");
+    case Column::Subvolume:
+        return tr("Subvolume");
+    case Column::DateTime:
+        return tr("Date/Time");
+    case Column::Type:
+        return tr("Type");
+    case Column::Description:
+        return tr("Description");
+    }
+
+    return QString();
+}
+
+int SnapperSubvolumeModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return ColumnCount;
+}
+
+QVariant SnapperSubvolumeModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.column() >= ColumnCount || index.row() >= m_rows.count()) {
+        return {};
+    }
+
+    if (role != Qt::DisplayRole && role != Role::Sort) {
+        return {};
+    }
+
+    const SnapperSubvolume &subvolume = m_rows.at(index.row());
+    switch (index.column()) {
+    case Column::Number:
+        return subvolume.snapshotNum;
+    case Column::Subvolume:
+        return subvolume.subvol;
+    case Column::DateTime:
+        if (role == Qt::DisplayRole) {
+            return m_locale.toString(subvolume.time, QLocale::ShortFormat);
+        } else {
+            return subvolume.time;
+        }
+    case Column::Type:
+        return subvolume.type;
+    case Column::Description:
+        return subvolume.desc;
+    }
+
+    return QVariant();
+}
@@ -0,0 +1,176 @@
+#ifndef SNAPPERMODEL_H
+#define SNAPPERMODEL_H
+
+#include "util/Snapper.h"
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QLocale>
+#include <QSet>
+
+/**
+ * @brief The SnapperTableModel class holds the rows of one of the snapper tables
+ *
+ * The rows always come from a single source, a snapper config or a target subvolume.  When the same source is loaded again the
+ * rows are matched by rowKey() and only the rows that were added or removed are inserted or removed, so views keep their selection
+ * and scroll position across reloads.  Loading a different source resets the model.
+ */
+template <typename T> class SnapperTableModel : public QAbstractTableModel {
+  public:
+    explicit SnapperTableModel(QObject *parent = nullptr) : QAbstractTableModel(parent) {}
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        if (parent.isValid())
+            return 0;
+
+        return static_cast<int>(m_rows.count());
+    }
+
+    /**
+     * @brief Returns the name of the source the rows were loaded from
+     */
+    const QString &source() const { return m_source; }
+
+  protected:
+    /**
+     * @brief Returns the value that identifies @p row across reloads of the same source
+     */
+    virtual QString rowKey(const T &row) const = 0;
+
+    /**
+     * @brief Replaces the rows with @p rows loaded from @p source
+     */
+    void setRows(const QString &source, const QVector<T> &rows)
+    {
+        if (source != m_source) {
+            beginResetModel();
+            m_source = source;
+            m_rows = rows;
+            endResetModel();
+            return;
+        }
+
+        QHash<QString, qsizetype> newRows;
+        newRows.reserve(rows.count());
+        for (qsizetype i = 0; i < rows.count(); ++i) {
+            newRows.insert(rowKey(rows.at(i)), i);
+        }
+
+        const auto isRemoved = [this, &newRows](int row) { return !newRows.contains(rowKey(m_rows.at(row))); };
+
+        // Walk backwards so the rows not visited yet keep their positions, neighbouring rows are removed together
+        for (int row = rowCount() - 1; row >= 0; --row) {
+            if (!isRemoved(row)) {
+                continue;
+            }
+
+            int first = row;
+            while (first > 0 && isRemoved(first - 1)) {
+                --first;
+            }
+
+            beginRemoveRows(QModelIndex(), first, row);
+            m_rows.remove(first, row - first + 1);
+            endRemoveRows();
+            row = first;
+        }
+
+        // The remaining rows keep their positions but take the new values
+        QSet<QString> kept;
+        kept.reserve(m_rows.count());
+        for (T &row : m_rows) {
+            const QString key = rowKey(row);
+            kept.insert(key);
+            row = rows.at(newRows.value(key));
+        }
+        if (!m_rows.isEmpty()) {
+            emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+        }
+
+        QVector<T> added;
+        for (const T &row : rows) {
+            if (!kept.contains(rowKey(row))) {
+                added.append(row);
+            }
+        }
+        if (!added.isEmpty()) {
+            beginInsertRows(QModelIndex(), rowCount(), rowCount() + static_cast<int>(added.count()) - 1);
+            m_rows.append(added);
+            endInsertRows();
+        }
+    }
+
+    QVector<T> m_rows;
+    // Dates are formatted with this only when they are displayed
+    const QLocale m_locale = QLocale::system();
+
+  private:
+    QString m_source;
+};
+
+/**
+ * @brief The SnapperSnapshotModel class lists the snapshots of a snapper config
+ */
+class SnapperSnapshotModel : public SnapperTableModel<SnapperSnapshot> {
+    Q_OBJECT
+
+  public:
+    enum Column { Number, DateTime, Type, Cleanup, Description, ColumnCount };
+
+    enum Role { Sort = Qt::UserRole };
+
+    explicit SnapperSnapshotModel(QObject *parent = nullptr) : SnapperTableModel(parent) {}
+
+    // Basic model functions
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    /**
+     * @brief Populates the model with the snapshots of @p config
+     */
+    void load(const QString &config, const QVector<SnapperSnapshot> &snapshots) { setRows(config, snapshots); }
+
+    /**
+     * @brief Returns the snapshot shown in @p row
+     */
+    const SnapperSnapshot &snapshot(int row) const { return m_rows.at(row); }
+
+  protected:
+    QString rowKey(const SnapperSnapshot &row) const override { return QString::number(row.number); }
+};
+
+/**
+ * @brief The SnapperSubvolumeModel class lists the snapshot subvolumes of a target subvolume that can be browsed or restored
+ */
+class SnapperSubvolumeModel : public SnapperTableModel<SnapperSubvolume> {
+    Q_OBJECT
+
+  public:
+    enum Column { Number, Subvolume, DateTime, Type, Description, ColumnCount };
+
+    enum Role { Sort = Qt::UserRole };
+
+    explicit SnapperSubvolumeModel(QObject *parent = nullptr) : SnapperTableModel(parent) {}
+
+    // Basic model functions
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    /**
+     * @brief Populates the model with the snapshot subvolumes of @p target
+     */
+    void load(const QString &target, const QVector<SnapperSubvolume> &subvolumes) { setRows(target, subvolumes); }
+
+    /**
+     * @brief Returns the snapshot subvolume shown in @p row
+     */
+    const SnapperSubvolume &subvolume(int row) const { return m_rows.at(row); }
+
+  protected:
+    QString rowKey(const SnapperSubvolume &row) const override { return row.subvol; }
+};
+
+#endif // SNAPPERMODEL_H
@@ -1,5 +1,19 @@
 #include "model/SubvolModel.h"
 #include "util/System.h"
+#include "util/Tracer.h"
+
+#include <QSet>
+#include <QtConcurrent>
+
+namespace {
+
+// Lists with more rows than this are filtered on a worker thread once typing pauses
+constexpr int BACKGROUND_FILTER_ROWS = 5000;
+
+// How long typing has to pause before a large list is filtered
+constexpr int FILTER_DELAY_MS = 150;
+
+} // namespace
 
 QVariant SubvolumeModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
@@ -46,7 +60,7 @@ int SubvolumeModel::rowCount(const QModelIndex &parent) const
     if (parent.isValid())
         return 0;
 
-    return static_cast<int>(m_data.count());
+    return static_cast<int>(m_rows.count());
 }
 
 int SubvolumeModel::columnCount(const QModelIndex &parent) const
@@ -59,7 +73,7 @@ int SubvolumeModel::columnCount(const QModelIndex &parent) const
 
 QVariant SubvolumeModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || index.column() >= ColumnCount || index.row() >= m_data.count()) {
+    if (!index.isValid() || index.column() >= ColumnCount || index.row() >= m_rows.count()) {
         return {};
     }
 
@@ -89,7 +103,7 @@ QVariant SubvolumeModel::data(const QModelIndex &index, int role) const
         return {};
     }
 
-    const Subvolume &subvol = m_data[index.row()];
+    const Subvolume &subvol = subvolume(index.row());
     switch (index.column()) {
     case Column::ParentId:
         return QVariant::fromValue(subvol.parentId);
@@ -98,13 +112,17 @@ QVariant SubvolumeModel::data(const QModelIndex &index, int role) const
     case Column::Name:
         return subvol.subvolName;
     case Column::Uuid:
-        return subvol.uuid;
+        return subvol.uuid.isNull() ? QString() : subvol.uuid.toString(QUuid::WithoutBraces);
     case Column::ParentUuid:
-        return subvol.parentUuid;
+        return subvol.parentUuid.isNull() ? QString() : subvol.parentUuid.toString(QUuid::WithoutBraces);
     case Column::ReceivedUuid:
-        return subvol.receivedUuid;
+        return subvol.receivedUuid.isNull() ? QString() : subvol.receivedUuid.toString(QUuid::WithoutBraces);
     case Column::CreatedAt:
-        return subvol.createdAt;
+        if (role == Qt::DisplayRole) {
+            return QDateTime::fromSecsSinceEpoch(subvol.createdAt);
+        } else {
+            return QVariant::fromValue<qlonglong>(subvol.createdAt);
+        }
     case Column::Generation:
         return QVariant::fromValue<qulonglong>(subvol.generation);
     case Column::ReadOnly:
@@ -129,23 +147,34 @@ QVariant SubvolumeModel::data(const QModelIndex &index, int role) const
     return QVariant();
 }
 
-const Subvolume &SubvolumeModel::subvolume(int row) const { return m_data[row]; }
+const Subvolume &SubvolumeModel::subvolume(int row) const
+{
+    // A row can only be missing from its table if the changes applied didn't match the table
+    static const Subvolume empty;
+    const Row &r = m_rows.at(row);
+    const Subvolume *subvol = m_subvolumes.at(r.filesystem).constFind(r.id);
+    return subvol != nullptr ? *subvol : empty;
+}
 
 void SubvolumeModel::load(const QMap<QString, BtrfsFilesystem> &filesystems)
 {
+    TraceSpan span(QStringLiteral("SubvolumeModel::load"));
+
     // Ensure that multiple threads don't try to update the model at the same time
     QMutexLocker lock(&m_updateMutex);
 
     beginResetModel();
-    m_data.clear();
+    m_rows.clear();
+    m_filesystemUuids.clear();
+    m_subvolumes.clear();
 
-    const QList<QString> filesystemUuids = filesystems.keys();
+    for (auto it = filesystems.cbegin(); it != filesystems.cend(); ++it) {
+        const int filesystem = filesystemIndex(it.key());
+        m_subvolumes[filesystem] = it->subvolumes;
 
-    // Extract all the subvolumes
-    for (const QString &uuid : filesystemUuids) {
-        for (const Subvolume &subvol : filesystems.value(uuid).subvolumes) {
+        for (const Subvolume &subvol : it->subvolumes) {
             if (subvol.id != BTRFS_ROOT_ID && subvol.id != 0) {
-                m_data.append(subvol);
+                m_rows.append({filesystem, subvol.id});
             }
         }
     }
@@ -153,38 +182,132 @@ void SubvolumeModel::load(const QMap<QString, BtrfsFilesystem> &filesystems)
     endResetModel();
 }
 
-void SubvolumeModel::addSubvolume(const Subvolume &subvol)
+void SubvolumeModel::applyChanges(const QString &uuid, const SubvolumeMap &subvolumes, const SubvolumeChanges &changes)
 {
-    beginInsertRows(QModelIndex(), static_cast<int>(m_data.size()), static_cast<int>(m_data.size()));
-    m_data.append(subvol);
-    endInsertRows();
+    // Ensure that multiple threads don't try to update the model at the same time
+    QMutexLocker lock(&m_updateMutex);
+
+    const int filesystem = filesystemIndex(uuid);
+    const QSet<uint64_t> removed(changes.removed.cbegin(), changes.removed.cend());
+
+    const auto isRemoved = [this, filesystem, &removed](int row) {
+        return m_rows.at(row).filesystem == filesystem && removed.contains(m_rows.at(row).id);
+    };
+
+    // Walk backwards so the rows not visited yet keep their positions, neighbouring rows are removed together.  The old table is
+    // kept until the rows are gone since views may still read them.
+    for (int row = rowCount() - 1; row >= 0; --row) {
+        if (!isRemoved(row)) {
+            continue;
+        }
+
+        int first = row;
+        while (first > 0 && isRemoved(first - 1)) {
+            --first;
+        }
+
+        beginRemoveRows(QModelIndex(), first, row);
+        m_rows.remove(first, row - first + 1);
+        endRemoveRows();
+        row = first;
+    }
+
+    m_subvolumes[filesystem] = subvolumes;
+
+    if (!changes.changed.isEmpty()) {
+        const QSet<uint64_t> changed(changes.changed.cbegin(), changes.changed.cend());
+        for (int row = 0; row < m_rows.size(); ++row) {
+            if (m_rows.at(row).filesystem == filesystem && changed.contains(m_rows.at(row).id)) {
+                emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+            }
+        }
+    }
+
+    QVector<Row> added;
+    for (const uint64_t id : changes.added) {
+        if (id != BTRFS_ROOT_ID && id != 0 && subvolumes.contains(id)) {
+            added.append({filesystem, id});
+        }
+    }
+
+    if (!added.isEmpty()) {
+        beginInsertRows(QModelIndex(), rowCount(), rowCount() + static_cast<int>(added.size()) - 1);
+        m_rows.append(added);
+        endInsertRows();
+    }
 }
 
-void SubvolumeModel::updateSubvolume(const Subvolume &subvol)
+void SubvolumeModel::update(const QMap<QString, BtrfsFilesystem> &filesystems)
 {
-    for (int i = 0; i < m_data.size(); ++i) {
-        Subvolume &existing = m_data[i];
-        if (subvol.id == existing.id && subvol.filesystemUuid == existing.filesystemUuid) {
-            existing = subvol;
-            QModelIndex leftIdx = index(i, 0);
-            QModelIndex rightIdx = index(i, ColumnCount - 1);
-            emit dataChanged(leftIdx, rightIdx);
-            break;
+    TraceSpan span(QStringLiteral("SubvolumeModel::update"));
+
+    // The tables are compared before any change is applied since applying one can add a table for a new filesystem
+    const QStringList knownUuids = m_filesystemUuids;
+    for (qsizetype filesystem = 0; filesystem < knownUuids.count(); ++filesystem) {
+        if (!filesystems.contains(knownUuids.at(filesystem))) {
+            applyChanges(knownUuids.at(filesystem), SubvolumeMap(), SubvolumeChanges::between(m_subvolumes.at(filesystem), SubvolumeMap()));
         }
     }
+
+    for (auto it = filesystems.cbegin(); it != filesystems.cend(); ++it) {
+        const qsizetype filesystem = m_filesystemUuids.indexOf(it.key());
+        const SubvolumeMap known = filesystem < 0 ? SubvolumeMap() : m_subvolumes.at(filesystem);
+        applyChanges(it.key(), it->subvolumes, SubvolumeChanges::between(known, it->subvolumes));
+    }
+}
+
+int SubvolumeModel::filesystemIndex(const QString &uuid)
+{
+    qsizetype filesystem = m_filesystemUuids.indexOf(uuid);
+    if (filesystem < 0) {
+        filesystem = m_filesystemUuids.count();
+        m_filesystemUuids.append(uuid);
+        m_subvolumes.append(SubvolumeMap());
+    }
+
+    return static_cast<int>(filesystem);
 }
 
 SubvolumeFilterModel::SubvolumeFilterModel(QObject *parent) : QSortFilterProxyModel(parent)
 {
     setSortRole(static_cast<int>(SubvolumeModel::Role::Sort));
-    setFilterCaseSensitivity(Qt::CaseInsensitive);
-    setFilterKeyColumn(SubvolumeModel::Column::Name);
+
+    m_nameFilterTimer.setSingleShot(true);
+    m_nameFilterTimer.setInterval(FILTER_DELAY_MS);
+    connect(&m_nameFilterTimer, &QTimer::timeout, this, &SubvolumeFilterModel::applyNameFilter);
 }
 
 bool SubvolumeFilterModel::includeSnapshots() const { return m_includeSnapshots; }
 
 bool SubvolumeFilterModel::includeContainer() const { return m_includeContainer; }
 
+void SubvolumeFilterModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    if (m_subvolumeModel != nullptr) {
+        disconnect(m_subvolumeModel, nullptr, this, nullptr);
+    }
+
+    m_subvolumeModel = qobject_cast<SubvolumeModel *>(sourceModel);
+    m_nameMatches.clear();
+
+    // Any change to the rows makes the background match results stale so the rows are matched directly until a new result is in
+    if (m_subvolumeModel != nullptr) {
+        const auto clearMatches = [this]() {
+            m_nameMatches.clear();
+            ++m_nameFilterSerial;
+            if (m_pendingNameFilter != m_nameFilter) {
+                m_nameFilterTimer.start();
+            }
+        };
+        connect(m_subvolumeModel, &QAbstractItemModel::modelAboutToBeReset, this, clearMatches);
+        connect(m_subvolumeModel, &QAbstractItemModel::rowsAboutToBeInserted, this, clearMatches);
+        connect(m_subvolumeModel, &QAbstractItemModel::rowsAboutToBeRemoved, this, clearMatches);
+        connect(m_subvolumeModel, &QAbstractItemModel::dataChanged, this, clearMatches);
+    }
+
+    QSortFilterProxyModel::setSourceModel(sourceModel);
+}
+
 void SubvolumeFilterModel::setIncludeSnapshots(bool includeSnapshots)
 {
     if (m_includeSnapshots != includeSnapshots) {
@@ -201,17 +324,82 @@ void SubvolumeFilterModel::setIncludeContainer(bool includeContainer)
     }
 }
 
+void SubvolumeFilterModel::setNameFilter(const QString &text)
+{
+    m_pendingNameFilter = text;
+
+    // Small lists are filtered right away, it is quicker than the round trip through a worker thread
+    if (m_subvolumeModel == nullptr || m_subvolumeModel->rowCount() <= BACKGROUND_FILTER_ROWS) {
+        m_nameFilterTimer.stop();
+        ++m_nameFilterSerial;
+        m_nameFilter = text;
+        m_nameMatches.clear();
+        invalidateFilter();
+        return;
+    }
+
+    m_nameFilterTimer.start();
+}
+
 bool SubvolumeFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
 {
-    QModelIndex nameIdx = sourceModel()->index(sourceRow, static_cast<int>(SubvolumeModel::Column::Name), sourceParent);
-    const QString &name = sourceModel()->data(nameIdx).toString();
+    if (m_subvolumeModel == nullptr || sourceParent.isValid()) {
+        return false;
+    }
+
+    const Subvolume &subvol = m_subvolumeModel->subvolume(sourceRow);
 
-    if (!m_includeSnapshots && (Btrfs::isSnapper(name) || Btrfs::isTimeshift(name))) {
+    if (!m_includeSnapshots && (subvol.kind & (Subvolume::Snapper | Subvolume::Timeshift))) {
         return false;
     }
-    if (!m_includeContainer && Btrfs::isContainer(name)) {
+    if (!m_includeContainer && (subvol.kind & Subvolume::Container)) {
         return false;
     }
 
-    return QSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent);
+    if (m_nameFilter.isEmpty()) {
+        return true;
+    }
+
+    if (m_nameMatches.size() == m_subvolumeModel->rowCount()) {
+        return m_nameMatches.testBit(sourceRow);
+    }
+
+    return subvol.subvolName.contains(m_nameFilter, Qt::CaseInsensitive);
+}
+
+void SubvolumeFilterModel::applyNameFilter()
+{
+    if (m_subvolumeModel == nullptr) {
+        return;
+    }
+
+    // The names are copied here, which only bumps reference counts, so the worker never touches the model
+    const int rows = m_subvolumeModel->rowCount();
+    QStringList names;
+    names.reserve(rows);
+    for (int row = 0; row < rows; ++row) {
+        names.append(m_subvolumeModel->subvolume(row).subvolName);
+    }
+
+    const QString text = m_pendingNameFilter;
+    const quint64 serial = ++m_nameFilterSerial;
+
+    QtConcurrent::run([names, text]() {
+        QBitArray matches(static_cast<qsizetype>(names.count()));
+        for (qsizetype i = 0; i < names.count(); ++i) {
+            if (names.at(i).contains(text, Qt::CaseInsensitive)) {
+                matches.setBit(i);
+            }
+        }
+        return matches;
+    }).then(this, [this, text, serial](const QBitArray &matches) {
+        // Typing continued or the list changed while this was running
+        if (serial != m_nameFilterSerial || matches.size() != m_subvolumeModel->rowCount()) {
+            return;
+        }
+
+        m_nameFilter = text;
+        m_nameMatches = matches;
+        invalidateFilter();
+    });
 }
@@ -4,8 +4,10 @@
 #include "util/Btrfs.h"
 
 #include <QAbstractTableModel>
+#include <QBitArray>
 #include <QMutex>
 #include <QSortFilterProxyModel>
+#include <QTimer>
 
 class SubvolumeModel : public QAbstractTableModel {
     Q_OBJECT
@@ -45,31 +47,56 @@ class SubvolumeModel : public QAbstractTableModel {
     const Subvolume &subvolume(int row) const;
 
     /**
-     * @brief Populates the model using @p subvolData and @p subvolSize
-     * @param subvolData - A map of Subvolumes with subvolId as the key
-     * @param m_subvolSize - A map of QVectors where subvolId is the key and size is at index 0 and exclusize size at index 1
+     * @brief Populates the model from the subvolumes of @p filesystems
+     *
+     * The subvolume tables are shared with @p filesystems rather than copied.
+     *
+     * @param filesystems - The filesystems keyed by their UUID
      */
     void load(const QMap<QString, BtrfsFilesystem> &filesystems);
 
     /**
-     * @brief Adds a new Subvolume to the model
-     * @param subvol - A Subvolume to add
+     * @brief Applies the changes to a single filesystem with row level updates so the selection and scroll position are kept
+     * @param uuid - The UUID of the filesystem that changed
+     * @param subvolumes - The current subvolumes of the filesystem
+     * @param changes - The subvolume ids that were added, removed or changed
      */
-    void addSubvolume(const Subvolume &subvol);
+    void applyChanges(const QString &uuid, const SubvolumeMap &subvolumes, const SubvolumeChanges &changes);
 
     /**
-     * @brief Updates an existing Subvolume in the model
-     * @param subvol - A Subvolume to update
+     * @brief Brings the model in line with @p filesystems with row level updates, like applyChanges() for every filesystem
+     *
+     * The subvolumes of filesystems that are no longer in @p filesystems are removed.
      */
-    void updateSubvolume(const Subvolume &subvol);
+    void update(const QMap<QString, BtrfsFilesystem> &filesystems);
 
   private:
-    // Holds the data for the model
-    QVector<Subvolume> m_data;
+    // A row refers to a subvolume by its id in one of the filesystem tables
+    struct Row {
+        int filesystem = 0;
+        uint64_t id = 0;
+    };
+
+    /**
+     * @brief Returns the index of the table for @p uuid, adding an empty one if there isn't one yet
+     */
+    int filesystemIndex(const QString &uuid);
+
+    // The rows in display order
+    QVector<Row> m_rows;
+    // The UUIDs of the filesystems and their subvolume tables at the same index
+    QStringList m_filesystemUuids;
+    QVector<SubvolumeMap> m_subvolumes;
     // Used to ensure only one model update runs at a time
     QMutex m_updateMutex;
 };
 
+/**
+ * @brief Filters the subvolume list by kind and by a case insensitive name search
+ *
+ * The source model must be a SubvolumeModel, the filter reads the subvolumes from it directly.  On large lists the name search
+ * waits until typing pauses and the names are matched on a worker thread, the view is only refiltered once the result is in.
+ */
 class SubvolumeFilterModel : public QSortFilterProxyModel {
     Q_OBJECT
   public:
@@ -78,16 +105,38 @@ class SubvolumeFilterModel : public QSortFilterProxyModel {
     bool includeSnapshots() const;
     bool includeContainer() const;
 
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
   public slots:
     void setIncludeSnapshots(bool includeSnapshots);
     void setIncludeContainer(bool includeContainer);
 
+    /**
+     * @brief Shows only the subvolumes whose name contains @p text, ignoring case
+     */
+    void setNameFilter(const QString &text);
+
   protected:
     bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
 
   private:
+    /**
+     * @brief Matches the pending name filter against every row on a worker thread and refilters once that is done
+     */
+    void applyNameFilter();
+
     bool m_includeSnapshots = false;
     bool m_includeContainer = false;
+
+    SubvolumeModel *m_subvolumeModel = nullptr;
+    QString m_nameFilter;
+    QString m_pendingNameFilter;
+    // Restarted on every change to the name filter of a large list
+    QTimer m_nameFilterTimer;
+    // One bit per source row with the result of the background match, empty when the rows need to be matched directly
+    QBitArray m_nameMatches;
+    // Identifies the latest background match so older results that finish late are ignored
+    quint64 m_nameFilterSerial = 0;
 };
 
 #endif // SUBVOLMODEL_H
@@ -40,6 +40,79 @@ int Cli::listSnapshots(Snapper *snapper)
     return 0;
 }
 
+int Cli::listChanges(Btrfs *btrfs, Snapper *snapper, const QString &indexes)
+{
+    // Ensure the application is running as root
+    if (!System::checkRootUid()) {
+        displayError(tr("You must run this application as root"));
+        return 1;
+    }
+
+    const QStringList snapshotInfoList = getSnapperSnapshotList(snapper);
+
+    QVector<QStringList> selectedSnapshots;
+    const QStringList indexList = indexes.split(',');
+    for (const QString &index : indexList) {
+        bool isNumber = false;
+        const int number = index.trimmed().toInt(&isNumber);
+        if (!isNumber || number < 1 || number > snapshotInfoList.count()) {
+            displayError(tr("%1 is not the index of a snapshot").arg(index));
+            return 1;
+        }
+        selectedSnapshots.append(snapshotInfoList.at(number - 1).split("\t"));
+    }
+
+    if (selectedSnapshots.count() > 2) {
+        displayError(tr("At most two snapshots can be compared"));
+        return 1;
+    }
+
+    // The older snapshot is the parent whichever order the indexes were given in, otherwise created and deleted are swapped
+    std::sort(selectedSnapshots.begin(), selectedSnapshots.end(),
+              [](const QStringList &a, const QStringList &b) { return a.at(1).toInt() < b.at(1).toInt(); });
+
+    const QString uuid = selectedSnapshots.first().at(5);
+    const uint64_t parentId = btrfs->subvolId(uuid, selectedSnapshots.first().at(4));
+
+    // A single snapshot is compared with the subvolume it was taken of
+    uint64_t childId = 0;
+    if (selectedSnapshots.count() == 2) {
+        if (selectedSnapshots.at(1).at(5) != uuid) {
+            displayError(tr("The snapshots must be on the same filesystem"));
+            return 1;
+        }
+        childId = btrfs->subvolId(uuid, selectedSnapshots.at(1).at(4));
+    } else {
+        childId = btrfs->subvolId(uuid, selectedSnapshots.first().at(0));
+    }
+
+    const FileChanges changes = btrfs->compareSubvolumes(uuid, parentId, childId).result();
+    if (!changes.error.isEmpty()) {
+        displayError(changes.error);
+        return 1;
+    }
+
+    // The same markers as snapper status, a renamed path is followed by where it was before
+    for (const FileChange &change : changes.changes) {
+        switch (change.type) {
+        case FileChange::Created:
+            QTextStream(stdout) << "+\t" << change.path << Qt::endl;
+            break;
+        case FileChange::Deleted:
+            QTextStream(stdout) << "-\t" << change.path << Qt::endl;
+            break;
+        case FileChange::Modified:
+            QTextStream(stdout) << "c\t" << change.path << Qt::endl;
+            break;
+        case FileChange::Renamed:
+            QTextStream(stdout) << "r\t" << change.path << "\t" << change.oldPath << Qt::endl;
+            break;
+        }
+    }
+
+    return 0;
+}
+
 int Cli::restore(Btrfs *btrfs, Snapper *snapper, const int index)
 {
     // Ensure the application is running as root
@@ -20,6 +20,13 @@ public:
      * @return
      */
     static int listSnapshots(Snapper *snapper);
+
+    /**
+     * @brief Prints the files that changed between two snapshots or since a snapshot
+     * @param indexes - One index from the snapshot list to compare with its live target, or two separated by a comma
+     * @return 0 on success, 1 otherwise
+     */
+    static int listChanges(Btrfs *btrfs, Snapper *snapper, const QString &indexes);
     static int restore(Btrfs *btrfs, Snapper *snapper, const int index);
 
 private:
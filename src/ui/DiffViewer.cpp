@@ -1,9 +1,32 @@
 #include "ui/DiffViewer.h"
-#include "util/System.h"
+#include "model/DiffModel.h"
+#include "util/FileVersion.h"
 
+#include <QAction>
+#include <QClipboard>
 #include <QDialog>
 #include <QDir>
+#include <QGuiApplication>
 #include <QMessageBox>
+#include <QRegularExpression>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+namespace {
+
+// A snapshot that may hold a version of the file being compared
+struct SnapshotFile {
+    uint number = 0;
+    // The absolute path the file would have in the snapshot
+    QString path;
+    SnapperSnapshot snapshot;
+    FileVersion version;
+};
+
+} // namespace
 
 DiffViewer::DiffViewer(Snapper *snapper, const QString &rootPath, const QString &filePath, const QString &uuid, QWidget *parent)
     : QDialog(parent), m_ui(new Ui::DiffViewer), m_snapper(snapper), m_uuid(uuid)
@@ -15,6 +38,18 @@ DiffViewer::DiffViewer(Snapper *snapper, const QString &rootPath, const QString
 
     m_twSnapshot = m_ui->tableWidget_snapshotList;
 
+    // Only the lines on screen are formatted, so the view stays responsive however long the diff is
+    m_diffModel = new DiffModel(this);
+    m_diffModel->setMessage(tr("Select a snapshot from the left to see the diff"));
+    m_ui->listView_diff->setModel(m_diffModel);
+
+    QAction *copyAction = new QAction(tr("Copy"), m_ui->listView_diff);
+    copyAction->setShortcut(QKeySequence::Copy);
+    copyAction->setShortcutContext(Qt::WidgetShortcut);
+    connect(copyAction, &QAction::triggered, this, &DiffViewer::copyDiffSelection);
+    m_ui->listView_diff->addAction(copyAction);
+    m_ui->listView_diff->setContextMenuPolicy(Qt::ActionsContextMenu);
+
     // We will need the target path for both diffs and restores
     m_targetPath = m_snapper->findTargetPath(rootPath, filePath, uuid);
 
@@ -22,7 +57,23 @@ DiffViewer::DiffViewer(Snapper *snapper, const QString &rootPath, const QString
     LoadSnapshots(rootPath, filePath);
 }
 
-DiffViewer::~DiffViewer() { delete m_ui; }
+DiffViewer::~DiffViewer()
+{
+    m_diffFuture.cancel();
+    delete m_ui;
+}
+
+void DiffViewer::copyDiffSelection()
+{
+    QModelIndexList indexes = m_ui->listView_diff->selectionModel()->selectedIndexes();
+    std::sort(indexes.begin(), indexes.end());
+
+    QStringList lines;
+    for (const QModelIndex &index : std::as_const(indexes)) {
+        lines.append(index.data().toString());
+    }
+    QGuiApplication::clipboard()->setText(lines.join('\n'));
+}
 
 void DiffViewer::on_pushButton_restore_clicked()
 {
@@ -42,69 +93,100 @@ void DiffViewer::on_pushButton_restore_clicked()
     QMessageBox::information(this, tr("Restore File"), tr("The file was successfully restored"));
 }
 
-#include <QDebug>
 void DiffViewer::LoadSnapshots(const QString &rootPath, const QString &filePath)
 {
-    QDir snapshotDir(rootPath);
-
-    QString relPath = snapshotDir.relativeFilePath(filePath);
-
-    static QRegularExpression re("\\/[0-9]*\\/snapshot$");
-    const QStringList subvolSplit = rootPath.split(re);
-    const QDir stemPath(subvolSplit.at(0));
-    const QString wildcardPath = QDir::cleanPath(stemPath.canonicalPath() + "/*/snapshot/" + relPath).replace(" ", "\\ ");
+    const QString relPath = QDir(rootPath).relativeFilePath(filePath);
+
+    // The snapshots are numbered directories next to each other, such as /.snapshots/<number>/snapshot
+    static const QRegularExpression re("\\/[0-9]*\\/snapshot$");
+    const QString stemPath = QDir::cleanPath(rootPath.split(re).at(0));
+
+    // Only the snapshots snapper already knows about are checked, the directory is only listed when none of them were loaded
+    QVector<SnapshotFile> snapshotFiles;
+    const QMap<uint, SnapperSnapshot> knownSnapshots = m_snapper->cachedSnapshots(stemPath);
+    if (!knownSnapshots.isEmpty()) {
+        for (auto it = knownSnapshots.cbegin(); it != knownSnapshots.cend(); ++it) {
+            snapshotFiles.append({it.key(), {}, it.value(), {}});
+        }
+    } else {
+        const QStringList entries = QDir(stemPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &entry : entries) {
+            bool isNumber = false;
+            const uint number = entry.toUInt(&isNumber);
+            if (isNumber) {
+                snapshotFiles.append({number, {}, {}, {}});
+            }
+        }
+    }
 
-    const QStringList resultList = System::runCmd("ls " + wildcardPath, false).output.split("\n");
+    // Each check is a statx and a FIEMAP call so a small pool finishes thousands of snapshots quickly, small batches stay on one thread
+    QThreadPool pool;
+    pool.setMaxThreadCount(std::clamp(static_cast<int>(snapshotFiles.count() / 64), 1, QThread::idealThreadCount()));
+    QtConcurrent::blockingMap(&pool, snapshotFiles, [&stemPath, &relPath](SnapshotFile &snapshotFile) {
+        const QString snapshotDir = stemPath + QDir::separator() + QString::number(snapshotFile.number);
+        snapshotFile.path = QDir::cleanPath(snapshotDir + "/snapshot/" + relPath);
+        snapshotFile.version = FileVersion::read(snapshotFile.path);
+
+        // A snapshot that isn't in the cache still needs its metadata read
+        if (snapshotFile.version.exists() && snapshotFile.snapshot.number == 0) {
+            snapshotFile.snapshot = Snapper::readSnapperMeta(snapshotDir + "/info.xml");
+        }
+    });
+    snapshotFiles.removeIf([](const SnapshotFile &snapshotFile) { return !snapshotFile.version.exists(); });
+    std::sort(snapshotFiles.begin(), snapshotFiles.end(), [](const SnapshotFile &a, const SnapshotFile &b) { return a.number < b.number; });
+
+    // Consecutive snapshots that share the same extents hold the same data, each run of them is shown as a single row
+    QVector<std::pair<qsizetype, qsizetype>> groups;
+    for (qsizetype i = 0; i < snapshotFiles.count(); ++i) {
+        if (!groups.isEmpty() && snapshotFiles.at(groups.last().second).version.isSameAs(snapshotFiles.at(i).version)) {
+            groups.last().second = i;
+        } else {
+            groups.append({i, i});
+        }
+    }
 
     // Clear the table and set the headers
     m_twSnapshot->clear();
-    m_twSnapshot->setColumnCount(4);
+    m_twSnapshot->setColumnCount(5);
     m_twSnapshot->setHorizontalHeaderItem(DiffColumn::num, new QTableWidgetItem(tr("Num", "The number associated with a snapshot")));
     m_twSnapshot->setHorizontalHeaderItem(DiffColumn::dateTime, new QTableWidgetItem(tr("Date/Time")));
+    m_twSnapshot->setHorizontalHeaderItem(DiffColumn::unchanged, new QTableWidgetItem(tr("Unchanged")));
     m_twSnapshot->setHorizontalHeaderItem(DiffColumn::rootPath, new QTableWidgetItem(tr("Root Path")));
     m_twSnapshot->setHorizontalHeaderItem(DiffColumn::filePath, new QTableWidgetItem(tr("File Path")));
     m_twSnapshot->setColumnHidden(DiffColumn::rootPath, true);
     m_twSnapshot->setColumnHidden(DiffColumn::filePath, true);
-    m_twSnapshot->setRowCount(static_cast<int>(resultList.count()));
+    m_twSnapshot->setRowCount(static_cast<int>(groups.count()));
 
     // We need to the locale for displaying the date/time
     QLocale locale = QLocale::system();
 
     int row = 0;
 
-    for (const QString &result : resultList) {
-        const QString endPath = stemPath.relativeFilePath(result);
-
-        // Find the snapshot number part of the path
-        const QString snapshotNum = endPath.split("/").at(0);
-
-        // Find the rootPath
-        const QString thisRootPath = QDir::cleanPath(stemPath.canonicalPath() + QDir::separator() + endPath.split(relPath).at(0));
-
-        // Get the date
-        const QString metaFileName =
-            QDir::cleanPath(stemPath.canonicalPath() + QDir::separator() + snapshotNum + QDir::separator() + "info.xml");
-        const QString date = locale.toString(Snapper::readSnapperMeta(metaFileName).time, QLocale::ShortFormat);
-
-        if (snapshotNum.isEmpty() || result.isEmpty() || thisRootPath.isEmpty()) {
-            continue;
-        }
+    for (const auto &[first, last] : std::as_const(groups)) {
+        // The newest snapshot of a group stands for all of them, they hold the same file
+        const SnapshotFile &snapshotFile = snapshotFiles.at(last);
+        const QString thisRootPath = stemPath + QDir::separator() + QString::number(snapshotFile.number) + "/snapshot";
 
         // Populate the row in the table
-        QTableWidgetItem *number = new QTableWidgetItem(snapshotNum.toInt());
-        number->setData(Qt::DisplayRole, snapshotNum.toInt());
+        QTableWidgetItem *number = new QTableWidgetItem;
+        number->setData(Qt::DisplayRole, snapshotFile.number);
         m_twSnapshot->setItem(row, DiffColumn::num, number);
+        const QString date = locale.toString(snapshotFile.snapshot.time, QLocale::ShortFormat);
         m_twSnapshot->setItem(row, DiffColumn::dateTime, new QTableWidgetItem(date));
+        // The table has no visible header so the range says what it is
+        const QString unchanged =
+            first == last ? QString() : tr("Unchanged from #%1 to #%2").arg(snapshotFiles.at(first).number).arg(snapshotFile.number);
+        m_twSnapshot->setItem(row, DiffColumn::unchanged, new QTableWidgetItem(unchanged));
         m_twSnapshot->setItem(row, DiffColumn::rootPath, new QTableWidgetItem(thisRootPath));
-        m_twSnapshot->setItem(row, DiffColumn::filePath, new QTableWidgetItem(result.trimmed()));
+        m_twSnapshot->setItem(row, DiffColumn::filePath, new QTableWidgetItem(snapshotFile.path));
 
-        if (result.trimmed() == filePath) {
-            m_twSnapshot->selectRow(row);
+        for (qsizetype i = first; i <= last; ++i) {
+            if (snapshotFiles.at(i).path == filePath) {
+                m_twSnapshot->selectRow(row);
+            }
         }
 
         row++;
-
-        qDebug() << relPath << subvolSplit.at(0) << Qt::endl;
     }
     m_twSnapshot->resizeColumnsToContents();
     m_twSnapshot->sortItems(DiffColumn::num, Qt::DescendingOrder);
@@ -113,27 +195,35 @@ void DiffViewer::LoadSnapshots(const QString &rootPath, const QString &filePath)
 void DiffViewer::on_tableWidget_snapshotList_itemSelectionChanged()
 {
     const QString filePath = m_twSnapshot->item(m_twSnapshot->currentRow(), DiffColumn::filePath)->text();
-    const QStringList diffOutput = System::runCmd("diff", {"-u", m_targetPath, filePath}, false).output.split("\n");
-
-    if (diffOutput.isEmpty() || diffOutput.at(0).isEmpty()) {
-        m_ui->textEdit_diff->setText(tr("There are no differences between the selected files"));
-        return;
-    }
 
-    // Get a copy of the palette before we start changing colors
-    QPalette defaultPalette = m_ui->textEdit_diff->palette();
-
-    // Show the diff
-    m_ui->textEdit_diff->clear();
-    for (const QString &line : diffOutput) {
-        // Colorize the output for lines added or removed
-        if (line.startsWith("+")) {
-            m_ui->textEdit_diff->setTextColor(Qt::darkGreen);
-        } else if (line.startsWith("-")) {
-            m_ui->textEdit_diff->setTextColor(Qt::red);
+    m_diffFuture.cancel();
+    const quint64 serial = ++m_diffSerial;
+    m_diffModel->setMessage(tr("Comparing the selected files..."));
+
+    const QString targetPath = m_targetPath;
+    m_diffFuture = QtConcurrent::run([targetPath, filePath](QPromise<DiffResult> &promise) {
+        // The target is the live file which can be truncated while the diff is shown, only the snapshot side is mapped
+        promise.addResult(Diff::compare(targetPath, filePath, DiffText::Access::Copy, DiffText::Access::Map,
+                                        [&promise]() { return promise.isCanceled(); }));
+    });
+    m_diffFuture.then(this, [this, serial](const DiffResult &result) {
+        if (serial != m_diffSerial) {
+            return;
         }
 
-        m_ui->textEdit_diff->append(line);
-        m_ui->textEdit_diff->setTextColor(defaultPalette.text().color());
-    }
+        if (!result.error.isEmpty()) {
+            m_diffModel->setMessage(result.error);
+        } else if (result.isBinary) {
+            m_diffModel->setMessage(tr("The selected files are binary and differ"));
+        } else if (result.isIdentical()) {
+            m_diffModel->setMessage(tr("There are no differences between the selected files"));
+        } else {
+            m_diffModel->setResult(result);
+
+            // Every row gets the size of the widest one so the view can scroll horizontally without measuring each line
+            const QFontMetrics metrics(m_ui->listView_diff->font());
+            const QString longest = m_diffModel->index(m_diffModel->longestRow()).data().toString();
+            m_diffModel->setRowSize(QSize(metrics.horizontalAdvance(longest) + 2 * metrics.averageCharWidth(), metrics.height()));
+        }
+    });
 }
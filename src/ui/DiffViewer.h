@@ -1,10 +1,15 @@
 #ifndef DIFFVIEWER_H
 #define DIFFVIEWER_H
 
+#include "util/Diff.h"
 #include "util/Snapper.h"
 #include "ui_DiffViewer.h"
 
-enum DiffColumn { num, dateTime, rootPath, filePath };
+#include <QFuture>
+
+class DiffModel;
+
+enum DiffColumn { num, dateTime, unchanged, rootPath, filePath };
 
 namespace Ui {
 class DiffViewer;
@@ -26,7 +31,7 @@ class DiffViewer : public QDialog {
     void on_pushButton_restore_clicked();
 
     /**
-     * @brief When a selection changes in the table, update the diff textEdit widget
+     * @brief When a selection changes in the table, compare the files in the background and show the diff once it is done
      */
     void on_tableWidget_snapshotList_itemSelectionChanged();
 
@@ -38,9 +43,21 @@ class DiffViewer : public QDialog {
     // This a convenience pointer to m_ui->tableWidget_snapshotList to improve readability
     QTableWidget *m_twSnapshot;
     QString m_uuid;
+    DiffModel *m_diffModel = nullptr;
+    // The comparison for the latest selection, stopped when the selection changes before it is done
+    QFuture<DiffResult> m_diffFuture;
+    // Identifies the latest comparison so the result of an earlier one is never shown
+    quint64 m_diffSerial = 0;
+
+    /**
+     * @brief Copies the selected lines of the diff to the clipboard
+     */
+    void copyDiffSelection();
 
     /**
      * @brief Finds all the snapshots that contain the file and populated the grid
+     *
+     * Consecutive snapshots whose copies share the same extents are shown as one row for the newest of them.
      * @param rootPath - The absolute path to the snapshot
      * @param filePath - The absolute path to the file selected within the snapshot
      */
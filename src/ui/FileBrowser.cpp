@@ -1,10 +1,15 @@
 #include "FileBrowser.h"
 #include "DiffViewer.h"
+#include "model/PathFilterModel.h"
 #include "ui_FileBrowser.h"
 
 #include <QDesktopServices>
 #include <QDir>
 #include <QMessageBox>
+#include <QSignalBlocker>
+
+#include <algorithm>
+#include <utility>
 
 void FileBrowser::intializeFileBrowser(const QString &rootPath)
 {
@@ -31,18 +36,82 @@ void FileBrowser::intializeFileBrowser(const QString &rootPath)
     m_treeView->setRootIndex(m_fileModel->index(rootPath));
     m_treeView->hideColumn(TypeColumn);
     m_treeView->sortByColumn(0, Qt::AscendingOrder);
+
+    m_filterModel = new PathFilterModel(this);
+    m_filterModel->setSourceModel(m_fileModel);
+
+    populateChangedSince();
 }
 
-FileBrowser::FileBrowser(Snapper *snapper, const QString &rootPath, const QString &uuid, QWidget *parent)
-    : QDialog(parent), m_ui(new Ui::FileBrowser), m_rootPath(rootPath), m_uuid(uuid), m_snapper(snapper)
+void FileBrowser::populateChangedSince()
+{
+    // The list is filled before anything is shown, selecting its first entry doesn't need to swap the model
+    const QSignalBlocker blocker(m_ui->comboBox_changedSince);
+    m_ui->comboBox_changedSince->addItem(tr("All files"));
+
+    const SubvolResult subvolName = Btrfs::subvolumeName(m_rootPath);
+    const SubvolumeMap subvolumes = m_btrfs->filesystem(m_uuid).subvolumes;
+    const Subvolume *browsed = subvolName.success ? subvolumes.constFind(subvolumes.idOf(subvolName.name)) : nullptr;
+    if (browsed == nullptr) {
+        m_ui->label_changedSince->hide();
+        m_ui->comboBox_changedSince->hide();
+        return;
+    }
+    m_subvolId = browsed->id;
+
+    // A snapshot is compared with the other snapshots of its origin and a subvolume with its own snapshots
+    const uint64_t originId = browsed->parentUuid.isNull() ? browsed->id : subvolumes.idOfUuid(browsed->parentUuid);
+    QVector<Subvolume> references;
+    const Subvolume *origin = subvolumes.constFind(originId);
+    if (origin != nullptr) {
+        references.append(*origin);
+        const QList<uint64_t> snapshotIds = subvolumes.snapshotsOf(origin->uuid);
+        for (const uint64_t id : snapshotIds) {
+            references.append(subvolumes.value(id));
+        }
+    }
+
+    // Only a reference written before the browsed subvolume can be searched for what changed after it, newest first
+    const uint64_t browsedGeneration = browsed->generation;
+    const uint64_t browsedId = browsed->id;
+    references.erase(std::remove_if(references.begin(), references.end(),
+                                    [browsedId, browsedGeneration](const Subvolume &subvol) {
+                                        return subvol.id == browsedId || subvol.generation >= browsedGeneration;
+                                    }),
+                     references.end());
+    std::sort(references.begin(), references.end(), [](const Subvolume &a, const Subvolume &b) { return a.generation > b.generation; });
+
+    for (const Subvolume &subvol : std::as_const(references)) {
+        m_ui->comboBox_changedSince->addItem(subvol.subvolName, QVariant::fromValue<qulonglong>(subvol.generation));
+    }
+
+    m_ui->comboBox_changedSince->setEnabled(!references.isEmpty());
+}
+
+QModelIndex FileBrowser::selectedFileIndex() const
+{
+    const QModelIndexList indexes = m_treeView->selectionModel()->selectedIndexes();
+    if (indexes.isEmpty()) {
+        return QModelIndex();
+    }
+
+    if (m_treeView->model() == m_filterModel) {
+        return m_filterModel->mapToSource(indexes.at(0));
+    }
+
+    return indexes.at(0);
+}
+
+FileBrowser::FileBrowser(Btrfs *btrfs, Snapper *snapper, const QString &rootPath, const QString &uuid, QWidget *parent)
+    : QDialog(parent), m_ui(new Ui::FileBrowser), m_rootPath(rootPath), m_uuid(uuid), m_btrfs(btrfs), m_snapper(snapper)
 {
     intializeFileBrowser(rootPath);
 
     this->setWindowTitle(tr("Snapshot File Viewer"));
 }
 
-FileBrowser::FileBrowser(const QString &rootPath, const QString &uuid, QWidget *parent)
-    : QDialog(parent), m_ui(new Ui::FileBrowser), m_rootPath(rootPath), m_uuid(uuid)
+FileBrowser::FileBrowser(Btrfs *btrfs, const QString &rootPath, const QString &uuid, QWidget *parent)
+    : QDialog(parent), m_ui(new Ui::FileBrowser), m_rootPath(rootPath), m_uuid(uuid), m_btrfs(btrfs)
 {
     intializeFileBrowser(rootPath);
 
@@ -60,20 +129,20 @@ void FileBrowser::on_pushButton_close_clicked() { this->close(); }
 void FileBrowser::on_pushButton_diff_clicked()
 {
     // Get the selected row and ensure it isn't empty
-    QModelIndexList indexes = m_treeView->selectionModel()->selectedIndexes();
-    if (indexes.count() == 0) {
+    const QModelIndex index = selectedFileIndex();
+    if (!index.isValid()) {
         return;
     }
 
     // Check to be sure it isn't a directory
-    if (m_fileModel->isDir(indexes.at(0))) {
+    if (m_fileModel->isDir(index)) {
         QMessageBox::information(this, tr("Diff File"),
-                                 m_fileModel->fileName(indexes.at(0)) + tr(" is a directory, only files can be diffed"));
+                                 m_fileModel->fileName(index) + tr(" is a directory, only files can be diffed"));
         return;
     }
 
     // Grad the path of the selected file
-    const QString filePath = m_fileModel->filePath(indexes.at(0));
+    const QString filePath = m_fileModel->filePath(index);
 
     // Create DiffViewer dialog
     DiffViewer df(m_snapper, m_rootPath, filePath, m_uuid);
@@ -83,15 +152,15 @@ void FileBrowser::on_pushButton_diff_clicked()
 void FileBrowser::on_pushButton_restore_clicked()
 {
     // Get the selected row and ensure it isn't empty
-    QModelIndexList indexes = m_treeView->selectionModel()->selectedIndexes();
-    if (indexes.count() == 0) {
+    const QModelIndex index = selectedFileIndex();
+    if (!index.isValid()) {
         return;
     }
 
     // Check to be sure it isn't a directory
-    if (m_fileModel->isDir(indexes.at(0))) {
+    if (m_fileModel->isDir(index)) {
         QMessageBox::information(this, tr("Restore File"),
-                                 m_fileModel->fileName(indexes.at(0)) + tr(" is a directory, only files can be restored"));
+                                 m_fileModel->fileName(index) + tr(" is a directory, only files can be restored"));
         return;
     }
 
@@ -101,7 +170,7 @@ void FileBrowser::on_pushButton_restore_clicked()
     }
 
     // Restore the file
-    const QString filePath = m_fileModel->filePath(indexes.at(0));
+    const QString filePath = m_fileModel->filePath(index);
 
     const QString targetPath = m_snapper->findTargetPath(m_rootPath, filePath, m_uuid);
 
@@ -112,3 +181,41 @@ void FileBrowser::on_pushButton_restore_clicked()
 
     QMessageBox::information(this, tr("Restore File"), tr("The file was successfully restored"));
 }
+
+void FileBrowser::on_comboBox_changedSince_currentIndexChanged(int index)
+{
+    const quint64 serial = ++m_changedSerial;
+    if (index <= 0) {
+        m_treeView->setModel(m_fileModel);
+        m_treeView->setRootIndex(m_fileModel->index(m_rootPath));
+        return;
+    }
+
+    const uint64_t generation = m_ui->comboBox_changedSince->itemData(index).toULongLong();
+    m_ui->comboBox_changedSince->setEnabled(false);
+    m_btrfs->findChangedSince(m_uuid, m_subvolId, generation).then(this, [this, serial](const ChangedInodes &changes) {
+        if (serial != m_changedSerial) {
+            return;
+        }
+        m_ui->comboBox_changedSince->setEnabled(true);
+
+        // An empty tree would read as nothing having changed, so the whole tree is shown again instead
+        if (!changes.error.isEmpty()) {
+            QMessageBox::warning(this, tr("Changed Files"), changes.error);
+            m_ui->comboBox_changedSince->setCurrentIndex(0);
+            return;
+        }
+
+        // The directories are shown anyway as the parents of the files changed in them
+        QStringList paths;
+        for (const ChangedInode &inode : changes.inodes) {
+            if (!inode.isDirectory) {
+                paths.append(m_rootPath + QLatin1Char('/') + inode.path);
+            }
+        }
+
+        m_filterModel->setPaths(m_rootPath, paths);
+        m_treeView->setModel(m_filterModel);
+        m_treeView->setRootIndex(m_filterModel->mapFromSource(m_fileModel->index(m_rootPath)));
+    });
+}
@@ -1,12 +1,15 @@
 #ifndef FILEBROWSER_H
 #define FILEBROWSER_H
 
+#include "util/Btrfs.h"
 #include "util/Snapper.h"
 
 #include <QDialog>
 #include <QFileSystemModel>
 #include <QTreeView>
 
+class PathFilterModel;
+
 namespace Ui {
 class FileBrowser;
 }
@@ -18,23 +21,45 @@ class FileBrowser : public QDialog {
     Q_OBJECT
 
   public:
-    FileBrowser(Snapper *snapper, const QString &rootPath, const QString &uuid, QWidget *parent = nullptr);
-    FileBrowser(const QString &rootPath, const QString &uuid, QWidget *parent = nullptr);
+    FileBrowser(Btrfs *btrfs, Snapper *snapper, const QString &rootPath, const QString &uuid, QWidget *parent = nullptr);
+    FileBrowser(Btrfs *btrfs, const QString &rootPath, const QString &uuid, QWidget *parent = nullptr);
     ~FileBrowser();
 
   private:
     Ui::FileBrowser *m_ui = nullptr;
     QString m_rootPath;
     QString m_uuid;
+    Btrfs *m_btrfs = nullptr;
     Snapper *m_snapper = nullptr;
     QTreeView *m_treeView = nullptr;
     QFileSystemModel *m_fileModel = nullptr;
+    // Sits between the file model and the tree view while only the changed files are shown
+    PathFilterModel *m_filterModel = nullptr;
+    // The id of the browsed subvolume, 0 if it isn't known
+    uint64_t m_subvolId = 0;
+    // Identifies the latest search for changed files so the result of an earlier one is never shown
+    quint64 m_changedSerial = 0;
     void intializeFileBrowser(const QString &rootPath);
 
+    /**
+     * @brief Fills the changed since list with the snapshots of the browsed subvolume's origin that are older than it
+     */
+    void populateChangedSince();
+
+    /**
+     * @brief Returns the file model index of the selected row or an invalid index if nothing is selected
+     */
+    QModelIndex selectedFileIndex() const;
+
   private slots:
     void on_pushButton_close_clicked();
     void on_pushButton_diff_clicked();
     void on_pushButton_restore_clicked();
+
+    /**
+     * @brief Shows only the files changed after the selected subvolume was written, the first entry shows every file
+     */
+    void on_comboBox_changedSince_currentIndexChanged(int index);
 };
 
 #endif // FILEBROWSER_H
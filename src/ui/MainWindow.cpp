@@ -1,24 +1,27 @@
 #include "ui/MainWindow.h"
+#include "model/SnapperModel.h"
 #include "model/SubvolModel.h"
 #include "ui/FileBrowser.h"
 #include "ui/RestoreConfirmDialog.h"
+#include "ui/SnapshotChangesDialog.h"
 #include "ui/SnapshotSubvolumeDialog.h"
 #include "ui_MainWindow.h"
 #include "util/Btrfs.h"
 #include "util/BtrfsMaintenance.h"
+#include "util/Loader.h"
+#include "util/ProgressMonitor.h"
 #include "util/Snapper.h"
 #include "util/System.h"
+#include "util/Tracer.h"
 
 #include <QDebug>
 #include <QInputDialog>
 #include <QMenu>
 #include <QMessageBox>
-#include <QTimer>
-
-namespace {
-enum class SnapperRestoreTableColumn { Number, Subvolume, DateTime, Type, Description };
-
-}
+#include <QProgressBar>
+#include <QSortFilterProxyModel>
+#include <QStatusBar>
+#include <QtConcurrent>
 
 constexpr const char *PARTITION_ROOT_TEXT = "Partition root";
 
@@ -29,6 +32,37 @@ constexpr const char *PARTITION_ROOT_TEXT = "Partition root";
  */
 static const QString cleanTargetSubvol(const QString subvol) { return subvol == PARTITION_ROOT_TEXT ? QString() : subvol; }
 
+/**
+ * @brief Formats a number of @p seconds as hours, minutes and seconds, for example 2:05:09
+ */
+static QString formatDuration(qint64 seconds)
+{
+    return QStringLiteral("%1:%2:%3").arg(seconds / 3600).arg(seconds / 60 % 60, 2, 10, QChar('0')).arg(seconds % 60, 2, 10, QChar('0'));
+}
+
+/**
+ * @brief Runs an asynchronous snapper operation on each of @p items, starting the next one when the previous one finishes
+ * @param context - The object the continuations run on, nothing more is started if it is destroyed
+ * @param items - The items to run the operation on
+ * @param run - Starts the operation for a single item
+ * @param done - Called with the results of all the operations, in the same order as @p items
+ * @param results - The results collected so far, only used when recursing
+ */
+template <typename T>
+static void runInSequence(QObject *context, const QList<T> &items, const std::function<QFuture<SnapperResult>(const T &)> &run,
+                          const std::function<void(const QVector<SnapperResult> &)> &done, QVector<SnapperResult> results = {})
+{
+    if (results.count() >= items.count()) {
+        done(results);
+        return;
+    }
+
+    run(items.at(results.count())).then(context, [context, items, run, done, results](const SnapperResult &result) mutable {
+        results.append(result);
+        runInSequence(context, items, run, done, results);
+    });
+}
+
 /**
  * @brief Selects all rows in @p listWidget that match an item in @p items
  * @param items - A QStringList which contain the strings to select in @p listWidget
@@ -67,15 +101,60 @@ MainWindow::MainWindow(Btrfs *btrfs, BtrfsMaintenance *btrfsMaintenance, Snapper
     m_subvolumeFilterModel = new SubvolumeFilterModel(this);
     m_subvolumeFilterModel->setSourceModel(m_subvolumeModel);
 
-    connect(m_ui->lineEdit_subvolFilter, &QLineEdit::textChanged, m_subvolumeFilterModel, &SubvolumeFilterModel::setFilterFixedString);
+    connect(m_ui->lineEdit_subvolFilter, &QLineEdit::textChanged, m_subvolumeFilterModel, &SubvolumeFilterModel::setNameFilter);
     connect(m_ui->checkBox_subvolIncludeSnapshots, &QCheckBox::toggled, m_subvolumeFilterModel, &SubvolumeFilterModel::setIncludeSnapshots);
     connect(m_ui->checkBox_subvolIncludeContainer, &QCheckBox::toggled, m_subvolumeFilterModel, &SubvolumeFilterModel::setIncludeContainer);
 
-    // timers for filesystem operations
-    m_balanceTimer = new QTimer(this);
-    m_scrubTimer = new QTimer(this);
-    connect(m_balanceTimer, &QTimer::timeout, this, &MainWindow::btrfsBalanceStatusUpdateUI);
-    connect(m_scrubTimer, &QTimer::timeout, this, &MainWindow::btrfsScrubStatusUpdateUI);
+    m_snapperSnapshotModel = new SnapperSnapshotModel(this);
+    m_snapperSnapshotProxyModel = new QSortFilterProxyModel(this);
+    m_snapperSnapshotProxyModel->setSortRole(SnapperSnapshotModel::Role::Sort);
+    m_snapperSnapshotProxyModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
+    m_snapperSnapshotProxyModel->setFilterKeyColumn(-1);
+    m_snapperSnapshotProxyModel->setSourceModel(m_snapperSnapshotModel);
+    connect(m_ui->lineEdit_snapperNewFilter, &QLineEdit::textChanged, m_snapperSnapshotProxyModel,
+            &QSortFilterProxyModel::setFilterFixedString);
+
+    m_snapperSubvolumeModel = new SnapperSubvolumeModel(this);
+    m_snapperSubvolumeProxyModel = new QSortFilterProxyModel(this);
+    m_snapperSubvolumeProxyModel->setSortRole(SnapperSubvolumeModel::Role::Sort);
+    m_snapperSubvolumeProxyModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
+    m_snapperSubvolumeProxyModel->setFilterKeyColumn(-1);
+    m_snapperSubvolumeProxyModel->setSourceModel(m_snapperSubvolumeModel);
+    connect(m_ui->lineEdit_snapperRestoreFilter, &QLineEdit::textChanged, m_snapperSubvolumeProxyModel,
+            &QSortFilterProxyModel::setFilterFixedString);
+
+    // progress of filesystem operations, always read for the filesystem that is selected at the time
+    m_balanceMonitor =
+        new ProgressMonitor([this]() { return m_btrfs->balanceProgress(m_ui->comboBox_btrfsDevice->currentText()); }, this);
+    m_scrubMonitor = new ProgressMonitor([this]() { return m_btrfs->scrubProgress(m_ui->comboBox_btrfsDevice->currentText()); }, this);
+    connect(m_balanceMonitor, &ProgressMonitor::progressChanged, this, &MainWindow::btrfsBalanceStatusUpdateUI);
+    connect(m_scrubMonitor, &ProgressMonitor::progressChanged, this, &MainWindow::btrfsScrubStatusUpdateUI);
+
+    // The data is loaded in the background, each tab is filled in as soon as its data is in
+    m_loader = new Loader(m_hasSnapper ? m_snapper->snapperCommand() : QString(), this);
+    connect(m_loader, &Loader::subvolumesCached, m_subvolumeModel, &SubvolumeModel::load);
+    connect(m_loader, &Loader::btrfsLoaded, this, [this](const QMap<QString, BtrfsFilesystem> &filesystems) {
+        m_btrfs->updateFilesystems(filesystems);
+        btrfsLoaded();
+    });
+    connect(m_loader, &Loader::snapperLoaded, this, [this](const Snapper::LoadedData &data) {
+        m_snapper->setLoadedData(data);
+        snapperLoaded();
+    });
+    connect(m_loader, &Loader::finished, this, [this]() {
+        for (QWidget *tab : {m_ui->tab_btrfs, m_ui->tab_subvolumes, m_ui->tab_snapper_general, m_ui->tab_snapper_settings}) {
+            tab->setEnabled(true);
+        }
+        m_loadingIndicator->hide();
+        statusBar()->clearMessage();
+        emit loadingFinished();
+    });
+
+    m_loadingIndicator = new QProgressBar(this);
+    m_loadingIndicator->setRange(0, 0);
+    m_loadingIndicator->setMaximumWidth(150);
+    m_loadingIndicator->hide();
+    statusBar()->addPermanentWidget(m_loadingIndicator);
 
     setup();
     this->setWindowTitle(QCoreApplication::applicationName());
@@ -85,6 +164,8 @@ MainWindow::~MainWindow() { delete m_ui; }
 
 void MainWindow::displayError(const QString &errorText) { QMessageBox::critical(this, tr("Error"), errorText); }
 
+bool MainWindow::isLoading() const { return m_loader->isLoading(); }
+
 void MainWindow::bmRefreshMountpoints()
 {
     // Get updated list of mountpoints
@@ -138,49 +219,74 @@ void MainWindow::bmRefreshMountpoints()
     }
 }
 
-void MainWindow::btrfsBalanceStatusUpdateUI()
+void MainWindow::btrfsBalanceStatusUpdateUI(const BtrfsProgress &progress)
 {
-    QString uuid = m_ui->comboBox_btrfsDevice->currentText();
-    QString balanceStatus = m_btrfs->balanceStatus(Btrfs::findAnyMountpoint(uuid));
-
-    // if balance is running currently, make sure you can stop it and we monitor progress
-    if (!balanceStatus.contains("No balance found")) {
+    // if balance is running currently, make sure you can stop it
+    if (progress.isRunning) {
         m_ui->pushButton_btrfsBalance->setText("Stop");
-        // update status to current balance operation status
-        m_ui->label_btrfsBalanceStatus->setText(balanceStatus);
-        // keep updating UI if it isn't already doing so
-        if (m_balanceTimer->timerId() == -1) {
-            m_balanceTimer->start();
+        QString status = tr("%1 of about %2 chunks balanced").arg(progress.done).arg(progress.total);
+        if (progress.isPaused) {
+            status += tr(", paused");
+        } else if (progress.secondsLeft >= 0) {
+            status += tr(", %1 left").arg(formatDuration(progress.secondsLeft));
         }
+        m_ui->label_btrfsBalanceStatus->setText(status);
     } else {
-        // update status to reflect no balance running and stop timer
         m_ui->label_btrfsBalanceStatus->setText("No balance running.");
         m_ui->pushButton_btrfsBalance->setText("Start");
-        m_balanceTimer->stop();
     }
+    m_ui->pushButton_btrfsBalance->setEnabled(true);
 }
 
-void MainWindow::btrfsScrubStatusUpdateUI()
+void MainWindow::btrfsLoaded()
 {
-    QString uuid = m_ui->comboBox_btrfsDevice->currentText();
-    QString scrubStatus = m_btrfs->scrubStatus(Btrfs::findAnyMountpoint(uuid));
+    // Only the rows that differ from what is shown are touched, whether that came from the cache or from an earlier load
+    m_subvolumeModel->update(m_btrfs->filesystems());
+    refreshBtrfsUi();
+
+    m_ui->tab_btrfs->setEnabled(true);
+    m_ui->tab_subvolumes->setEnabled(true);
+}
+
+void MainWindow::btrfsScrubStatusUpdateUI(const BtrfsProgress &progress)
+{
+    const QString uuid = m_ui->comboBox_btrfsDevice->currentText();
 
-    // update status to current scrub operation status
-    m_ui->label_btrfsScrubStatus->setText(scrubStatus);
-    // if scrub is running currently, make sure you can stop it and we monitor progress
-    if (scrubStatus.contains("ETA:")) {
+    // if scrub is running currently, make sure you can stop it
+    if (progress.isRunning) {
+        m_lastScrubProgress.insert(uuid, progress);
         m_ui->pushButton_btrfsScrub->setText("Stop");
-        if (m_scrubTimer->timerId() == -1) {
-            m_scrubTimer->start();
+        QString status = tr("%1 of %2 scrubbed, %3 errors")
+                             .arg(System::toHumanReadable(progress.done), System::toHumanReadable(progress.total))
+                             .arg(progress.errors);
+        if (progress.secondsLeft >= 0) {
+            status += tr(", %1/s, %2 left")
+                          .arg(System::toHumanReadable(static_cast<uint64_t>(progress.rate)), formatDuration(progress.secondsLeft));
+        }
+        m_ui->label_btrfsScrubStatus->setText(status);
+    } else if (m_lastScrubProgress.contains(uuid)) {
+        // The kernel drops the counters once the scrub is over so the summary is made from the last progress that was seen
+        const BtrfsProgress last = m_lastScrubProgress.value(uuid);
+        if (m_stoppedScrubs.contains(uuid)) {
+            m_ui->label_btrfsScrubStatus->setText(tr("Scrub stopped after %1 of %2, %3 errors")
+                                                      .arg(System::toHumanReadable(last.done), System::toHumanReadable(last.total))
+                                                      .arg(last.errors));
+        } else {
+            m_ui->label_btrfsScrubStatus->setText(
+                tr("Scrub finished, %1 scrubbed, %2 errors").arg(System::toHumanReadable(last.total)).arg(last.errors));
         }
+        m_ui->pushButton_btrfsScrub->setText("Start");
     } else {
-        m_scrubTimer->stop();
+        m_ui->label_btrfsScrubStatus->setText(tr("No scrub running."));
         m_ui->pushButton_btrfsScrub->setText("Start");
     }
+    m_ui->pushButton_btrfsScrub->setEnabled(true);
 }
 
 void MainWindow::loadSnapperUI()
 {
+    TraceSpan span(QStringLiteral("MainWindow::loadSnapperUI"));
+
     // If snapper isn't installed, no need to continue
     if (!m_hasSnapper)
         return;
@@ -215,6 +321,8 @@ void MainWindow::loadSnapperUI()
 
 void MainWindow::populateBmTab()
 {
+    TraceSpan span(QStringLiteral("MainWindow::populateBmTab"));
+
     const QStringList frequencyValues = {"none", "daily", "weekly", "monthly"};
 
     // Populate the frequency values from maintenance configuration
@@ -294,6 +402,23 @@ void MainWindow::populateBtrfsUi(const QString &uuid)
     m_ui->progressBar_btrfsmeta->setValue(static_cast<int>((double)filesystem.metaUsed / (double)filesystem.metaSize * 100));
     m_ui->progressBar_btrfssys->setValue(static_cast<int>((double)filesystem.sysUsed / (double)filesystem.sysSize * 100));
 
+    // Show the per profile breakdown when hovering over the bars
+    QStringList dataProfiles, metaProfiles, sysProfiles;
+    for (const BtrfsProfileUsage &usage : filesystem.profiles) {
+        const QString line =
+            QString("%1: %2 / %3").arg(usage.profile, System::toHumanReadable(usage.used), System::toHumanReadable(usage.size));
+        if (usage.type.startsWith("Data")) {
+            dataProfiles.append(line);
+        } else if (usage.type == "Metadata") {
+            metaProfiles.append(line);
+        } else {
+            sysProfiles.append(line);
+        }
+    }
+    m_ui->progressBar_btrfsdata->setToolTip(dataProfiles.join('\n'));
+    m_ui->progressBar_btrfsmeta->setToolTip(metaProfiles.join('\n'));
+    m_ui->progressBar_btrfssys->setToolTip(sysProfiles.join('\n'));
+
     // The information section
     const auto allocatedPercent = static_cast<double>(filesystem.allocatedSize) / static_cast<double>(filesystem.totalSize) * 100.0;
     m_ui->label_btrfsAllocatedValue->setText(
@@ -316,12 +441,14 @@ void MainWindow::populateBtrfsUi(const QString &uuid)
         QString("%1 (%2%)").arg(System::toHumanReadable(filesystem.freeSizeMin)).arg((freeMinPercent) * 100.0, 0, 'f', 2));
 
     // filesystems operation section
-    btrfsBalanceStatusUpdateUI();
-    btrfsScrubStatusUpdateUI();
+    m_balanceMonitor->start();
+    m_scrubMonitor->start();
 }
 
 void MainWindow::populateSnapperConfigSettings()
 {
+    TraceSpan span(QStringLiteral("MainWindow::populateSnapperConfigSettings"));
+
     QString name = m_ui->comboBox_snapperConfigSettings->currentText();
     if (name.isEmpty()) {
         return;
@@ -350,103 +477,37 @@ void MainWindow::populateSnapperConfigSettings()
 
 void MainWindow::populateSnapperGrid()
 {
-    // We need to the locale for displaying the date/time
-    const QLocale locale = QLocale::system();
+    TraceSpan span(QStringLiteral("MainWindow::populateSnapperGrid"));
 
     const QString config = m_ui->comboBox_snapperConfigs->currentText();
-
-    // Clear the table and set the headers
-    m_ui->tableWidget_snapperNew->clear();
-    m_ui->tableWidget_snapperNew->setColumnCount(5);
-    m_ui->tableWidget_snapperNew->setHorizontalHeaderItem(0, new QTableWidgetItem(tr("Number", "The number associated with a snapshot")));
-    m_ui->tableWidget_snapperNew->setHorizontalHeaderItem(1, new QTableWidgetItem(tr("Date/Time")));
-    m_ui->tableWidget_snapperNew->setHorizontalHeaderItem(2, new QTableWidgetItem(tr("Type")));
-    m_ui->tableWidget_snapperNew->setHorizontalHeaderItem(3, new QTableWidgetItem(tr("Cleanup")));
-    m_ui->tableWidget_snapperNew->setHorizontalHeaderItem(4, new QTableWidgetItem(tr("Description")));
-    m_ui->tableWidget_snapperNew->sortByColumn(0, Qt::DescendingOrder);
-    m_ui->tableWidget_snapperNew->setContextMenuPolicy(Qt::CustomContextMenu);
-
-    // Disabling sorting while populating the grid is required or the grid won't repopulate properly
-    m_ui->tableWidget_snapperNew->setSortingEnabled(false);
-
-    // Make sure there is something to populate
-    QVector<SnapperSnapshot> snapshots = m_snapper->snapshots(config);
-    if (snapshots.isEmpty()) {
-        return;
-    }
-
-    // Populate the table
-    m_ui->tableWidget_snapperNew->setRowCount(static_cast<int>(snapshots.size()));
-    for (int i = 0; i < snapshots.size(); i++) {
-        // Ensure proper sorting of numbers and dates
-        QTableWidgetItem *number = new QTableWidgetItem(static_cast<int>(snapshots.at(i).number));
-        number->setData(Qt::DisplayRole, snapshots.at(i).number);
-        QTableWidgetItem *snapTime = new QTableWidgetItem(locale.toString(snapshots.at(i).time, QLocale::ShortFormat));
-        snapTime->setData(Qt::DisplayRole, snapshots.at(i).time);
-
-        m_ui->tableWidget_snapperNew->setItem(i, 0, number);
-        m_ui->tableWidget_snapperNew->setItem(i, 1, snapTime);
-        m_ui->tableWidget_snapperNew->setItem(i, 2, new QTableWidgetItem(snapshots.at(i).type));
-        m_ui->tableWidget_snapperNew->setItem(i, 3, new QTableWidgetItem(snapshots.at(i).cleanup));
-        m_ui->tableWidget_snapperNew->setItem(i, 4, new QTableWidgetItem(snapshots.at(i).desc));
-    }
-
-    // Re-enable sorting and resize the colums to make everything fit
-    m_ui->tableWidget_snapperNew->setSortingEnabled(true);
-    m_ui->tableWidget_snapperNew->resizeColumnsToContents();
+    m_snapperSnapshotModel->load(config, m_snapper->snapshots(config));
 }
 
 void MainWindow::populateSnapperRestoreGrid()
 {
-    // We need to the locale for displaying the date/time
-    const QLocale locale = QLocale::system();
+    TraceSpan span(QStringLiteral("MainWindow::populateSnapperRestoreGrid"));
 
     // Get the name of the subvolume to list in the grid
-    QString config = cleanTargetSubvol(m_ui->comboBox_snapperSubvols->currentText());
+    const QString config = cleanTargetSubvol(m_ui->comboBox_snapperSubvols->currentText());
+    m_snapperSubvolumeModel->load(config, m_snapper->subvols(config));
+}
 
-    // Clear the table and set the headers
-    m_ui->tableWidget_snapperRestore->clear();
-    m_ui->tableWidget_snapperRestore->setColumnCount(5);
-    m_ui->tableWidget_snapperRestore->setHorizontalHeaderItem((int)SnapperRestoreTableColumn::Number,
-                                                              new QTableWidgetItem(tr("Number", "The number associated with a snapshot")));
-    m_ui->tableWidget_snapperRestore->setHorizontalHeaderItem((int)SnapperRestoreTableColumn::Subvolume,
-                                                              new QTableWidgetItem(tr("Subvolume")));
-    m_ui->tableWidget_snapperRestore->setHorizontalHeaderItem((int)SnapperRestoreTableColumn::DateTime,
-                                                              new QTableWidgetItem(tr("Date/Time")));
-    m_ui->tableWidget_snapperRestore->setHorizontalHeaderItem((int)SnapperRestoreTableColumn::Type, new QTableWidgetItem(tr("Type")));
-    m_ui->tableWidget_snapperRestore->setHorizontalHeaderItem((int)SnapperRestoreTableColumn::Description,
-                                                              new QTableWidgetItem(tr("Description")));
-    m_ui->tableWidget_snapperRestore->sortByColumn(0, Qt::DescendingOrder);
-
-    // Disabling sorting while populating the grid is required or the grid won't repopulate properly - This must be Qt bug, right?
-    m_ui->tableWidget_snapperRestore->setSortingEnabled(false);
-
-    QVector<SnapperSubvolume> subvols = m_snapper->subvols(config);
-    // Make sure there is something to populate
-    if (subvols.isEmpty()) {
-        return;
+void MainWindow::reloadData(bool includeSnapper)
+{
+    m_ui->tab_btrfs->setEnabled(false);
+    m_ui->tab_subvolumes->setEnabled(false);
+    if (includeSnapper && m_hasSnapper) {
+        m_ui->tab_snapper_general->setEnabled(false);
+        m_ui->tab_snapper_settings->setEnabled(false);
     }
+    m_loadingIndicator->show();
+    statusBar()->showMessage(tr("Loading..."));
 
-    // Populate the table
-    m_ui->tableWidget_snapperRestore->setRowCount(static_cast<int>(subvols.count()));
-    for (int i = 0; i < subvols.count(); i++) {
-        const SnapperSubvolume &subvolume = subvols.at(i);
-        // Ensure proper sorting of numbers and dates
-        QTableWidgetItem *number = new QTableWidgetItem();
-        number->setData(Qt::DisplayRole, subvolume.snapshotNum);
-        QTableWidgetItem *snapTime = new QTableWidgetItem(locale.toString(subvolume.time, QLocale::ShortFormat));
-        snapTime->setData(Qt::DisplayRole, subvolume.time);
-
-        m_ui->tableWidget_snapperRestore->setItem(i, (int)SnapperRestoreTableColumn::Number, number);
-        m_ui->tableWidget_snapperRestore->setItem(i, (int)SnapperRestoreTableColumn::Subvolume, new QTableWidgetItem(subvolume.subvol));
-        m_ui->tableWidget_snapperRestore->setItem(i, (int)SnapperRestoreTableColumn::DateTime, snapTime);
-        m_ui->tableWidget_snapperRestore->setItem(i, (int)SnapperRestoreTableColumn::Type, new QTableWidgetItem(subvolume.type));
-        m_ui->tableWidget_snapperRestore->setItem(i, (int)SnapperRestoreTableColumn::Description, new QTableWidgetItem(subvolume.desc));
+    if (includeSnapper) {
+        m_loader->reloadAll();
+    } else {
+        m_loader->reloadBtrfs();
     }
-
-    // Re-enable sorting and resize the colums to make everything fit
-    m_ui->tableWidget_snapperRestore->setSortingEnabled(true);
-    m_ui->tableWidget_snapperRestore->resizeColumnsToContents();
 }
 
 void MainWindow::refreshBmUi()
@@ -457,6 +518,7 @@ void MainWindow::refreshBmUi()
 
 void MainWindow::refreshBtrfsUi()
 {
+    TraceSpan span(QStringLiteral("MainWindow::refreshBtrfsUi"));
 
     // Repopulate device selection combo box with detected btrfs filesystems.
     const QStringList uuidList = Btrfs::listFilesystems();
@@ -473,16 +535,19 @@ void MainWindow::refreshBtrfsUi()
 
 void MainWindow::refreshSnapperServices()
 {
-    const auto enabledUnits = System::findEnabledUnits();
-
-    // Loop through the checkboxes and change state to match
-    const QList<QCheckBox *> checkboxes =
-        m_ui->scrollArea_bm->findChildren<QCheckBox *>() + m_ui->groupBox_snapperUnits->findChildren<QCheckBox *>();
-    for (QCheckBox *checkbox : checkboxes) {
-        if (checkbox->property("actionType") == "service") {
-            checkbox->setChecked(enabledUnits.contains(checkbox->property("actionData").toString()));
+    TraceSpan span(QStringLiteral("MainWindow::refreshSnapperServices"));
+
+    // Asking systemd for the units can take a while so it is done off the GUI thread
+    QtConcurrent::run(&System::findEnabledUnits).then(this, [this](const QStringList &enabledUnits) {
+        // Loop through the checkboxes and change state to match
+        const QList<QCheckBox *> checkboxes =
+            m_ui->scrollArea_bm->findChildren<QCheckBox *>() + m_ui->groupBox_snapperUnits->findChildren<QCheckBox *>();
+        for (QCheckBox *checkbox : checkboxes) {
+            if (checkbox->property("actionType") == "service") {
+                checkbox->setChecked(enabledUnits.contains(checkbox->property("actionData").toString()));
+            }
         }
-    }
+    });
 }
 
 void MainWindow::refreshSubvolListUi()
@@ -580,6 +645,7 @@ void MainWindow::restoreSnapshot(const QString &uuid, const QString &subvolume)
 
 void MainWindow::setup()
 {
+    TraceSpan span(QStringLiteral("MainWindow::setup"));
 
     // If snapper isn't installed, hide the snapper-related elements of the UI
     if (m_hasSnapper) {
@@ -612,18 +678,29 @@ void MainWindow::setup()
     m_ui->tableView_subvols->horizontalHeader()->setSectionResizeMode(SubvolumeModel::Column::ReadOnly, QHeaderView::ResizeToContents);
     m_ui->tableView_subvols->verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
 
-    // Populate the UI
+    // Connect the snapper views, the columns are sized to their contents whenever a different config or subvolume is shown
+    m_ui->tableView_snapperNew->setModel(m_snapperSnapshotProxyModel);
+    m_ui->tableView_snapperNew->sortByColumn(SnapperSnapshotModel::Column::Number, Qt::DescendingOrder);
+    connect(m_snapperSnapshotModel, &QAbstractItemModel::modelReset, m_ui->tableView_snapperNew, &QTableView::resizeColumnsToContents);
+    m_ui->tableView_snapperRestore->setModel(m_snapperSubvolumeProxyModel);
+    m_ui->tableView_snapperRestore->sortByColumn(SnapperSubvolumeModel::Column::Number, Qt::DescendingOrder);
+    connect(m_snapperSubvolumeModel, &QAbstractItemModel::modelReset, m_ui->tableView_snapperRestore,
+            &QTableView::resizeColumnsToContents);
+
+    // The changes of a snapshot are listed against either the live target or the snapshot before it
+    auto changesMenu = new QMenu(m_ui->toolButton_snapperChanges);
+    connect(changesMenu->addAction(tr("Compare with the &current subvolume")), &QAction::triggered, this,
+            [this]() { compareSnapperSnapshot(false); });
+    connect(changesMenu->addAction(tr("Compare with the &previous snapshot")), &QAction::triggered, this,
+            [this]() { compareSnapperSnapshot(true); });
+    m_ui->toolButton_snapperChanges->setMenu(changesMenu);
+
+    // Populate the UI, the btrfs and snapper data are shown once they have been loaded
     refreshBtrfsUi();
     if (m_hasSnapper) {
         refreshSnapperServices();
-        loadSnapperUI();
-        if (m_snapper->configs().contains("root")) {
-            m_ui->comboBox_snapperConfigs->setCurrentText("root");
-        }
-        populateSnapperGrid();
-        populateSnapperRestoreGrid();
-        populateSnapperConfigSettings();
     }
+    reloadData(true);
 
     // Populate or hide btrfs maintenance tab depending on if system has btrfs maintenance units
     if (m_hasBtrfsmaintenance) {
@@ -634,6 +711,25 @@ void MainWindow::setup()
     }
 }
 
+void MainWindow::snapperLoaded()
+{
+    // The root config is selected the first time the configs are shown, after that the selection is kept
+    const bool isFirstLoad = m_ui->comboBox_snapperConfigs->count() == 0;
+
+    loadSnapperUI();
+    if (isFirstLoad && m_snapper->configs().contains("root")) {
+        m_ui->comboBox_snapperConfigs->setCurrentText("root");
+    }
+    populateSnapperGrid();
+    populateSnapperRestoreGrid();
+    if (isFirstLoad) {
+        populateSnapperConfigSettings();
+    }
+
+    m_ui->tab_snapper_general->setEnabled(true);
+    m_ui->tab_snapper_settings->setEnabled(true);
+}
+
 void MainWindow::setSnapperSettingsEditModeEnabled(bool enabled)
 {
 
@@ -716,21 +812,20 @@ void MainWindow::on_pushButton_btrfsBalance_clicked()
 {
     QString uuid = m_ui->comboBox_btrfsDevice->currentText();
 
-    // Stop or start balance depending on current operation
+    // Stop or start balance depending on current operation, the button is enabled again once the status has been updated
+    m_ui->pushButton_btrfsBalance->setEnabled(false);
+    QFuture<Result> future;
     if (m_ui->pushButton_btrfsBalance->text().contains("Stop")) {
-        m_btrfs->stopBalanceRoot(uuid);
-        btrfsBalanceStatusUpdateUI();
+        future = m_btrfs->stopBalanceRoot(uuid);
     } else {
-        m_btrfs->startBalanceRoot(uuid);
-        btrfsBalanceStatusUpdateUI();
+        future = m_btrfs->startBalanceRoot(uuid);
     }
+    future.then(this, [this](const Result &) { m_balanceMonitor->start(); });
 }
 
 void MainWindow::on_pushButton_btrfsRefreshData_clicked()
 {
-    m_btrfs->loadVolumes();
-    m_subvolumeModel->load(m_btrfs->filesystems());
-    refreshBtrfsUi();
+    reloadData(false);
 
     m_ui->pushButton_btrfsRefreshData->clearFocus();
 }
@@ -739,14 +834,18 @@ void MainWindow::on_pushButton_btrfsScrub_clicked()
 {
     QString uuid = m_ui->comboBox_btrfsDevice->currentText();
 
-    // Stop or start scrub depending on current operation
+    // Stop or start scrub depending on current operation, the button is enabled again once the status has been updated
+    m_ui->pushButton_btrfsScrub->setEnabled(false);
+    QFuture<Result> future;
     if (m_ui->pushButton_btrfsScrub->text().contains("Stop")) {
-        m_btrfs->stopScrubRoot(uuid);
-        btrfsScrubStatusUpdateUI();
+        m_stoppedScrubs.insert(uuid);
+        future = m_btrfs->stopScrubRoot(uuid);
     } else {
-        m_btrfs->startScrubRoot(uuid);
-        btrfsScrubStatusUpdateUI();
+        m_lastScrubProgress.remove(uuid);
+        m_stoppedScrubs.remove(uuid);
+        future = m_btrfs->startScrubRoot(uuid);
     }
+    future.then(this, [this](const Result &) { m_scrubMonitor->start(); });
 }
 
 void MainWindow::on_pushButton_enableQuota_clicked()
@@ -756,13 +855,12 @@ void MainWindow::on_pushButton_enableQuota_clicked()
     }
     const QString mountpoint = Btrfs::findAnyMountpoint(m_ui->comboBox_btrfsDevice->currentText());
 
-    if (!mountpoint.isEmpty() && m_btrfs->isQuotaEnabled(mountpoint)) {
-        Btrfs::setQgroupEnabled(mountpoint, false);
-    } else {
-        Btrfs::setQgroupEnabled(mountpoint, true);
-    }
-
-    setEnableQuotaButtonStatus();
+    m_ui->pushButton_enableQuota->setEnabled(false);
+    const bool enable = mountpoint.isEmpty() || !m_btrfs->isQuotaEnabled(mountpoint);
+    Btrfs::setQgroupEnabled(mountpoint, enable).then(this, [this](const Result &) {
+        setEnableQuotaButtonStatus();
+        m_ui->pushButton_enableQuota->setEnabled(true);
+    });
 }
 
 void MainWindow::on_pushButton_snapperDeleteConfig_clicked()
@@ -784,19 +882,21 @@ void MainWindow::on_pushButton_snapperDeleteConfig_clicked()
     }
 
     // Delete the config
-    SnapperResult result = m_snapper->deleteConfig(name);
-
-    if (result.exitCode != 0) {
-        displayError(result.outputList.at(0));
-    }
+    m_ui->pushButton_snapperDeleteConfig->setEnabled(false);
+    m_snapper->deleteConfig(name).then(this, [this, name](const SnapperResult &result) {
+        if (result.exitCode != 0) {
+            displayError(result.outputList.at(0));
+        }
 
-    // Reload the UI with the new list of configs
-    m_snapper->loadConfig(name);
-    loadSnapperUI();
-    populateSnapperGrid();
-    populateSnapperConfigSettings();
+        // Reload the UI with the new list of configs
+        m_snapper->loadConfig(name);
+        loadSnapperUI();
+        populateSnapperGrid();
+        populateSnapperConfigSettings();
 
-    m_ui->pushButton_snapperDeleteConfig->clearFocus();
+        m_ui->pushButton_snapperDeleteConfig->setEnabled(true);
+        m_ui->pushButton_snapperDeleteConfig->clearFocus();
+    });
 }
 
 void MainWindow::on_pushButton_snapperNewConfig_clicked()
@@ -848,17 +948,20 @@ void MainWindow::on_pushButton_snapperSaveConfig_clicked()
         config.setTimelineLimitYearly(m_ui->spinBox_snapperYearly->value());
         config.setNumberLimit(m_ui->spinBox_snapperNumber->value());
 
-        SnapperResult result = m_snapper->setConfig(name, config);
+        m_ui->pushButton_snapperSaveConfig->setEnabled(false);
+        m_snapper->setConfig(name, config).then(this, [this](const SnapperResult &result) {
+            if (result.exitCode != 0) {
+                displayError(result.outputList.at(0));
+            } else {
+                QMessageBox::information(0, tr("Snapper"), tr("Changes saved"));
+            }
 
-        if (result.exitCode != 0) {
-            displayError(result.outputList.at(0));
-        } else {
-            QMessageBox::information(0, tr("Snapper"), tr("Changes saved"));
-        }
+            loadSnapperUI();
+            populateSnapperGrid();
+            populateSnapperConfigSettings();
 
-        loadSnapperUI();
-        populateSnapperGrid();
-        populateSnapperConfigSettings();
+            m_ui->pushButton_snapperSaveConfig->setEnabled(true);
+        });
     } else { // This is new config we are creating
         name = m_ui->lineEdit_snapperName->text();
 
@@ -878,21 +981,23 @@ void MainWindow::on_pushButton_snapperSaveConfig_clicked()
         }
 
         // Create the new config
-        SnapperResult result = m_snapper->createConfig(name, m_ui->comboBox_snapperPath->currentText());
-
-        if (result.exitCode != 0) {
-            displayError(result.outputList.at(0));
-        }
+        m_ui->pushButton_snapperSaveConfig->setEnabled(false);
+        m_snapper->createConfig(name, m_ui->comboBox_snapperPath->currentText()).then(this, [this, name](const SnapperResult &result) {
+            if (result.exitCode != 0) {
+                displayError(result.outputList.at(0));
+            }
 
-        // Reload the UI
-        m_snapper->loadConfig(name);
-        loadSnapperUI();
-        m_ui->comboBox_snapperConfigSettings->setCurrentText(name);
-        populateSnapperGrid();
-        populateSnapperConfigSettings();
+            // Reload the UI
+            m_snapper->loadConfig(name);
+            loadSnapperUI();
+            m_ui->comboBox_snapperConfigSettings->setCurrentText(name);
+            populateSnapperGrid();
+            populateSnapperConfigSettings();
 
-        // Put the ui back in edit mode
-        setSnapperSettingsEditModeEnabled(true);
+            // Put the ui back in edit mode
+            setSnapperSettingsEditModeEnabled(true);
+            m_ui->pushButton_snapperSaveConfig->setEnabled(true);
+        });
     }
 
     m_ui->pushButton_snapperSaveConfig->clearFocus();
@@ -951,10 +1056,11 @@ void MainWindow::on_tableView_subvols_customContextMenuRequested(const QPoint &p
         }
         if (QMessageBox::question(this, tr("Confirm"), msg) == QMessageBox::Yes) {
             QVector<Subvolume> failed;
-            for (Subvolume s : subvols) {
+            for (const Subvolume &s : subvols) {
                 if (m_btrfs->setSubvolumeReadOnly(s, readOnly)) {
-                    s.flags = readOnly ? 0x1u : 0;
-                    m_subvolumeModel->updateSubvolume(s);
+                    SubvolumeChanges changes;
+                    changes.changed.append(s.id);
+                    m_subvolumeModel->applyChanges(s.filesystemUuid, m_btrfs->listSubvolumes(s.filesystemUuid), changes);
                 } else {
                     failed.append(s);
                 }
@@ -984,8 +1090,9 @@ void MainWindow::on_tableView_subvols_customContextMenuRequested(const QPoint &p
                 std::pair<QString, std::optional<Subvolume>> returnInfo =
                     m_btrfs->createSnapshot(subvol.filesystemUuid, subvol.id, dialog.destination(), dialog.isReadOnly());
                 if (returnInfo.first.isEmpty()) {
-                    std::optional<Subvolume> snapshot = returnInfo.second;
-                    m_subvolumeModel->addSubvolume(*snapshot);
+                    SubvolumeChanges changes;
+                    changes.added.append(returnInfo.second->id);
+                    m_subvolumeModel->applyChanges(subvol.filesystemUuid, m_btrfs->listSubvolumes(subvol.filesystemUuid), changes);
                     QMessageBox::information(0, tr("Btrfs Assistant"), tr("Snapshot created"));
                 } else {
                     QMessageBox::critical(0, tr("Btrfs Assistant"), returnInfo.first);
@@ -1020,7 +1127,7 @@ void MainWindow::on_tableView_subvols_customContextMenuRequested(const QPoint &p
     }
 }
 
-void MainWindow::on_tableWidget_snapperNew_customContextMenuRequested(const QPoint &pos)
+void MainWindow::on_tableView_snapperNew_customContextMenuRequested(const QPoint &pos)
 {
     QMenu menu;
 
@@ -1039,7 +1146,7 @@ void MainWindow::on_tableWidget_snapperNew_customContextMenuRequested(const QPoi
     action = menu.addAction(tr("&Change description"));
     connect(action, &QAction::triggered, this, &MainWindow::snapperChangeDescription);
 
-    menu.exec(m_ui->tableView_subvols->mapToGlobal(pos));
+    menu.exec(m_ui->tableView_snapperNew->viewport()->mapToGlobal(pos));
 }
 
 void MainWindow::on_toolButton_bmApply_clicked()
@@ -1118,7 +1225,7 @@ void MainWindow::on_toolButton_subvolumeBrowse_clicked()
     // We need to mount the root so we can browse from there
     const QString mountpoint = m_btrfs->mountRoot(uuid);
 
-    auto fb = new FileBrowser(QDir::cleanPath(mountpoint + QDir::separator() + subvolPath), uuid, this);
+    auto fb = new FileBrowser(m_btrfs, QDir::cleanPath(mountpoint + QDir::separator() + subvolPath), uuid, this);
     // Prefix the window title with target and snapshot number, so user can make sense of multiple windows
     fb->setWindowTitle(QString("%1 - %2").arg(subvolPath, fb->windowTitle()));
     fb->setAttribute(Qt::WA_DeleteOnClose, true);
@@ -1160,6 +1267,8 @@ void MainWindow::on_toolButton_subvolDelete_clicked()
     }
 
     QSet<QString> uuids;
+    // The deleted subvolumes are dropped from the cache right away so the refresh below won't report them
+    QMultiHash<QString, uint64_t> deletedIds;
 
     for (int i = 0; i < nameIndexes.count(); i++) {
         QString subvol = nameIndexes.at(i).data().toString();
@@ -1191,6 +1300,7 @@ void MainWindow::on_toolButton_subvolDelete_clicked()
             displayError(tr("Failed to delete subvolume " + subvol.toUtf8()));
             continue;
         }
+        deletedIds.insert(uuid, subvolid);
 
         // If this is a Snapper snapshot and removing the metadata was agreed to, clean it up
         if (cleanupSnapper && Btrfs::isSnapper(subvol)) {
@@ -1202,9 +1312,10 @@ void MainWindow::on_toolButton_subvolDelete_clicked()
 
     // Reload data and refresh the UI
     for (const auto &uuid : std::as_const(uuids)) {
-        m_btrfs->loadSubvols(uuid);
+        SubvolumeChanges changes = m_btrfs->refreshSubvols(uuid);
+        changes.removed.append(deletedIds.values(uuid));
+        m_subvolumeModel->applyChanges(uuid, m_btrfs->listSubvolumes(uuid), changes);
     }
-    m_subvolumeModel->load(m_btrfs->filesystems());
     refreshSubvolListUi();
 }
 
@@ -1212,10 +1323,10 @@ void MainWindow::on_toolButton_subvolRefresh_clicked()
 {
     const auto filesystems = m_btrfs->listFilesystems();
     for (const QString &uuid : filesystems) {
-        m_btrfs->loadSubvols(uuid);
+        const SubvolumeChanges changes = m_btrfs->refreshSubvols(uuid);
+        m_subvolumeModel->applyChanges(uuid, m_btrfs->listSubvolumes(uuid), changes);
     }
 
-    m_subvolumeModel->load(m_btrfs->filesystems());
     refreshSubvolListUi();
 
     m_ui->toolButton_subvolRefresh->clearFocus();
@@ -1223,15 +1334,14 @@ void MainWindow::on_toolButton_subvolRefresh_clicked()
 
 void MainWindow::on_toolButton_snapperRestore_clicked()
 {
-    if (m_ui->tableWidget_snapperRestore->currentRow() == -1) {
+    const int row = selectedSnapperSubvolumeRow();
+    if (row == -1) {
         displayError(tr("Nothing selected!"));
         return;
     }
 
     QString config = cleanTargetSubvol(m_ui->comboBox_snapperSubvols->currentText());
-    QString subvol =
-        m_ui->tableWidget_snapperRestore->item(m_ui->tableWidget_snapperRestore->currentRow(), (int)SnapperRestoreTableColumn::Subvolume)
-            ->text();
+    QString subvol = m_snapperSubvolumeModel->subvolume(row).subvol;
 
     QVector<SnapperSubvolume> snapperSubvols = m_snapper->subvols(config);
 
@@ -1251,15 +1361,14 @@ void MainWindow::on_toolButton_snapperRestore_clicked()
 
 void MainWindow::on_toolButton_snapperBrowse_clicked()
 {
-    const int currentRow = m_ui->tableWidget_snapperRestore->currentRow();
-    if (currentRow == -1) {
+    const int row = selectedSnapperSubvolumeRow();
+    if (row == -1) {
         displayError("You must select snapshot to browse!");
         return;
     }
 
-    QString subvolPath = m_ui->tableWidget_snapperRestore->item(currentRow, (int)SnapperRestoreTableColumn::Subvolume)->text();
-    uint snapshotNumber =
-        m_ui->tableWidget_snapperRestore->item(currentRow, (int)SnapperRestoreTableColumn::Number)->data(Qt::DisplayRole).toUInt();
+    QString subvolPath = m_snapperSubvolumeModel->subvolume(row).subvol;
+    uint snapshotNumber = m_snapperSubvolumeModel->subvolume(row).snapshotNum;
 
     QString target = cleanTargetSubvol(m_ui->comboBox_snapperSubvols->currentText());
     QVector<SnapperSubvolume> snapperSubvols = m_snapper->subvols(target);
@@ -1275,7 +1384,7 @@ void MainWindow::on_toolButton_snapperBrowse_clicked()
     // We need to mount the root so we can browse from there
     const QString mountpoint = m_btrfs->mountRoot(uuid);
 
-    auto fb = new FileBrowser(m_snapper, QDir::cleanPath(mountpoint + QDir::separator() + subvolPath), uuid, this);
+    auto fb = new FileBrowser(m_btrfs, m_snapper, QDir::cleanPath(mountpoint + QDir::separator() + subvolPath), uuid, this);
     // Prefix the window title with target and snapshot number, so user can make sense of multiple windows
     fb->setWindowTitle(QString("%1:%2 - %3").arg(target, QString::number(snapshotNumber), fb->windowTitle()));
     fb->setAttribute(Qt::WA_DeleteOnClose, true);
@@ -1305,78 +1414,72 @@ void MainWindow::on_toolButton_snapperCreate_clicked()
     }
 
     // OK, let's go ahead and take the snapshot
-    const SnapperResult result = m_snapper->createSnapshot(config, snapshotDescription);
-
-    if (result.exitCode != 0) {
-        displayError(result.outputList.at(0));
-    }
+    m_ui->toolButton_snapperCreate->setEnabled(false);
+    m_snapper->createSnapshot(config, snapshotDescription).then(this, [this, config](const SnapperResult &result) {
+        if (result.exitCode != 0) {
+            displayError(result.outputList.at(0));
+        }
 
-    // Reload the data and refresh the UI
-    m_btrfs->loadVolumes();
-    m_snapper->load();
-    loadSnapperUI();
-    m_ui->comboBox_snapperConfigs->setCurrentText(config);
-    populateSnapperGrid();
-    populateSnapperRestoreGrid();
+        // Reload the data, the UI is refreshed once it is in
+        m_ui->comboBox_snapperConfigs->setCurrentText(config);
+        reloadData(true);
 
-    m_ui->toolButton_snapperCreate->clearFocus();
+        m_ui->toolButton_snapperCreate->setEnabled(true);
+        m_ui->toolButton_snapperCreate->clearFocus();
+    });
 }
 
 void MainWindow::on_toolButton_snapperDelete_clicked()
 {
-    // Get all the rows that were selected
-    const QList<QTableWidgetItem *> list = m_ui->tableWidget_snapperNew->selectedItems();
+    // Get the snapshot numbers for the selected rows
+    QSet<uint> numbers;
+    for (const SnapperSnapshot &snapshot : selectedSnapperSnapshots()) {
+        numbers.insert(snapshot.number);
+    }
 
-    if (list.count() < 1) {
+    if (numbers.isEmpty()) {
         displayError(tr("Nothing selected!"));
         return;
     }
 
-    QSet<QString> numbers;
-
-    // Get the snapshot numbers for the selected rows
-    for (const QTableWidgetItem *item : list) {
-        numbers.insert(m_ui->tableWidget_snapperNew->item(item->row(), 0)->text());
-    }
-
     // Ask for confirmation
     if (QMessageBox::question(0, tr("Confirm"), tr("Are you sure you want to delete the selected snapshot(s)?")) != QMessageBox::Yes)
         return;
 
     QString config = m_ui->comboBox_snapperConfigs->currentText();
 
-    // Delete each selected snapshot
-    for (const QString &number : std::as_const(numbers)) {
-        // This shouldn't be possible but we check anyway
-        if (config.isEmpty() || number.isEmpty()) {
-            displayError(tr("Cannot delete snapshot"));
-            return;
-        }
+    // This shouldn't be possible but we check anyway
+    if (config.isEmpty() || numbers.contains(0)) {
+        displayError(tr("Cannot delete snapshot"));
+        return;
+    }
 
-        // Delete the snapshot
-        SnapperResult result = m_snapper->deleteSnapshot(config, number.toInt());
-        if (result.exitCode != 0) {
-            displayError(result.outputList.at(0));
+    // Delete all the selected snapshots at once, only the data for this config is reloaded afterwards
+    m_ui->toolButton_snapperDelete->setEnabled(false);
+    m_snapper->deleteSnapshots(config, numbers).then(this, [this](const SnapperDeleteResult &result) {
+        if (!result.failed.isEmpty()) {
+            QStringList errors;
+            for (auto it = result.failed.cbegin(); it != result.failed.cend(); ++it) {
+                errors.append(tr("Snapshot %1: %2").arg(it.key()).arg(it.value()));
+            }
+            displayError(errors.join('\n'));
         }
-    }
 
-    // Reload the data and refresh the UI
-    m_btrfs->loadVolumes();
-    m_snapper->load();
-    loadSnapperUI();
-    m_ui->comboBox_snapperConfigs->setCurrentText(config);
-    populateSnapperGrid();
-    populateSnapperRestoreGrid();
+        // Refresh the UI
+        populateSnapperGrid();
+        populateSnapperRestoreGrid();
 
-    m_ui->toolButton_snapperDelete->clearFocus();
+        m_ui->toolButton_snapperDelete->setEnabled(true);
+        m_ui->toolButton_snapperDelete->clearFocus();
+    });
 }
 
 void MainWindow::snapperChangeDescription()
 {
     // Get all the rows that were selected
-    const QList<QTableWidgetItem *> list = m_ui->tableWidget_snapperNew->selectedItems();
+    const QVector<SnapperSnapshot> snapshots = selectedSnapperSnapshots();
 
-    if (list.count() < 1) {
+    if (snapshots.isEmpty()) {
         displayError(tr("Nothing selected!"));
         return;
     }
@@ -1384,8 +1487,8 @@ void MainWindow::snapperChangeDescription()
     QSet<QString> numbers;
 
     // Get the snapshot numbers for the selected rows
-    for (const QTableWidgetItem *item : list) {
-        numbers.insert(m_ui->tableWidget_snapperNew->item(item->row(), 0)->text());
+    for (const SnapperSnapshot &snapshot : snapshots) {
+        numbers.insert(QString::number(snapshot.number));
     }
 
     const int snapshotsCount = static_cast<int>(numbers.count());
@@ -1395,7 +1498,7 @@ void MainWindow::snapperChangeDescription()
 
     // only applicable if there is a single snapshot selected
     if (snapshotsCount == 1) {
-        currentDescription = m_ui->tableWidget_snapperNew->item(list.at(0)->row(), 4)->text();
+        currentDescription = snapshots.at(0).desc;
     }
 
     // Ask the user for the description (<u><b> is used to make the snapshot number bold and underlined)
@@ -1409,26 +1512,29 @@ void MainWindow::snapperChangeDescription()
         return;
     }
 
-    // Change the description of each selected snapshot
-    for (const QString &number : std::as_const(numbers)) {
-        // This shouldn't be possible but we check anyway
-        if (config.isEmpty() || number.isEmpty()) {
-            displayError(tr("Cannot change description of snapshot"));
-            return;
-        }
-
-        // Change the description
-        SnapperResult result = m_snapper->changeSnapshotDescription(config, number.toInt(), snapshotDescription);
-        if (result.exitCode != 0) {
-            displayError(result.outputList.at(0));
-        }
+    // This shouldn't be possible but we check anyway
+    if (config.isEmpty() || numbers.contains(QString())) {
+        displayError(tr("Cannot change description of snapshot"));
+        return;
     }
 
-    // Reload the data and refresh the UI
-    m_snapper->load();
-    loadSnapperUI();
-    m_ui->comboBox_snapperConfigs->setCurrentText(config);
-    populateSnapperGrid();
+    // Change the description of each selected snapshot
+    runInSequence<QString>(
+        this, numbers.values(),
+        [this, config, snapshotDescription](const QString &number) {
+            return m_snapper->changeSnapshotDescription(config, number.toInt(), snapshotDescription);
+        },
+        [this, config](const QVector<SnapperResult> &results) {
+            for (const SnapperResult &result : results) {
+                if (result.exitCode != 0) {
+                    displayError(result.outputList.at(0));
+                }
+            }
+
+            // Reload the data, the UI is refreshed once it is in
+            m_ui->comboBox_snapperConfigs->setCurrentText(config);
+            reloadData(true);
+        });
 }
 
 void MainWindow::subvolsSelectionChanged()
@@ -1458,18 +1564,9 @@ void MainWindow::on_tabWidget_mainWindow_currentChanged()
     }
 }
 
-void MainWindow::on_toolButton_snapperNewRefresh_clicked()
-{
-    m_snapper->load();
-    populateSnapperGrid();
-}
+void MainWindow::on_toolButton_snapperNewRefresh_clicked() { reloadData(true); }
 
-void MainWindow::on_toolButton_snapperRestoreRefresh_clicked()
-{
-    m_btrfs->loadVolumes();
-    m_snapper->loadSubvols();
-    populateSnapperRestoreGrid();
-}
+void MainWindow::on_toolButton_snapperRestoreRefresh_clicked() { reloadData(true); }
 
 void MainWindow::on_toolButton_subvolRestoreBackup_clicked()
 {
@@ -1533,36 +1630,106 @@ void MainWindow::on_toolButton_subvolRestoreBackup_clicked()
     }
 }
 
-void MainWindow::setCleanup(const QString &cleanupArg)
+void MainWindow::compareSnapperSnapshot(bool withPrevious)
 {
-    const QList<QTableWidgetItem *> list = m_ui->tableWidget_snapperNew->selectedItems();
-
-    if (list.count() < 1) {
+    const int row = selectedSnapperSubvolumeRow();
+    if (row == -1) {
         displayError(tr("Nothing selected!"));
         return;
     }
 
-    QSet<uint> numbers;
+    const SnapperSubvolume snapshot = m_snapperSubvolumeModel->subvolume(row);
+    const QString target = cleanTargetSubvol(m_ui->comboBox_snapperSubvols->currentText());
+
+    uint64_t parentId = snapshot.subvolid;
+    uint64_t childId = 0;
+    QString description;
+    if (withPrevious) {
+        // The previous snapshot is the one with the highest number below the selected one
+        const SnapperSubvolume *previous = nullptr;
+        const QVector<SnapperSubvolume> snapperSubvols = m_snapper->subvols(target);
+        for (const SnapperSubvolume &subvol : snapperSubvols) {
+            if (subvol.snapshotNum < snapshot.snapshotNum && (previous == nullptr || subvol.snapshotNum > previous->snapshotNum)) {
+                previous = &subvol;
+            }
+        }
+
+        if (previous == nullptr) {
+            displayError(tr("There is no earlier snapshot to compare with"));
+            return;
+        }
+
+        parentId = previous->subvolid;
+        childId = snapshot.subvolid;
+        description = tr("Changes to %1 from snapshot %2 to snapshot %3").arg(target).arg(previous->snapshotNum).arg(snapshot.snapshotNum);
+    } else {
+        childId = m_btrfs->subvolId(snapshot.uuid, target);
+        description = tr("Changes to %1 since snapshot %2").arg(target).arg(snapshot.snapshotNum);
+    }
+
+    auto dialog = new SnapshotChangesDialog(description, this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose, true);
+    dialog->show();
+
+    m_btrfs->compareSubvolumes(snapshot.uuid, parentId, childId).then(dialog, [dialog](const FileChanges &changes) {
+        dialog->setChanges(changes);
+    });
+
+    m_ui->toolButton_snapperChanges->clearFocus();
+}
+
+QVector<SnapperSnapshot> MainWindow::selectedSnapperSnapshots() const
+{
+    QVector<SnapperSnapshot> snapshots;
+
+    const QModelIndexList selectedIndexes = m_ui->tableView_snapperNew->selectionModel()->selectedRows();
+    for (const QModelIndex &index : selectedIndexes) {
+        snapshots.append(m_snapperSnapshotModel->snapshot(m_snapperSnapshotProxyModel->mapToSource(index).row()));
+    }
+
+    return snapshots;
+}
 
+int MainWindow::selectedSnapperSubvolumeRow() const
+{
+    const QModelIndexList selectedIndexes = m_ui->tableView_snapperRestore->selectionModel()->selectedRows();
+    if (selectedIndexes.isEmpty()) {
+        return -1;
+    }
+
+    return m_snapperSubvolumeProxyModel->mapToSource(selectedIndexes.at(0)).row();
+}
+
+void MainWindow::setCleanup(const QString &cleanupArg)
+{
     // Get the snapshot numbers for the selected rows
-    for (const QTableWidgetItem *item : list) {
-        numbers.insert(m_ui->tableWidget_snapperNew->item(item->row(), 0)->text().toUInt());
+    QSet<uint> numbers;
+    for (const SnapperSnapshot &snapshot : selectedSnapperSnapshots()) {
+        numbers.insert(snapshot.number);
+    }
+
+    if (numbers.isEmpty()) {
+        displayError(tr("Nothing selected!"));
+        return;
     }
 
     const QString config = m_ui->comboBox_snapperConfigs->currentText();
 
-    for (const uint &number : std::as_const(numbers)) {
-        SnapperResult sr = m_snapper->setCleanupAlgorithm(config, number, cleanupArg);
-        if (sr.exitCode != 0) {
-            displayError(tr("Failed to set cleanup algorithm for snapshot %1").arg(number));
-        }
-    }
+    const QList<uint> numberList = numbers.values();
+    runInSequence<uint>(
+        this, numberList,
+        [this, config, cleanupArg](const uint &number) { return m_snapper->setCleanupAlgorithm(config, number, cleanupArg); },
+        [this, config, numberList](const QVector<SnapperResult> &results) {
+            for (int i = 0; i < results.count(); ++i) {
+                if (results.at(i).exitCode != 0) {
+                    displayError(tr("Failed to set cleanup algorithm for snapshot %1").arg(numberList.at(i)));
+                }
+            }
 
-    // Reload the data and refresh the UI
-    m_snapper->load();
-    loadSnapperUI();
-    m_ui->comboBox_snapperConfigs->setCurrentText(config);
-    populateSnapperGrid();
+            // Reload the data, the UI is refreshed once it is in
+            m_ui->comboBox_snapperConfigs->setCurrentText(config);
+            reloadData(true);
+        });
 }
 
 void MainWindow::setEnableQuotaButtonStatus()
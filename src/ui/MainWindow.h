@@ -1,6 +1,7 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QHash>
 #include <QMainWindow>
 #include <QSet>
 
@@ -8,9 +9,17 @@ class QCheckBox;
 
 class Btrfs;
 class BtrfsMaintenance;
+class Loader;
+class ProgressMonitor;
+class QProgressBar;
+class QSortFilterProxyModel;
 class Snapper;
+class SnapperSnapshotModel;
+class SnapperSubvolumeModel;
 class SubvolumeFilterModel;
 class SubvolumeModel;
+struct BtrfsProgress;
+struct SnapperSnapshot;
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -41,6 +50,17 @@ class MainWindow : public QMainWindow {
      */
     void displayError(const QString &errorText);
 
+    /**
+     * @brief Returns true while data is being loaded in the background
+     */
+    bool isLoading() const;
+
+  signals:
+    /**
+     * @brief Emitted once all the data requested from the background loader has been shown
+     */
+    void loadingFinished();
+
   private:
     /**
      * @brief Btrfs maintenance frequency values
@@ -55,16 +75,57 @@ class MainWindow : public QMainWindow {
     bool m_hasBtrfsmaintenance = false;
     SubvolumeFilterModel *m_subvolumeFilterModel = nullptr;
     SubvolumeModel *m_subvolumeModel = nullptr;
+    SnapperSnapshotModel *m_snapperSnapshotModel = nullptr;
+    QSortFilterProxyModel *m_snapperSnapshotProxyModel = nullptr;
+    SnapperSubvolumeModel *m_snapperSubvolumeModel = nullptr;
+    QSortFilterProxyModel *m_snapperSubvolumeProxyModel = nullptr;
+
+    /**
+     * @brief Loads the btrfs and snapper data off the GUI thread
+     */
+    Loader *m_loader = nullptr;
+
+    /**
+     * @brief Shown in the status bar while the loader is busy
+     */
+    QProgressBar *m_loadingIndicator = nullptr;
+
+    /**
+     * @brief Follows the balance on the selected filesystem while it runs
+     */
+    ProgressMonitor *m_balanceMonitor = nullptr;
+
+    /**
+     * @brief Follows the scrub on the selected filesystem while it runs
+     */
+    ProgressMonitor *m_scrubMonitor = nullptr;
+
+    /**
+     * @brief The last progress seen of the scrub on each filesystem, kept to show a summary once the scrub is over
+     */
+    QHash<QString, BtrfsProgress> m_lastScrubProgress;
+
+    /**
+     * @brief The filesystems whose scrub was stopped from here rather than left to finish
+     */
+    QSet<QString> m_stoppedScrubs;
 
     /**
-     * @brief Timer used to periodically update UI on balance progress
+     * @brief Shows the btrfs data after it has been loaded in the background
      */
-    QTimer *m_balanceTimer;
+    void btrfsLoaded();
 
     /**
-     * @brief Timer used to periodically update UI on scrub progress
+     * @brief Shows the snapper data after it has been loaded in the background
      */
-    QTimer *m_scrubTimer;
+    void snapperLoaded();
+
+    /**
+     * @brief Reloads the btrfs data in the background and the snapper data after it when @p includeSnapper is true
+     *
+     * The tabs that show the data are disabled until it has been reloaded so nothing is done with data that is about to change.
+     */
+    void reloadData(bool includeSnapper);
 
     /**
      * @brief Checks if snapper is installed and load snapper UI elements.
@@ -87,6 +148,13 @@ class MainWindow : public QMainWindow {
      */
     void populateSnapperGrid();
 
+    /**
+     * @brief Lists the files that changed after the snapshot selected on the Snapper Restore subtab was taken
+     * @param withPrevious - When true, the changes from the previous snapshot of the target to the selected one are listed
+     * instead of the changes from the selected snapshot to the live target
+     */
+    void compareSnapperSnapshot(bool withPrevious);
+
     /**
      * @brief Populates the grid on the Snapper Restore subtab
      */
@@ -97,6 +165,16 @@ class MainWindow : public QMainWindow {
      */
     void populateSnapperConfigSettings();
 
+    /**
+     * @brief Returns the snapshots selected on the Snapper New subtab
+     */
+    QVector<SnapperSnapshot> selectedSnapperSnapshots() const;
+
+    /**
+     * @brief Returns the row of the snapper subvolume model selected on the Snapper Restore subtab or -1 if nothing is selected
+     */
+    int selectedSnapperSubvolumeRow() const;
+
     /**
      * @brief setCleanup
      * @param cleanupArg
@@ -159,14 +237,14 @@ class MainWindow : public QMainWindow {
     void bmRefreshMountpoints();
 
     /**
-     * @brief Method used to fetch and update the btrfs balance status
+     * @brief Shows the balance @p progress on the Btrfs tab
      */
-    void btrfsBalanceStatusUpdateUI();
+    void btrfsBalanceStatusUpdateUI(const BtrfsProgress &progress);
 
     /**
-     * @brief Method used to fetch and update the btrfs balance status
+     * @brief Shows the scrub @p progress on the Btrfs tab, or a summary of the last scrub seen once it is over
      */
-    void btrfsScrubStatusUpdateUI();
+    void btrfsScrubStatusUpdateUI(const BtrfsProgress &progress);
 
     /**
      * @brief Method used to fetch and update the btrfs balance status
@@ -276,7 +354,7 @@ class MainWindow : public QMainWindow {
     /**
      * @brief Snapper table right click handler.
      */
-    void on_tableWidget_snapperNew_customContextMenuRequested(const QPoint &pos);
+    void on_tableView_snapperNew_customContextMenuRequested(const QPoint &pos);
 
     /**
      * @brief Mainwindow tab selection change event handler.
@@ -0,0 +1,33 @@
+#include "ui/SnapshotChangesDialog.h"
+#include "model/FileChangeModel.h"
+#include "ui_SnapshotChangesDialog.h"
+
+#include <QSortFilterProxyModel>
+
+SnapshotChangesDialog::SnapshotChangesDialog(const QString &description, QWidget *parent)
+    : QDialog(parent), m_ui(new Ui::SnapshotChangesDialog), m_description(description)
+{
+    m_ui->setupUi(this);
+
+    m_model = new FileChangeModel(this);
+    auto proxyModel = new QSortFilterProxyModel(this);
+    proxyModel->setSourceModel(m_model);
+    m_ui->tableView_changes->setModel(proxyModel);
+    m_ui->tableView_changes->sortByColumn(FileChangeModel::Column::Path, Qt::AscendingOrder);
+
+    m_ui->label_summary->setText(tr("%1\nComparing...").arg(m_description));
+}
+
+SnapshotChangesDialog::~SnapshotChangesDialog() { delete m_ui; }
+
+void SnapshotChangesDialog::setChanges(const FileChanges &changes)
+{
+    if (!changes.error.isEmpty()) {
+        m_ui->label_summary->setText(tr("%1\n%2").arg(m_description, changes.error));
+        return;
+    }
+
+    m_model->setChanges(changes.changes);
+    m_ui->tableView_changes->resizeColumnsToContents();
+    m_ui->label_summary->setText(tr("%1\n%n change(s)", nullptr, static_cast<int>(changes.changes.count())).arg(m_description));
+}
@@ -0,0 +1,38 @@
+#ifndef SNAPSHOTCHANGESDIALOG_H
+#define SNAPSHOTCHANGESDIALOG_H
+
+#include "util/Btrfs.h"
+
+#include <QDialog>
+
+class FileChangeModel;
+
+namespace Ui {
+class SnapshotChangesDialog;
+}
+
+/**
+ * @brief The SnapshotChangesDialog class lists the files that differ between two subvolumes once they have been compared
+ */
+class SnapshotChangesDialog : public QDialog {
+    Q_OBJECT
+
+  public:
+    /**
+     * @param description - Says which subvolumes are being compared, it is shown above the changes
+     */
+    explicit SnapshotChangesDialog(const QString &description, QWidget *parent = nullptr);
+    ~SnapshotChangesDialog();
+
+    /**
+     * @brief Shows @p changes or the reason they couldn't be read
+     */
+    void setChanges(const FileChanges &changes);
+
+  private:
+    Ui::SnapshotChangesDialog *m_ui;
+    FileChangeModel *m_model = nullptr;
+    QString m_description;
+};
+
+#endif // SNAPSHOTCHANGESDIALOG_H
@@ -1,53 +1,114 @@
 #include "util/Btrfs.h"
+#include "util/BtrfsBackend.h"
+#include "util/MetadataCache.h"
+#include "util/MountTable.h"
+#include "util/SendStream.h"
 #include "util/System.h"
-#include <sys/mount.h>
+#include "util/Tracer.h"
 
+#include <fcntl.h>
+#include <linux/btrfs.h>
+#include <linux/btrfs_tree.h>
+#include <unistd.h>
+
+#include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QPromise>
 #include <QRegularExpression>
 #include <QTemporaryDir>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cstddef>
+#include <endian.h>
 
 namespace {
 
-QString uuidToString(const uint8_t uuid[16])
-{
-    QString ret;
-    bool allZeros = true;
-    for (int i = 0; i < 16; ++i) {
-        ret.append(QString::number(uuid[i], 16));
-        if ((i + 1) % 2 == 0 && (i > 1 && i < 10)) {
-            ret.append('-');
+// The start of the name of the snapshots taken to compare a writable subvolume, followed by the process id and a random UUID
+const QString COMPARE_SNAPSHOT_PREFIX = QStringLiteral(".btrfs-assistant-compare-");
+
+/**
+ * @brief Deletes the compare snapshots in the top level of the filesystem mounted at @p mountpoint whose process is gone
+ *
+ * A compare that is killed during a long send can't delete its snapshot, it would otherwise stay behind for good.
+ */
+void deleteStaleCompareSnapshots(BtrfsBackend *backend, const QString &mountpoint)
+{
+    const QStringList names =
+        QDir(mountpoint).entryList({COMPARE_SNAPSHOT_PREFIX + QLatin1Char('*')}, QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+    for (const QString &name : names) {
+        bool isNumber = false;
+        const qint64 pid = name.mid(COMPARE_SNAPSHOT_PREFIX.size()).section('-', 0, 0).toLongLong(&isNumber);
+        if (!isNumber || !QFileInfo::exists(QStringLiteral("/proc/") + QString::number(pid))) {
+            backend->deleteSubvolume(QDir::cleanPath(mountpoint + QDir::separator() + name));
         }
-        allZeros &= (uuid[i] == 0);
     }
-    return allZeros ? "" : ret;
 }
 
-Subvolume infoToSubvolume(const QString &fileSystemUuid, const QString &name, const struct btrfs_util_subvolume_info &subvolInfo)
+/**
+ * @brief Returns an already finished future for operations that could not be started
+ */
+QFuture<Result> failedResult()
 {
-    Subvolume ret;
-    ret.subvolName = name;
-    ret.parentId = subvolInfo.parent_id;
-    ret.id = subvolInfo.id;
-    ret.uuid = uuidToString(subvolInfo.uuid);
-    ret.parentUuid = uuidToString(subvolInfo.parent_uuid);
-    ret.receivedUuid = uuidToString(subvolInfo.received_uuid);
-    ret.generation = subvolInfo.generation;
-    ret.flags = subvolInfo.flags;
-    ret.createdAt = QDateTime::fromSecsSinceEpoch(subvolInfo.otime.tv_sec);
-    ret.filesystemUuid = fileSystemUuid;
-    return ret;
+    QPromise<Result> promise;
+    promise.start();
+    promise.addResult(Result{});
+    promise.finish();
+    return promise.future();
+}
+
+/**
+ * @brief Returns an already finished future for a comparison that could not be started because of @p error
+ */
+QFuture<FileChanges> failedChanges(const QString &error)
+{
+    QPromise<FileChanges> promise;
+    promise.start();
+    promise.addResult(FileChanges{error, {}});
+    promise.finish();
+    return promise.future();
+}
+
+/**
+ * @brief Returns true if any of the values read for the two subvolumes differ
+ */
+bool isSubvolumeChanged(const Subvolume &a, const Subvolume &b)
+{
+    return a.subvolName != b.subvolName || a.parentId != b.parentId || a.generation != b.generation || a.flags != b.flags ||
+           a.receivedUuid != b.receivedUuid || a.size != b.size || a.exclusive != b.exclusive;
 }
 
 } // namespace
 
-Btrfs::Btrfs(QObject *parent) : QObject{parent} { loadVolumes(); }
+Btrfs::Btrfs(InitialLoad initialLoad, QObject *parent) : Btrfs(std::make_unique<BtrfsUtilBackend>(), initialLoad, parent) {}
 
-Btrfs::~Btrfs() { unmountFilesystems(); }
+Btrfs::Btrfs(std::unique_ptr<BtrfsBackend> backend, InitialLoad initialLoad, QObject *parent)
+    : QObject{parent}, m_backend(std::move(backend))
+{
+    if (initialLoad == InitialLoad::Later) {
+        return;
+    }
 
-QString Btrfs::balanceStatus(const QString &mountpoint) const
+    loadVolumes(MetadataCache::readFilesystems());
+}
+
+Btrfs::~Btrfs()
 {
-    return System::runCmd("btrfs", {"balance", "status", mountpoint}, false).output;
+    if (m_isLoaded) {
+        MetadataCache::writeFilesystems(m_filesystems);
+    }
+}
+
+QFuture<BtrfsProgress> Btrfs::balanceProgress(const QString &uuid) const
+{
+    BtrfsBackend *backend = m_backend.get();
+    const QString mountpoint = backend->findAnyMountpoint(uuid);
+    return QtConcurrent::run([backend, mountpoint]() { return backend->readBalanceProgress(mountpoint); });
 }
 
 BtrfsFilesystem Btrfs::filesystem(const QString &uuid) const
@@ -62,30 +123,78 @@ BtrfsFilesystem Btrfs::filesystem(const QString &uuid) const
 
 QStringList Btrfs::children(const uint64_t subvolId, const QString &uuid) const
 {
-    const QString mountpoint = findAnyMountpoint(uuid);
-    btrfs_util_subvolume_iterator *iter;
+    QStringList children;
 
-    btrfs_util_error returnCode = btrfs_util_create_subvolume_iterator(mountpoint.toLocal8Bit(), BTRFS_ROOT_ID, 0, &iter);
-    if (returnCode != BTRFS_UTIL_OK) {
-        return QStringList();
+    const auto btrfs = m_filesystems.constFind(uuid);
+    if (btrfs == m_filesystems.cend()) {
+        return children;
     }
 
-    QStringList children;
-
-    while (returnCode != BTRFS_UTIL_ERROR_STOP_ITERATION) {
-        char *path = nullptr;
-        struct btrfs_util_subvolume_info subvolInfo;
-        returnCode = btrfs_util_subvolume_iterator_next_info(iter, &path, &subvolInfo);
-        if (returnCode == BTRFS_UTIL_OK && subvolInfo.parent_id == subvolId) {
-            children.append(QString::fromLocal8Bit(path));
-            free(path);
-        }
+    const QList<uint64_t> childIds = btrfs->subvolumes.childrenOf(subvolId);
+    for (const uint64_t childId : childIds) {
+        children.append(btrfs->subvolumes.constFind(childId)->subvolName);
     }
 
-    btrfs_util_destroy_subvolume_iterator(iter);
     return children;
 }
 
+QFuture<FileChanges> Btrfs::compareSubvolumes(const QString &uuid, uint64_t parentId, uint64_t childId)
+{
+    const Subvolume parent = m_filesystems.value(uuid).subvolumes.value(parentId);
+    const Subvolume child = m_filesystems.value(uuid).subvolumes.value(childId);
+    if (parent.isEmpty() || child.isEmpty()) {
+        return failedChanges(tr("Failed to find the subvolumes to compare"));
+    }
+
+    if (!parent.isReadOnly()) {
+        return failedChanges(tr("Only a read-only subvolume can be compared against"));
+    }
+
+    const QString mountpoint = mountRoot(uuid);
+    if (mountpoint.isEmpty()) {
+        return failedChanges(tr("Failed to mount the filesystem"));
+    }
+
+    const QString parentPath = QDir::cleanPath(mountpoint + QDir::separator() + parent.subvolName);
+    const QString childPath = QDir::cleanPath(mountpoint + QDir::separator() + child.subvolName);
+    // The kernel only sends read-only subvolumes so a writable one is compared through a snapshot taken for the purpose
+    const QString tempPath = child.isReadOnly() ? QString()
+                                                : QDir::cleanPath(mountpoint + QDir::separator() + COMPARE_SNAPSHOT_PREFIX +
+                                                                  QString::number(QCoreApplication::applicationPid()) + QLatin1Char('-') +
+                                                                  QUuid::createUuid().toString(QUuid::WithoutBraces));
+
+    BtrfsBackend *backend = m_backend.get();
+    return QtConcurrent::run([backend, mountpoint, parentPath, childPath, tempPath]() {
+        TraceSpan span(QStringLiteral("Btrfs::compareSubvolumes"));
+
+        deleteStaleCompareSnapshots(backend, mountpoint);
+
+        FileChanges result;
+        if (!tempPath.isEmpty()) {
+            const btrfs_util_error returnCode = backend->createSnapshot(childPath, tempPath, true);
+            if (returnCode != BTRFS_UTIL_OK) {
+                result.error = QString(btrfs_util_strerror(returnCode));
+                return result;
+            }
+        }
+
+        SendStreamParser parser;
+        const int sendError = backend->send(parentPath, tempPath.isEmpty() ? childPath : tempPath, BTRFS_SEND_FLAG_NO_FILE_DATA,
+                                            [&parser](const char *data, qsizetype size) { parser.append(data, size); });
+
+        if (!tempPath.isEmpty()) {
+            backend->deleteSubvolume(tempPath);
+        }
+
+        if (sendError != 0) {
+            result.error = tr("Failed to compare the subvolumes: %1").arg(qt_error_string(sendError));
+            return result;
+        }
+
+        return parser.finish();
+    });
+}
+
 btrfs_util_error Btrfs::createSnapshot(const QString &source, const QString &dest, bool readOnly)
 {
     return btrfs_util_create_snapshot(source.toLocal8Bit(), dest.toLocal8Bit(), (readOnly ? BTRFS_UTIL_CREATE_SNAPSHOT_READ_ONLY : 0),
@@ -100,15 +209,14 @@ std::pair<QString, std::optional<Subvolume>> Btrfs::createSnapshot(const QString
         const QString mountpoint = mountRoot(uuid);
         const QString subvolPath = QDir::cleanPath(mountpoint + QDir::separator() + subvolumeName(uuid, subvolId).name);
 
-        btrfs_util_error returnCode = createSnapshot(subvolPath, dest, readOnly);
+        btrfs_util_error returnCode = m_backend->createSnapshot(subvolPath, dest, readOnly);
         if (returnCode == BTRFS_UTIL_OK) {
-            struct btrfs_util_subvolume_info subvolInfo;
-            returnCode = btrfs_util_subvolume_info(dest.toLocal8Bit(), 0, &subvolInfo);
-            if (returnCode == BTRFS_UTIL_OK) {
-                ret = infoToSubvolume(uuid, subvolumeName(dest).name, subvolInfo);
-                m_filesystems[uuid].subvolumes[ret->id] = *ret;
+            ret = m_backend->readSubvolume(uuid, dest);
+            if (ret) {
+                m_filesystems[uuid].subvolumes.insert(*ret);
                 return std::make_pair(QString(), ret);
             }
+            returnCode = BTRFS_UTIL_ERROR_SUBVOLUME_NOT_FOUND;
         }
         return std::make_pair(QString(btrfs_util_strerror(returnCode)), ret);
     }
@@ -125,8 +233,9 @@ bool Btrfs::deleteSubvol(const QString &uuid, const uint64_t subvolid)
 
             // Everything checks out, lets delete the subvol
             const QString subvolPath = QDir::cleanPath(mountpoint + QDir::separator() + subvol.subvolName);
-            btrfs_util_error returnCode = btrfs_util_delete_subvolume(subvolPath.toLocal8Bit(), 0);
+            btrfs_util_error returnCode = m_backend->deleteSubvolume(subvolPath);
             if (returnCode == BTRFS_UTIL_OK) {
+                m_filesystems[uuid].subvolumes.remove(subvolid);
                 return true;
             }
         }
@@ -136,17 +245,47 @@ bool Btrfs::deleteSubvol(const QString &uuid, const uint64_t subvolid)
     return false;
 }
 
-QString Btrfs::findAnyMountpoint(const QString &uuid)
+QFuture<ChangedInodes> Btrfs::findChangedSince(const QString &uuid, uint64_t subvolId, uint64_t generation) const
 {
-    const QStringList outputList = System::runCmd("findmnt", {"-t", "btrfs", "-lno", "uuid,target"}, false).output.split("\n");
+    BtrfsBackend *backend = m_backend.get();
+    const QString mountpoint = backend->findAnyMountpoint(uuid);
+    return QtConcurrent::run([backend, mountpoint, subvolId, generation]() {
+        TraceSpan span(QStringLiteral("Btrfs::findChangedSince"));
 
-    for (const QString &line : outputList) {
-        if (line.section(" ", 0, 0).trimmed() == uuid) {
-            return line.section(" ", 1).trimmed();
+        ChangedInodes result;
+        if (mountpoint.isEmpty()) {
+            result.error = tr("Failed to find a mountpoint for the filesystem");
+            return result;
         }
-    }
 
-    return QString();
+        const int error = backend->readChangedInodes(mountpoint, subvolId, generation, result.inodes);
+        if (error != 0) {
+            result.error = tr("Failed to search the subvolume for changes: %1").arg(qt_error_string(error));
+            result.inodes.clear();
+            return result;
+        }
+
+        std::sort(result.inodes.begin(), result.inodes.end(),
+                  [](const ChangedInode &a, const ChangedInode &b) { return a.path < b.path; });
+        return result;
+    });
+}
+
+QString Btrfs::findAnyMountpoint(const QString &uuid) { return MountTable::instance().findAnyMountpoint(uuid); }
+
+uint8_t Btrfs::kindOf(const QString &subvolume)
+{
+    uint8_t kind = 0;
+    if (isSnapper(subvolume)) {
+        kind |= Subvolume::Snapper;
+    }
+    if (isTimeshift(subvolume)) {
+        kind |= Subvolume::Timeshift;
+    }
+    if (isContainer(subvolume)) {
+        kind |= Subvolume::Container;
+    }
+    return kind;
 }
 
 bool Btrfs::isSnapper(const QString &subvolume)
@@ -163,204 +302,194 @@ bool Btrfs::isSubvolumeBackup(QString subvolPath)
     return nameParts.count() == 2;
 }
 
-bool Btrfs::isMounted(const QString &uuid, const uint64_t subvolid)
-{
-    const QStringList outputList =
-        System::runCmd("findmnt -nO subvolid=" + QString::number(subvolid) + " -o uuid", false).output.trimmed().split("\n");
-    return uuid == outputList.at(0).trimmed();
-}
+bool Btrfs::isMounted(const QString &uuid, const uint64_t subvolid) { return MountTable::instance().isMounted(uuid, subvolid); }
 
 bool Btrfs::isQuotaEnabled(const QString &mountpoint)
 {
-    return !System::runCmd("btrfs", {QStringLiteral("qgroup"), QStringLiteral("show"), mountpoint}, false).output.isEmpty();
-}
-
-QStringList Btrfs::listFilesystems()
-{
-    const QStringList outputList = System::runCmd("btrfs filesystem show -m", false).output.split('\n');
-    QStringList uuids;
-    for (const QString &line : outputList) {
-        if (line.contains("uuid:")) {
-            uuids.append(line.split("uuid:").at(1).trimmed());
-        }
+    const int fd = open(mountpoint.toLocal8Bit(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
     }
-    return uuids;
-}
 
-QStringList Btrfs::listMountpoints()
-{
-    QStringList mountpoints;
+    // The quota tree only exists while quotas are enabled and holds a single status item at (0, QGROUP_STATUS, 0)
+    struct btrfs_ioctl_search_key key = {};
+    key.tree_id = BTRFS_QUOTA_TREE_OBJECTID;
+    key.min_type = key.max_type = BTRFS_QGROUP_STATUS_KEY;
+    key.max_transid = UINT64_MAX;
 
-    // Find all btrfs mountpoints
-    const QStringList output = System::runCmd("findmnt --real -t btrfs -lno target", false).output.trimmed().split('\n');
-    for (const QString &line : output) {
-        const QString mountpoint = line.trimmed();
-        if (!mountpoint.isEmpty()) {
-            mountpoints.append(mountpoint);
+    uint64_t statusFlags = 0;
+    BtrfsUtilBackend::treeSearch(fd, key, [&statusFlags](const struct btrfs_ioctl_search_header &header, const char *data) {
+        if (header.len >= offsetof(struct btrfs_qgroup_status_item, rescan)) {
+            const auto *status = reinterpret_cast<const struct btrfs_qgroup_status_item *>(data);
+            statusFlags = le64toh(status->flags);
         }
-    }
-
-    mountpoints.sort();
+        return false;
+    });
+    close(fd);
 
-    return mountpoints;
+    return statusFlags & BTRFS_QGROUP_STATUS_FLAG_ON;
 }
 
-SubvolumeMap Btrfs::listSubvolumes(const QString &uuid) const { return m_filesystems.value(uuid).subvolumes; }
-
-void Btrfs::loadQgroups(const QString &uuid)
+QVector<BtrfsFilesystemInfo> Btrfs::listFilesystemInfo(bool useCache)
 {
-    if (!isUuidLoaded(uuid)) {
-        return;
-    }
+    // The kernel only registers mounted filesystems in sysfs so the list can't change without the mount table changing
+    static QMutex cacheMutex;
+    static QVector<BtrfsFilesystemInfo> cache;
+    static quint64 cacheGeneration = 0;
 
-    const QString mountpoint = findAnyMountpoint(uuid);
-    if (mountpoint.isEmpty()) {
-        return;
-    }
+    const quint64 generation = MountTable::instance().generation();
 
-    if (!isQuotaEnabled(mountpoint)) {
-        // If qgroups aren't enabled we need to abort
-        return;
+    QMutexLocker lock(&cacheMutex);
+    if (useCache && cacheGeneration == generation) {
+        return cache;
     }
 
-    QStringList outputList = System::runCmd("btrfs", {"qgroup", "show", "--raw", "--sync", mountpoint}, false).output.split("\n");
+    QVector<BtrfsFilesystemInfo> filesystems;
 
-    // The header takes the first two lines, make sure it is more than two lines and then consume them
-    if (outputList.count() <= 2) {
-        return;
-    }
-    outputList.takeFirst();
-    outputList.takeFirst();
+    const QDir sysfsDir(QStringLiteral("/sys/fs/btrfs"));
+    const QStringList entries = sysfsDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (const QString &uuid : entries) {
+        const QDir fsDir(sysfsDir.filePath(uuid));
 
-    // Load the data
-
-    for (const QString &line : std::as_const(outputList)) {
-        const QStringList qgroupList = line.split(" ", Qt::SkipEmptyParts);
-        uint64_t subvolId;
-        if (!qgroupList.at(0).contains("/")) {
+        // /sys/fs/btrfs also contains global directories like "features", only filesystems have devices
+        if (!fsDir.exists(QStringLiteral("devices"))) {
             continue;
         }
 
-        subvolId = qgroupList.at(0).split("/").at(1).toUInt();
+        BtrfsFilesystemInfo info;
+        info.uuid = uuid;
+        info.label = BtrfsUtilBackend::readSysfsValue(fsDir.filePath(QStringLiteral("label")));
+        info.nodeSize = BtrfsUtilBackend::readSysfsValue(fsDir.filePath(QStringLiteral("nodesize"))).toUInt();
+        info.sectorSize = BtrfsUtilBackend::readSysfsValue(fsDir.filePath(QStringLiteral("sectorsize"))).toUInt();
 
-        if (m_filesystems[uuid].subvolumes.contains(subvolId)) {
-            m_filesystems[uuid].subvolumes[subvolId].size = qgroupList.at(1).toULong();
-            m_filesystems[uuid].subvolumes[subvolId].exclusive = qgroupList.at(2).toULong();
+        const QStringList devices =
+            QDir(fsDir.filePath(QStringLiteral("devices"))).entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot, QDir::Name);
+        for (const QString &device : devices) {
+            info.devices.append(QStringLiteral("/dev/") + device);
         }
+
+        info.features =
+            QDir(fsDir.filePath(QStringLiteral("features"))).entryList(QDir::Files | QDir::System | QDir::NoDotAndDotDot, QDir::Name);
+
+        filesystems.append(info);
     }
+
+    cache = filesystems;
+    cacheGeneration = generation;
+
+    return filesystems;
 }
 
-void Btrfs::loadSubvols(const QString &uuid)
+QStringList Btrfs::listFilesystems(bool useCache)
 {
-    if (isUuidLoaded(uuid)) {
-        m_filesystems[uuid].subvolumes.clear();
+    const QVector<BtrfsFilesystemInfo> filesystems = listFilesystemInfo(useCache);
+    QStringList uuids;
+    for (const BtrfsFilesystemInfo &filesystem : filesystems) {
+        uuids.append(filesystem.uuid);
+    }
+    return uuids;
+}
 
-        const QString mountpoint = findAnyMountpoint(uuid);
-        btrfs_util_subvolume_iterator *iter;
+QStringList Btrfs::listMountpoints()
+{
+    QStringList mountpoints;
 
-        btrfs_util_error returnCode = btrfs_util_create_subvolume_iterator(mountpoint.toLocal8Bit(), BTRFS_ROOT_ID, 0, &iter);
-        if (returnCode != BTRFS_UTIL_OK) {
-            return;
+    // Find all btrfs mountpoints
+    const QVector<MountEntry> entries = MountTable::instance().entries(QStringLiteral("btrfs"));
+    for (const MountEntry &entry : entries) {
+        if (!entry.target.isEmpty() && !mountpoints.contains(entry.target)) {
+            mountpoints.append(entry.target);
         }
+    }
 
-        SubvolumeMap subvols;
+    mountpoints.sort();
 
-        while (returnCode != BTRFS_UTIL_ERROR_STOP_ITERATION) {
-            char *path = nullptr;
-            struct btrfs_util_subvolume_info subvolInfo;
-            returnCode = btrfs_util_subvolume_iterator_next_info(iter, &path, &subvolInfo);
-            if (returnCode == BTRFS_UTIL_OK) {
-                subvols[subvolInfo.id] = infoToSubvolume(uuid, QString::fromLocal8Bit(path), subvolInfo);
-                free(path);
-            }
-        }
-        btrfs_util_destroy_subvolume_iterator(iter);
+    return mountpoints;
+}
 
-        // We need to add the root at subvolid 5
-        struct btrfs_util_subvolume_info subvolInfo;
-        returnCode = btrfs_util_subvolume_info(mountpoint.toLocal8Bit(), BTRFS_ROOT_ID, &subvolInfo);
-        if (returnCode == BTRFS_UTIL_OK) {
-            subvols[subvolInfo.id] = infoToSubvolume(uuid, QString(), subvolInfo);
-        }
+SubvolumeMap Btrfs::listSubvolumes(const QString &uuid) const { return m_filesystems.value(uuid).subvolumes; }
 
+void Btrfs::loadSubvols(const QString &uuid)
+{
+    if (isUuidLoaded(uuid)) {
+        m_filesystems[uuid].subvolumes.clear();
+
+        const QString mountpoint = m_backend->findAnyMountpoint(uuid);
+        SubvolumeMap subvols = m_backend->readSubvolumes(uuid, mountpoint);
+        m_backend->readQgroups(mountpoint, subvols);
         m_filesystems[uuid].subvolumes = subvols;
-        loadQgroups(uuid);
     }
 }
 
-void Btrfs::loadVolumes()
+QStringList Btrfs::loadVolumes(const QMap<QString, BtrfsFilesystem> &cached)
 {
-    QStringList uuidList = listFilesystems();
+    TraceSpan span(QStringLiteral("Btrfs::loadVolumes"));
+
+    const QStringList uuidList = m_backend->listFilesystems();
 
-    static QRegularExpression qReg("\\s+");
+    // The subvolumes we already know about, either from an earlier load or from the metadata cache, only need to be checked
+    // against the root tree
+    QMap<QString, BtrfsFilesystem> previous = cached;
+    for (auto it = m_filesystems.cbegin(); it != m_filesystems.cend(); ++it) {
+        previous.insert(it.key(), it.value());
+    }
 
-    // Loop through btrfs devices and retrieve filesystem usage
-    for (const QString &uuid : std::as_const(uuidList)) {
-        QString mountpoint = findAnyMountpoint(uuid);
-        if (!mountpoint.isEmpty()) {
+    // Each filesystem is read on a thread from a bounded pool so the total time is close to that of the slowest filesystem. The
+    // reads only touch their own BtrfsFilesystem, the results are merged here once all of them have finished.
+    QThreadPool pool;
+    pool.setMaxThreadCount(std::clamp(static_cast<int>(uuidList.count()), 1, QThread::idealThreadCount()));
+    BtrfsBackend *backend = m_backend.get();
+    const QList<BtrfsFilesystem> results =
+        QtConcurrent::blockingMapped<QList<BtrfsFilesystem>>(&pool, uuidList, [backend, &previous](const QString &uuid) {
             BtrfsFilesystem btrfs;
-            btrfs.isPopulated = true;
-            QStringList usageLines = System::runCmd("LANG=C ; btrfs fi usage -b \"" + mountpoint + "\"", false).output.split('\n');
-            for (const QString &line : std::as_const(usageLines)) {
-                const QStringList &cols = line.split(':');
-                QString type = cols.at(0).trimmed();
-                if (type == "Device size") {
-                    btrfs.totalSize = cols.at(1).trimmed().toULong();
-                } else if (type == "Device allocated") {
-                    btrfs.allocatedSize = cols.at(1).trimmed().toULong();
-                } else if (type == "Used") {
-                    btrfs.usedSize = cols.at(1).trimmed().toULong();
-                } else if (type == "Free (estimated)") {
-                    btrfs.freeSize = cols.at(1).split(qReg, Qt::SkipEmptyParts).at(0).trimmed().toULong();
-                    btrfs.freeSizeMin = cols.at(2).trimmed().remove(QChar(')')).toULong();
-                } else if (type.startsWith("Data,")) {
-                    btrfs.dataSize = cols.at(2).split(',').at(0).trimmed().toULong();
-                    btrfs.dataUsed = cols.at(3).split(' ').at(0).trimmed().toULong();
-                } else if (type.startsWith("Metadata,")) {
-                    btrfs.metaSize = cols.at(2).split(',').at(0).trimmed().toULong();
-                    btrfs.metaUsed = cols.at(3).split(' ').at(0).trimmed().toULong();
-                } else if (type.startsWith("System,")) {
-                    btrfs.sysSize = cols.at(2).split(',').at(0).trimmed().toULong();
-                    btrfs.sysUsed = cols.at(3).split(' ').at(0).trimmed().toULong();
-                }
+            const QString mountpoint = backend->findAnyMountpoint(uuid);
+            if (mountpoint.isEmpty()) {
+                return btrfs;
             }
-            m_filesystems[uuid] = btrfs;
-            loadSubvols(uuid);
+
+            btrfs = backend->readUsage(uuid, mountpoint);
+
+            const SubvolumeMap known = previous.value(uuid).subvolumes;
+            btrfs.subvolumes =
+                known.isEmpty() ? backend->readSubvolumes(uuid, mountpoint) : backend->readChangedSubvolumes(uuid, mountpoint, known);
+            backend->readQgroups(mountpoint, btrfs.subvolumes);
+
+            btrfs.isPopulated = true;
+            return btrfs;
+        });
+
+    QStringList loaded;
+    for (int i = 0; i < uuidList.count(); ++i) {
+        if (results.at(i).isPopulated) {
+            m_filesystems[uuidList.at(i)] = results.at(i);
+            loaded.append(uuidList.at(i));
         }
     }
+    m_isLoaded = true;
+
+    return loaded;
 }
 
-QString Btrfs::mountRoot(const QString &uuid)
+SubvolumeChanges Btrfs::refreshSubvols(const QString &uuid)
 {
-    // Check to see if it is already mounted
-    QStringList findmntOutput =
-        System::runCmd("findmnt", {"-nO", "subvolid=" + QString::number(BTRFS_ROOT_ID), "-o", "uuid,target"}, false).output.split('\n');
-    QString mountpoint;
-    for (const QString &line : std::as_const(findmntOutput)) {
-        if (!line.isEmpty() && line.split(' ').at(0).trimmed() == uuid)
-            mountpoint = line.section(' ', 1).trimmed();
+    const QString mountpoint = m_backend->findAnyMountpoint(uuid);
+    if (!isUuidLoaded(uuid) || mountpoint.isEmpty()) {
+        return SubvolumeChanges();
     }
 
-    // If it isn't mounted we need to mount it
-    if (mountpoint.isEmpty()) {
-        mountpoint = QDir::cleanPath(System::mountPathRoot() + QDir::separator() + uuid);
-
-        // Add this mountpoint to a list so it can be unmounted later
-        m_tempMountpoints.append(mountpoint);
-
-        // Create the mountpoint and mount the volume if successful
-        QDir tempMount;
-        const QString device = QDir::cleanPath(QStringLiteral("/dev/disk/by-uuid/") + uuid);
-        const QString options = "subvolid=" + QString::number(BTRFS_ROOT_ID);
-        if (!(tempMount.mkpath(mountpoint) &&
-              mount(device.toLocal8Bit(), mountpoint.toLocal8Bit(), "btrfs", 0, options.toLocal8Bit()) == 0)) {
-            return QString();
-        }
-    }
+    BtrfsFilesystem &btrfs = m_filesystems[uuid];
+
+    SubvolumeMap subvols = m_backend->readChangedSubvolumes(uuid, mountpoint, btrfs.subvolumes);
+    m_backend->readQgroups(mountpoint, subvols);
 
-    return mountpoint;
+    const SubvolumeChanges changes = SubvolumeChanges::between(btrfs.subvolumes, subvols);
+    btrfs.subvolumes = subvols;
+
+    return changes;
 }
 
+QString Btrfs::mountRoot(const QString &uuid) { return m_backend->mountRoot(uuid); }
+
 bool Btrfs::renameSubvolume(const QString &source, const QString &target)
 {
     QDir dir;
@@ -401,8 +530,8 @@ RestoreResult Btrfs::restoreSubvol(const QString &uuid, const uint64_t sourceId,
     const QStringList children = this->children(targetId, uuid);
 
     // Rename the target
-    if (!Btrfs::renameSubvolume(QDir::cleanPath(mountpoint + QDir::separator() + targetName),
-                                QDir::cleanPath(mountpoint + QDir::separator() + targetBackup))) {
+    if (!m_backend->renameSubvolume(QDir::cleanPath(mountpoint + QDir::separator() + targetName),
+                                    QDir::cleanPath(mountpoint + QDir::separator() + targetBackup))) {
         restoreResult.failureMessage = tr("Failed to make a backup of target subvolume");
         return restoreResult;
     }
@@ -416,14 +545,13 @@ RestoreResult Btrfs::restoreSubvol(const QString &uuid, const uint64_t sourceId,
     }
 
     // Place a snapshot of the source where the target was
-    bool snapshotSuccess =
-        Btrfs::createSnapshot(QDir::cleanPath(mountpoint + QDir::separator() + newSubvolume).toUtf8(),
-                              QDir::cleanPath(mountpoint + QDir::separator() + targetName).toUtf8(), false) == BTRFS_UTIL_OK;
+    bool snapshotSuccess = m_backend->createSnapshot(QDir::cleanPath(mountpoint + QDir::separator() + newSubvolume),
+                                                     QDir::cleanPath(mountpoint + QDir::separator() + targetName), false) == BTRFS_UTIL_OK;
 
     if (!snapshotSuccess) {
         // That failed, try to put the old one back
-        Btrfs::renameSubvolume(QDir::cleanPath(mountpoint + QDir::separator() + targetBackup),
-                               QDir::cleanPath(mountpoint + QDir::separator() + targetName));
+        m_backend->renameSubvolume(QDir::cleanPath(mountpoint + QDir::separator() + targetBackup),
+                                   QDir::cleanPath(mountpoint + QDir::separator() + targetName));
         restoreResult.failureMessage = tr("Failed to restore subvolume!") + "\n\n" +
                                        tr("Snapshot restore failed.  Please verify the status of your system before rebooting");
         return restoreResult;
@@ -437,30 +565,45 @@ RestoreResult Btrfs::restoreSubvol(const QString &uuid, const uint64_t sourceId,
         // rename snapshot
         QString sourcePath = QDir::cleanPath(mountpoint + QDir::separator() + targetBackup + QDir::separator() + childSubvolPath);
         QString destinationPath = QDir::cleanPath(mountpoint + QDir::separator() + childSubvol);
-        if (!Btrfs::renameSubvolume(sourcePath, destinationPath)) {
+        if (!m_backend->renameSubvolume(sourcePath, destinationPath)) {
             // If this fails, not much can be done except let the user know
             restoreResult.failureMessage = tr("The restore was successful but the migration of the nested subvolumes failed") + "\n\n" +
                                            tr("Please migrate the those subvolumes manually");
+            refreshSubvols(uuid);
             return restoreResult;
         }
     }
 
     // If we get to here, it worked!
     restoreResult.isSuccess = true;
+
+    // The renames changed the paths of the target and its children
+    refreshSubvols(uuid);
+
     return restoreResult;
 }
 
-QString Btrfs::scrubStatus(const QString &mountpoint) const
+QFuture<BtrfsProgress> Btrfs::scrubProgress(const QString &uuid) const
 {
-    return System::runCmd("btrfs", {"scrub", "status", mountpoint}, false).output;
+    BtrfsBackend *backend = m_backend.get();
+    const QString mountpoint = backend->findAnyMountpoint(uuid);
+    return QtConcurrent::run([backend, mountpoint]() { return backend->readScrubProgress(mountpoint); });
 }
 
-void Btrfs::setQgroupEnabled(const QString &mountpoint, bool enable)
+void Btrfs::updateFilesystems(const QMap<QString, BtrfsFilesystem> &filesystems)
+{
+    for (auto it = filesystems.cbegin(); it != filesystems.cend(); ++it) {
+        m_filesystems.insert(it.key(), it.value());
+    }
+    m_isLoaded = true;
+}
+
+QFuture<Result> Btrfs::setQgroupEnabled(const QString &mountpoint, bool enable)
 {
     if (enable) {
-        System::runCmd(QStringLiteral("btrfs"), {QStringLiteral("quota"), QStringLiteral("enable"), mountpoint}, false);
+        return System::runCmdAsync(QStringLiteral("btrfs"), {QStringLiteral("quota"), QStringLiteral("enable"), mountpoint}, false);
     } else {
-        System::runCmd(QStringLiteral("btrfs"), {QStringLiteral("quota"), QStringLiteral("disable"), mountpoint}, false);
+        return System::runCmdAsync(QStringLiteral("btrfs"), {QStringLiteral("quota"), QStringLiteral("disable"), mountpoint}, false);
     }
 }
 
@@ -468,24 +611,26 @@ bool Btrfs::isSubvolume(const QString &path) { return btrfs_util_is_subvolume(pa
 
 uint64_t Btrfs::subvolId(const QString &uuid, const QString &subvolName)
 {
+    // Anything created outside of the application since the last load isn't in the cache yet so a miss still checks the disk
+    const auto btrfs = m_filesystems.constFind(uuid);
+    if (btrfs != m_filesystems.cend()) {
+        const uint64_t cachedId = btrfs->subvolumes.idOf(subvolName);
+        if (cachedId != 0) {
+            return cachedId;
+        }
+    }
+
     const QString mountpoint = mountRoot(uuid);
     if (mountpoint.isEmpty()) {
         return 0;
     }
-    const QString subvolPath = QDir::cleanPath(mountpoint + QDir::separator() + subvolName);
-    uint64_t id;
-    btrfs_util_error returnCode = btrfs_util_subvolume_id(subvolPath.toLocal8Bit(), &id);
-    if (returnCode == BTRFS_UTIL_OK) {
-        return id;
-    } else {
-        return 0;
-    }
+    return m_backend->subvolumeId(QDir::cleanPath(mountpoint + QDir::separator() + subvolName));
 }
 
 SubvolResult Btrfs::subvolumeName(const QString &uuid, const uint64_t subvolId) const
 {
     if (m_filesystems.contains(uuid) && m_filesystems[uuid].subvolumes.contains(subvolId)) {
-        return {m_filesystems[uuid].subvolumes[subvolId].subvolName, true};
+        return {m_filesystems[uuid].subvolumes.constFind(subvolId)->subvolName, true};
     } else {
         return {QString(), false};
     }
@@ -506,7 +651,7 @@ SubvolResult Btrfs::subvolumeName(const QString &path)
 uint64_t Btrfs::subvolParent(const QString &uuid, const uint64_t subvolId) const
 {
     if (m_filesystems.contains(uuid) && m_filesystems[uuid].subvolumes.contains(subvolId)) {
-        return m_filesystems[uuid].subvolumes[subvolId].parentId;
+        return m_filesystems[uuid].subvolumes.constFind(subvolId)->parentId;
     } else {
         return 0;
     }
@@ -532,13 +677,13 @@ bool Btrfs::setSubvolumeReadOnly(const QString &uuid, uint64_t subvolId, bool re
 {
     bool ret = false;
     if (m_filesystems.contains(uuid) && m_filesystems.value(uuid).subvolumes.contains(subvolId)) {
-        Subvolume &subvol = m_filesystems[uuid].subvolumes[subvolId];
         const QString mountpoint = mountRoot(uuid);
-        const QString subvolPath = QDir::cleanPath(mountpoint + QDir::separator() + subvol.subvolName);
+        const QString subvolPath =
+            QDir::cleanPath(mountpoint + QDir::separator() + m_filesystems[uuid].subvolumes.constFind(subvolId)->subvolName);
 
-        ret = setSubvolumeReadOnly(subvolPath, readOnly);
+        ret = m_backend->setSubvolumeReadOnly(subvolPath, readOnly);
         if (ret) {
-            subvol.flags = readOnly ? 0x1u : 0;
+            m_filesystems[uuid].subvolumes.find(subvolId)->flags = readOnly ? 0x1u : 0;
         }
     }
     return ret;
@@ -574,54 +719,188 @@ bool Btrfs::isUuidLoaded(const QString &uuid)
     return true;
 }
 
-void Btrfs::startBalanceRoot(const QString &uuid)
+QFuture<Result> Btrfs::startBalanceRoot(const QString &uuid)
 {
-    if (isUuidLoaded(uuid)) {
-        QString mountpoint = findAnyMountpoint(uuid);
+    if (!isUuidLoaded(uuid)) {
+        return failedResult();
+    }
+
+    // Run full balance command against UUID top level subvolume.
+    return System::runCmdAsync("btrfs", {"balance", "start", findAnyMountpoint(uuid), "--full-balance", "--bg"}, false);
+}
 
-        // Run full balance command against UUID top level subvolume.
-        System::runCmd("btrfs", {"balance", "start", mountpoint, "--full-balance", "--bg"}, false);
+QFuture<Result> Btrfs::startScrubRoot(const QString &uuid)
+{
+    if (!isUuidLoaded(uuid)) {
+        return failedResult();
     }
+
+    return System::runCmdAsync("btrfs", {"scrub", "start", findAnyMountpoint(uuid)}, false);
 }
 
-void Btrfs::startScrubRoot(const QString &uuid)
+QFuture<Result> Btrfs::stopBalanceRoot(const QString &uuid)
 {
-    if (isUuidLoaded(uuid)) {
-        QString mountpoint = findAnyMountpoint(uuid);
+    if (!isUuidLoaded(uuid)) {
+        return failedResult();
+    }
 
-        System::runCmd("btrfs", {"scrub", "start", mountpoint}, false);
+    return System::runCmdAsync("btrfs", {"balance", "cancel", findAnyMountpoint(uuid)}, false);
+}
+
+QFuture<Result> Btrfs::stopScrubRoot(const QString &uuid)
+{
+    if (!isUuidLoaded(uuid)) {
+        return failedResult();
     }
+
+    return System::runCmdAsync("btrfs", {"scrub", "cancel", findAnyMountpoint(uuid)}, false);
 }
 
-void Btrfs::stopBalanceRoot(const QString &uuid)
+bool Subvolume::isEmpty() const { return id == 0; }
+
+bool Subvolume::isReadOnly() const { return flags & 0x1u; }
+
+bool Subvolume::isSnapshot() const { return !parentUuid.isNull(); }
+
+bool Subvolume::isReceived() const { return !receivedUuid.isNull(); }
+
+SubvolumeMap::SubvolumeMap(QVector<Subvolume> subvolumes) : m_rows(std::move(subvolumes))
 {
-    if (isUuidLoaded(uuid)) {
-        QString mountpoint = findAnyMountpoint(uuid);
+    // A stable sort keeps the duplicates in their original order so the last one can be kept
+    std::stable_sort(m_rows.begin(), m_rows.end(), [](const Subvolume &a, const Subvolume &b) { return a.id < b.id; });
+    const auto last = std::unique(m_rows.rbegin(), m_rows.rend(), [](const Subvolume &a, const Subvolume &b) { return a.id == b.id; });
+    m_rows.remove(0, std::distance(last, m_rows.rend()));
 
-        System::runCmd("btrfs", {"balance", "cancel", mountpoint}, false);
+    m_byName.reserve(m_rows.count());
+    m_byUuid.reserve(m_rows.count());
+    m_byParentId.reserve(m_rows.count());
+    for (const Subvolume &subvol : std::as_const(m_rows)) {
+        addToIndexes(subvol);
     }
 }
 
-void Btrfs::stopScrubRoot(const QString &uuid)
+void SubvolumeMap::clear()
 {
-    if (isUuidLoaded(uuid)) {
-        QString mountpoint = findAnyMountpoint(uuid);
+    m_rows.clear();
+    m_byName.clear();
+    m_byUuid.clear();
+    m_byParentUuid.clear();
+    m_byReceivedUuid.clear();
+    m_byParentId.clear();
+}
+
+const Subvolume *SubvolumeMap::constFind(uint64_t id) const
+{
+    const qsizetype row = indexOf(id);
+    return row >= 0 ? &m_rows.at(row) : nullptr;
+}
+
+Subvolume *SubvolumeMap::find(uint64_t id)
+{
+    const qsizetype row = indexOf(id);
+    return row >= 0 ? &m_rows[row] : nullptr;
+}
 
-        System::runCmd("btrfs", {"scrub", "cancel", mountpoint}, false);
+uint64_t SubvolumeMap::idOf(const QString &subvolName) const
+{
+    // The names are stored relative to the root without a leading separator and the root itself has an empty name
+    QString name = QDir::cleanPath(subvolName);
+    while (name.startsWith('/')) {
+        name.remove(0, 1);
+    }
+    if (name == QStringLiteral(".")) {
+        name.clear();
     }
+
+    return m_byName.value(name);
 }
 
-void Btrfs::unmountFilesystems()
+qsizetype SubvolumeMap::indexOf(uint64_t id) const
 {
-    for (const QString &mountpoint : std::as_const(m_tempMountpoints)) {
-        umount2(mountpoint.toLocal8Bit(), MNT_DETACH);
+    const auto it =
+        std::lower_bound(m_rows.cbegin(), m_rows.cend(), id, [](const Subvolume &subvol, uint64_t value) { return subvol.id < value; });
+    return (it != m_rows.cend() && it->id == id) ? std::distance(m_rows.cbegin(), it) : -1;
+}
+
+void SubvolumeMap::insert(const Subvolume &subvol)
+{
+    const auto it = std::lower_bound(m_rows.begin(), m_rows.end(), subvol.id,
+                                     [](const Subvolume &existing, uint64_t value) { return existing.id < value; });
+    if (it != m_rows.end() && it->id == subvol.id) {
+        removeFromIndexes(*it);
+        *it = subvol;
+    } else {
+        m_rows.insert(it, subvol);
     }
+    addToIndexes(subvol);
 }
 
-bool Subvolume::isEmpty() const { return id == 0; }
+void SubvolumeMap::remove(uint64_t id)
+{
+    const qsizetype row = indexOf(id);
+    if (row >= 0) {
+        removeFromIndexes(m_rows.at(row));
+        m_rows.remove(row);
+    }
+}
 
-bool Subvolume::isReadOnly() const { return flags & 0x1u; }
+Subvolume SubvolumeMap::value(uint64_t id) const
+{
+    const Subvolume *subvol = constFind(id);
+    return subvol != nullptr ? *subvol : Subvolume();
+}
+
+void SubvolumeMap::addToIndexes(const Subvolume &subvol)
+{
+    m_byName.insert(subvol.subvolName, subvol.id);
+    if (!subvol.uuid.isNull()) {
+        m_byUuid.insert(subvol.uuid, subvol.id);
+    }
+    if (!subvol.parentUuid.isNull()) {
+        m_byParentUuid.insert(subvol.parentUuid, subvol.id);
+    }
+    if (!subvol.receivedUuid.isNull()) {
+        m_byReceivedUuid.insert(subvol.receivedUuid, subvol.id);
+    }
+    if (subvol.parentId != 0) {
+        m_byParentId.insert(subvol.parentId, subvol.id);
+    }
+}
+
+void SubvolumeMap::removeFromIndexes(const Subvolume &subvol)
+{
+    // Only remove the entries pointing at this subvolume in case another one has the same key
+    if (m_byName.value(subvol.subvolName) == subvol.id) {
+        m_byName.remove(subvol.subvolName);
+    }
+    if (m_byUuid.value(subvol.uuid) == subvol.id) {
+        m_byUuid.remove(subvol.uuid);
+    }
+    if (m_byReceivedUuid.value(subvol.receivedUuid) == subvol.id) {
+        m_byReceivedUuid.remove(subvol.receivedUuid);
+    }
+    m_byParentUuid.remove(subvol.parentUuid, subvol.id);
+    m_byParentId.remove(subvol.parentId, subvol.id);
+}
 
-bool Subvolume::isSnapshot() const { return !parentUuid.isEmpty(); }
+SubvolumeChanges SubvolumeChanges::between(const SubvolumeMap &before, const SubvolumeMap &after)
+{
+    SubvolumeChanges changes;
 
-bool Subvolume::isReceived() const { return !receivedUuid.isEmpty(); }
+    for (const Subvolume &subvol : before) {
+        if (!after.contains(subvol.id)) {
+            changes.removed.append(subvol.id);
+        }
+    }
+
+    for (const Subvolume &subvol : after) {
+        const Subvolume *prev = before.constFind(subvol.id);
+        if (prev == nullptr) {
+            changes.added.append(subvol.id);
+        } else if (isSubvolumeChanged(*prev, subvol)) {
+            changes.changed.append(subvol.id);
+        }
+    }
+
+    return changes;
+}
@@ -2,14 +2,25 @@
 #define BTRFS_H
 
 #include <QDateTime>
+#include <QFuture>
+#include <QHash>
 #include <QMap>
 #include <QObject>
+#include <QUuid>
+
+#include "util/System.h"
 
 #include <btrfsutil.h>
+#include <memory>
 #include <optional>
 
 constexpr uint64_t BTRFS_ROOT_ID = 5;
 
+class BtrfsBackend;
+
+// Whether the service classes read their data when they are constructed or wait for it to be loaded or handed to them later
+enum class InitialLoad { Now, Later };
+
 struct RestoreResult {
     bool isSuccess = false;
     QString failureMessage;
@@ -22,18 +33,27 @@ struct SubvolResult {
 };
 
 struct Subvolume {
+    // What the subvolume is used for, worked out from its path when it is read
+    enum Kind : uint8_t { Snapper = 0x1, Timeshift = 0x2, Container = 0x4 };
+
     uint64_t id = 0;
     uint64_t parentId = 0;
+    // The inode of the directory in the parent subvolume that holds this one
+    uint64_t dirId = 0;
     QString subvolName;
-    QString uuid;
-    QString parentUuid;
-    QString receivedUuid;
+    QUuid uuid;
+    QUuid parentUuid;
+    QUuid receivedUuid;
     uint64_t generation = 0;
+    // Every subvolume of a filesystem shares the same string data
     QString filesystemUuid;
     uint64_t size = 0;
     uint64_t exclusive = 0;
     uint64_t flags = 0;
-    QDateTime createdAt;
+    // Seconds since the epoch
+    qint64 createdAt = 0;
+    // A combination of Kind values
+    uint8_t kind = 0;
 
     /** @brief Returns true if this instance doesn't represent any subvolume */
     bool isEmpty() const;
@@ -48,7 +68,151 @@ struct Subvolume {
     bool isReceived() const;
 };
 
-using SubvolumeMap = QMap<uint64_t, Subvolume>;
+/**
+ * @brief The subvolumes of a single filesystem stored contiguously in order of their id
+ *
+ * The rows are implicitly shared so copies, such as the ones returned by Btrfs::listSubvolumes and held by the subvolume model,
+ * don't duplicate any subvolumes until one of them is modified.  Lookups by id use a binary search over the rows.  Hash indexes
+ * on the name, the UUIDs and the parent id are kept up to date by every modification so those lookups don't need the disk.
+ */
+class SubvolumeMap {
+  public:
+    using const_iterator = QVector<Subvolume>::const_iterator;
+
+    SubvolumeMap() = default;
+
+    /**
+     * @brief Builds a table from @p subvolumes in any order, when an id appears more than once the last one is kept
+     */
+    explicit SubvolumeMap(QVector<Subvolume> subvolumes);
+
+    const Subvolume &at(qsizetype row) const { return m_rows.at(row); }
+    const_iterator begin() const { return m_rows.cbegin(); }
+    const_iterator cbegin() const { return m_rows.cbegin(); }
+    const_iterator cend() const { return m_rows.cend(); }
+    void clear();
+    bool contains(uint64_t id) const { return indexOf(id) >= 0; }
+    qsizetype count() const { return m_rows.count(); }
+    const_iterator end() const { return m_rows.cend(); }
+    bool isEmpty() const { return m_rows.isEmpty(); }
+
+    /**
+     * @brief Returns the subvolume with @p id or nullptr if there isn't one, the pointer is invalidated by any modification
+     */
+    const Subvolume *constFind(uint64_t id) const;
+
+    /**
+     * @brief Returns the ids of the subvolumes directly below the subvolume with @p parentId
+     */
+    QList<uint64_t> childrenOf(uint64_t parentId) const { return m_byParentId.values(parentId); }
+
+    /**
+     * @brief The modifiable version of constFind(), this detaches the table from its copies
+     *
+     * The indexed fields, the id, name, parent id and UUIDs, must not be changed through the pointer, use insert() instead.
+     */
+    Subvolume *find(uint64_t id);
+
+    /**
+     * @brief Returns the id of the subvolume at @p subvolName relative to the root of the filesystem or 0 if there isn't one
+     */
+    uint64_t idOf(const QString &subvolName) const;
+
+    /**
+     * @brief Returns the id of the subvolume with @p uuid or 0 if there isn't one
+     */
+    uint64_t idOfUuid(const QUuid &uuid) const { return m_byUuid.value(uuid); }
+
+    /**
+     * @brief Returns the id of the subvolume received with @p receivedUuid or 0 if there isn't one
+     */
+    uint64_t idOfReceivedUuid(const QUuid &receivedUuid) const { return m_byReceivedUuid.value(receivedUuid); }
+
+    /**
+     * @brief Returns the row of the subvolume with @p id or -1 if there isn't one
+     */
+    qsizetype indexOf(uint64_t id) const;
+
+    /**
+     * @brief Adds @p subvol or replaces the subvolume with the same id
+     */
+    void insert(const Subvolume &subvol);
+
+    /**
+     * @brief Removes the subvolume with @p id if there is one
+     */
+    void remove(uint64_t id);
+
+    /**
+     * @brief Returns the ids of the snapshots taken of the subvolume with @p parentUuid
+     */
+    QList<uint64_t> snapshotsOf(const QUuid &parentUuid) const { return m_byParentUuid.values(parentUuid); }
+
+    /**
+     * @brief Returns a copy of the subvolume with @p id or a default constructed Subvolume if there isn't one
+     */
+    Subvolume value(uint64_t id) const;
+
+  private:
+    /**
+     * @brief Adds @p subvol to the indexes
+     */
+    void addToIndexes(const Subvolume &subvol);
+
+    /**
+     * @brief Removes @p subvol from the indexes
+     */
+    void removeFromIndexes(const Subvolume &subvol);
+
+    QVector<Subvolume> m_rows;
+
+    // Secondary indexes, each maps to subvolume ids
+    QHash<QString, uint64_t> m_byName;
+    QHash<QUuid, uint64_t> m_byUuid;
+    QMultiHash<QUuid, uint64_t> m_byParentUuid;
+    QHash<QUuid, uint64_t> m_byReceivedUuid;
+    QMultiHash<uint64_t, uint64_t> m_byParentId;
+};
+
+// The subvolume ids that differ between two reads of the same filesystem
+struct SubvolumeChanges {
+    QList<uint64_t> added;
+    QList<uint64_t> removed;
+    QList<uint64_t> changed;
+
+    /** @brief Returns true if nothing changed */
+    bool isEmpty() const { return added.isEmpty() && removed.isEmpty() && changed.isEmpty(); }
+
+    /**
+     * @brief Returns the ids of the subvolumes that were added to, removed from or changed in @p after compared to @p before
+     */
+    static SubvolumeChanges between(const SubvolumeMap &before, const SubvolumeMap &after);
+};
+
+// Describes a mounted btrfs filesystem as registered by the kernel in /sys/fs/btrfs
+struct BtrfsFilesystemInfo {
+    QString uuid;
+    QString label;
+    // Absolute paths to the device nodes the filesystem is made of
+    QStringList devices;
+    // The names of the features enabled on the filesystem
+    QStringList features;
+    uint32_t nodeSize = 0;
+    uint32_t sectorSize = 0;
+};
+
+// The space allocated to a single block group type and profile combination, for example "Data, RAID1"
+struct BtrfsProfileUsage {
+    // The BTRFS_BLOCK_GROUP_* flags describing the type and profile
+    uint64_t flags = 0;
+    QString type;
+    QString profile;
+    // The logical size and usage of the chunks
+    uint64_t size = 0;
+    uint64_t used = 0;
+    // The number of bytes the chunks occupy on the devices
+    uint64_t diskSize = 0;
+};
 
 struct BtrfsFilesystem {
     bool isPopulated = false;
@@ -63,9 +227,63 @@ struct BtrfsFilesystem {
     uint64_t metaUsed = 0;
     uint64_t sysSize = 0;
     uint64_t sysUsed = 0;
+    QVector<BtrfsProfileUsage> profiles;
     SubvolumeMap subvolumes;
 };
 
+// The progress of a balance, counted in chunks, or of a scrub, counted in bytes
+struct BtrfsProgress {
+    bool isRunning = false;
+    // A paused balance is still running but doesn't move until it is resumed
+    bool isPaused = false;
+    uint64_t done = 0;
+    uint64_t total = 0;
+    // The read, checksum, verify and super block errors found by a scrub
+    uint64_t errors = 0;
+    // The units done per second and the seconds left at that rate, or -1 when the rate isn't known yet
+    double rate = 0;
+    qint64 secondsLeft = -1;
+};
+
+// A file or directory that differs between two subvolumes
+struct FileChange {
+    enum Type : uint8_t { Created, Deleted, Modified, Renamed };
+
+    Type type = Modified;
+    // The path relative to the root of the subvolume, in the older subvolume for Deleted and in the newer one otherwise
+    QString path;
+    // The path in the older subvolume for Renamed, empty otherwise
+    QString oldPath;
+};
+
+// The outcome of comparing two subvolumes
+struct FileChanges {
+    // Set when the subvolumes couldn't be compared, nothing else is filled in then
+    QString error;
+    // Sorted by path
+    QVector<FileChange> changes;
+};
+
+// An inode of a subvolume that changed after a given generation
+struct ChangedInode {
+    uint64_t inode = 0;
+    // The transaction that last changed the inode or its data
+    uint64_t transid = 0;
+    // True when the inode was created after the generation
+    bool isNew = false;
+    bool isDirectory = false;
+    // The path relative to the root of the subvolume
+    QString path;
+};
+
+// The outcome of looking for the inodes that changed in a subvolume
+struct ChangedInodes {
+    // Set when the subvolume couldn't be searched, nothing else is filled in then
+    QString error;
+    // Sorted by path
+    QVector<ChangedInode> inodes;
+};
+
 /**
  * @brief The Btrfs service class handles all btrfs device functionality.
  */
@@ -73,16 +291,26 @@ class Btrfs : public QObject {
     Q_OBJECT
 
   public:
-    explicit Btrfs(QObject *parent = nullptr);
+    /**
+     * @brief Creates an instance that reads the filesystems right away unless @p initialLoad is InitialLoad::Later
+     *
+     * A deferred instance holds no filesystems until loadVolumes() or updateFilesystems() is called and doesn't write the metadata
+     * cache before then either.
+     */
+    explicit Btrfs(InitialLoad initialLoad = InitialLoad::Now, QObject *parent = nullptr);
+
+    /**
+     * @brief Creates an instance that reads and changes the filesystems through @p backend instead of libbtrfsutil
+     */
+    explicit Btrfs(std::unique_ptr<BtrfsBackend> backend, InitialLoad initialLoad = InitialLoad::Now, QObject *parent = nullptr);
 
     ~Btrfs();
 
     /**
-     * @brief Checks the balance status of a given subvolume.
-     * @param mountpoint - A Qstring that represents the mountpoint to check for a btrfs balance on
-     * @return Qstring that contains the output from the btrfs balance command.
+     * @brief Reads the progress of the balance on the filesystem with @p uuid
+     * @return A QFuture with the progress in chunks, the rate and the time left aren't filled in
      */
-    QString balanceStatus(const QString &mountpoint) const;
+    QFuture<BtrfsProgress> balanceProgress(const QString &uuid) const;
 
     /** @brief Returns the data for the Btrfs volume identified by @p UUID
      *
@@ -102,6 +330,20 @@ class Btrfs : public QObject {
      */
     QStringList children(const uint64_t subvolid, const QString &uuid) const;
 
+    /**
+     * @brief Lists the files that differ between two subvolumes of the filesystem with @p uuid
+     *
+     * The kernel generates an incremental send stream without the file data, which only walks the parts of the trees that
+     * differ, and the stream is parsed as it is read.  A @p childId that isn't read-only, such as a live subvolume, is compared
+     * through a temporary read-only snapshot that is deleted again afterwards.  Those left behind by a process that was killed
+     * during the send are deleted by the next compare.
+     *
+     * @param parentId - The id of the older subvolume, it must be read-only
+     * @param childId - The id of the newer subvolume
+     * @return A QFuture with the changes or the reason they couldn't be read
+     */
+    QFuture<FileChanges> compareSubvolumes(const QString &uuid, uint64_t parentId, uint64_t childId);
+
     /**
      * @brief Creates a btrfs snapshot
      * @param source - The absolute path to the source subvolume
@@ -131,6 +373,18 @@ class Btrfs : public QObject {
      */
     bool deleteSubvol(const QString &uuid, const uint64_t subvolid);
 
+    /**
+     * @brief Lists the inodes of a subvolume that changed after @p generation, like btrfs subvolume find-new
+     *
+     * Only the parts of the subvolume tree written after @p generation are searched so the time taken follows the amount of
+     * change rather than the size of the subvolume.  Inodes that no longer have a path, such as deleted files, are left out.
+     *
+     * @param uuid - The UUID of the filesystem
+     * @param subvolId - The id of the subvolume to search
+     * @return A QFuture with the changed inodes or the reason the subvolume couldn't be searched
+     */
+    QFuture<ChangedInodes> findChangedSince(const QString &uuid, uint64_t subvolId, uint64_t generation) const;
+
     /**
      * @brief Finds a single mountpoint for a btrfs filesystem
      * @param uuid The uuid of the filesystem to find the mountpoint for
@@ -171,9 +425,25 @@ class Btrfs : public QObject {
      */
     static bool isContainer(const QString &subvolume) { return subvolume.contains("/btrfs/subvolumes"); }
 
+    /**
+     * @brief Returns the combination of Subvolume::Kind values that apply to the subvolume at @p subvolume
+     */
+    static uint8_t kindOf(const QString &subvolume);
+
+    /**
+     * @brief Returns metadata for each mounted Btrfs filesystem
+     *
+     * The data is read from /sys/fs/btrfs.  When @p useCache is true, the result of a previous call is returned as long as
+     * the mount table hasn't changed since.
+     *
+     * @param useCache - Whether a cached result may be used
+     * @return A QVector with one BtrfsFilesystemInfo per filesystem
+     */
+    static QVector<BtrfsFilesystemInfo> listFilesystemInfo(bool useCache = true);
+
     /** @brief Returns a QStringList of UUIDs containing Btrfs filesystems
      */
-    static QStringList listFilesystems();
+    static QStringList listFilesystems(bool useCache = true);
 
     /** @brief Returns a mountpoints for each Btrfs subvolume
      *
@@ -190,12 +460,6 @@ class Btrfs : public QObject {
      */
     SubvolumeMap listSubvolumes(const QString &uuid) const;
 
-    /**
-     * @brief Reads the qgroup data to populate subvol sizes
-     * @param uuid - The UUID to read the qgroup data from
-     */
-    void loadQgroups(const QString &uuid);
-
     /** @brief Reloads the btrfs subvolume list for a given volume
      *
      *  Updates the subvol list in m_btrfsVolumes for @p uuid
@@ -203,12 +467,25 @@ class Btrfs : public QObject {
      */
     void loadSubvols(const QString &uuid);
 
+    /**
+     * @brief Brings the subvolume list for @p uuid up to date without reading every subvolume again
+     *
+     * The root tree is scanned every time since a subvolume can be added, removed or moved without the transaction id changing.
+     * Only the subvolumes that were added or whose root item changed are looked up, the others are kept from the previous load.
+     *
+     * @param uuid - The UUID of the filesystem to refresh
+     * @return The ids of the subvolumes that were added, removed or changed
+     */
+    SubvolumeChanges refreshSubvols(const QString &uuid);
+
     /** @brief Reloads the btrfs metadata
      *
      *  Populates m_btrfsVolumes with data from all the btrfs filesystems
      *
+     *  @param cached - The subvolumes saved by an earlier run, they are checked against the root tree instead of read from scratch
+     *  @return The UUIDs of the filesystems that were read, the others keep whatever they held before
      */
-    void loadVolumes();
+    QStringList loadVolumes(const QMap<QString, BtrfsFilesystem> &cached = QMap<QString, BtrfsFilesystem>());
 
     /** @brief Mounts the root of a given Btrfs volume
      *
@@ -235,18 +512,18 @@ class Btrfs : public QObject {
                                 const QString &customName = QString());
 
     /**
-     * @brief Checks the scrub status of a given subvolume.
-     * @param mountpoint - A Qstring that represents the mountpoint to check for a btrfs scrub on
-     * @return Qstring that contains the output from the btrfs scrub command.
+     * @brief Reads the progress of the scrub on the filesystem with @p uuid
+     * @return A QFuture with the progress in bytes, the rate and the time left aren't filled in
      */
-    QString scrubStatus(const QString &mountpoint) const;
+    QFuture<BtrfsProgress> scrubProgress(const QString &uuid) const;
 
     /**
      * @brief Enables or disables btrfs qgroup support on @p mountpoint
      * @param mountpoint - An absolute path to the mountpoint that qgroups will be enabled on
      * @param enable - A boolean that enables qgroups when true and disables them when false
+     * @return A QFuture that finishes when the btrfs command exits
      */
-    static void setQgroupEnabled(const QString &mountpoint, bool enable);
+    static QFuture<Result> setQgroupEnabled(const QString &mountpoint, bool enable);
 
     /**
      * @brief Return whether a given path is a subvolume.
@@ -327,26 +604,30 @@ class Btrfs : public QObject {
     /**
      * @brief Performs a balance operation on top level subvolume for device.
      * @param uuid - A QString that represents the UUID of the filesystem to identify top level mountpoint
+     * @return A QFuture that finishes when the btrfs command exits
      */
-    void startBalanceRoot(const QString &uuid);
+    QFuture<Result> startBalanceRoot(const QString &uuid);
 
     /**
      * @brief Performs a scrub operation on root subvolume for device.
      * @param uuid - A QString that represents the UUID of the filesystem to identify top level mountpoint
+     * @return A QFuture that finishes when the btrfs command exits
      */
-    void startScrubRoot(const QString &uuid);
+    QFuture<Result> startScrubRoot(const QString &uuid);
 
     /**
      * @brief Stops a balance operation on root subvolume for device.
      * @param uuid - A QString that represents the UUID of the filesystem to identify top level mountpoint
+     * @return A QFuture that finishes when the btrfs command exits
      */
-    void stopBalanceRoot(const QString &uuid);
+    QFuture<Result> stopBalanceRoot(const QString &uuid);
 
     /**
      * @brief Stops a scrub operation on root subvolume for device.
      * @param uuid - A QString that represents the UUID of the filesystem to identify top level mountpoint
+     * @return A QFuture that finishes when the btrfs command exits
      */
-    void stopScrubRoot(const QString &uuid);
+    QFuture<Result> stopScrubRoot(const QString &uuid);
 
     /**
      * @brief Provides access to the full metadata for all btrfs volumes
@@ -354,10 +635,17 @@ class Btrfs : public QObject {
      */
     const QMap<QString, BtrfsFilesystem> &filesystems() { return m_filesystems; }
 
+    /**
+     * @brief Replaces the metadata of each btrfs volume in @p filesystems with what another instance read, the others are kept
+     */
+    void updateFilesystems(const QMap<QString, BtrfsFilesystem> &filesystems);
+
   private:
     // A map of BtrfsFilesystem.  The key is UUID
     QMap<QString, BtrfsFilesystem> m_filesystems;
-    QVector<QString> m_tempMountpoints;
+    // False until the filesystems have been loaded or handed over, the metadata cache is only written after that
+    bool m_isLoaded = false;
+    std::unique_ptr<BtrfsBackend> m_backend;
 
     /**
      * @brief Validates the UUID passed in actually exists and is accessible still.
@@ -365,11 +653,6 @@ class Btrfs : public QObject {
      * @return bool - True if the UUID is a mounted Btrfs filesystem
      */
     bool isUuidLoaded(const QString &uuid);
-
-    /**
-     * @brief Unmounts any filesystems that were mounted by the application
-     */
-    void unmountFilesystems();
 };
 
 #endif // BTRFS_H
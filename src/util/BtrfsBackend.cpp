@@ -0,0 +1,837 @@
+#include "util/BtrfsBackend.h"
+#include "util/MountTable.h"
+#include "util/System.h"
+
+#include <fcntl.h>
+#include <linux/btrfs.h>
+#include <linux/btrfs_tree.h>
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QThread>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <endian.h>
+#include <memory>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Converts a UUID as stored by btrfs, an all zero UUID becomes a null QUuid
+ */
+QUuid toUuid(const uint8_t uuid[16])
+{
+    return QUuid::fromRfc4122(QByteArray::fromRawData(reinterpret_cast<const char *>(uuid), 16));
+}
+
+/**
+ * @brief Returns the name btrfs-progs uses for the profile in a set of block group flags
+ */
+QString profileName(const uint64_t flags)
+{
+    switch (flags & BTRFS_BLOCK_GROUP_PROFILE_MASK) {
+    case BTRFS_BLOCK_GROUP_RAID0:
+        return QStringLiteral("RAID0");
+    case BTRFS_BLOCK_GROUP_RAID1:
+        return QStringLiteral("RAID1");
+    case BTRFS_BLOCK_GROUP_RAID1C3:
+        return QStringLiteral("RAID1C3");
+    case BTRFS_BLOCK_GROUP_RAID1C4:
+        return QStringLiteral("RAID1C4");
+    case BTRFS_BLOCK_GROUP_DUP:
+        return QStringLiteral("DUP");
+    case BTRFS_BLOCK_GROUP_RAID10:
+        return QStringLiteral("RAID10");
+    case BTRFS_BLOCK_GROUP_RAID5:
+        return QStringLiteral("RAID5");
+    case BTRFS_BLOCK_GROUP_RAID6:
+        return QStringLiteral("RAID6");
+    default:
+        return QStringLiteral("single");
+    }
+}
+
+/**
+ * @brief Returns how many bytes on disk a single logical byte occupies for the profile in @p flags
+ *
+ * For the parity profiles this assumes the chunks are striped across all @p numDevices devices.
+ */
+double profileRatio(const uint64_t flags, const uint64_t numDevices)
+{
+    switch (flags & BTRFS_BLOCK_GROUP_PROFILE_MASK) {
+    case BTRFS_BLOCK_GROUP_RAID1:
+    case BTRFS_BLOCK_GROUP_DUP:
+    case BTRFS_BLOCK_GROUP_RAID10:
+        return 2.0;
+    case BTRFS_BLOCK_GROUP_RAID1C3:
+        return 3.0;
+    case BTRFS_BLOCK_GROUP_RAID1C4:
+        return 4.0;
+    case BTRFS_BLOCK_GROUP_RAID5:
+        return numDevices > 1 ? static_cast<double>(numDevices) / static_cast<double>(numDevices - 1) : 1.0;
+    case BTRFS_BLOCK_GROUP_RAID6:
+        return numDevices > 2 ? static_cast<double>(numDevices) / static_cast<double>(numDevices - 2) : 1.0;
+    default:
+        return 1.0;
+    }
+}
+
+/**
+ * @brief Reads the space accounting for a mounted filesystem using ioctls and sysfs
+ *
+ * Device sizes come from BTRFS_IOC_FS_INFO/BTRFS_IOC_DEV_INFO and the per profile chunk usage from BTRFS_IOC_SPACE_INFO.  When
+ * available, the raw on-disk numbers are taken from /sys/fs/btrfs/<uuid>/allocation, otherwise they are derived from the
+ * profile.  The free space estimates follow the same rules as `btrfs filesystem usage`.
+ *
+ * @param uuid - The UUID of the filesystem
+ * @param mountpoint - Any mountpoint of the filesystem
+ * @return A BtrfsFilesystem with the size related fields populated
+ */
+BtrfsFilesystem readFilesystemUsage(const QString &uuid, const QString &mountpoint)
+{
+    BtrfsFilesystem btrfs;
+
+    const int fd = open(mountpoint.toLocal8Bit(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return btrfs;
+    }
+
+    struct btrfs_ioctl_fs_info_args fsInfo = {};
+    if (ioctl(fd, BTRFS_IOC_FS_INFO, &fsInfo) != 0) {
+        close(fd);
+        return btrfs;
+    }
+
+    // Device ids can have holes in them after a device has been removed so every id up to max_id needs to be checked
+    for (uint64_t devid = 1; devid <= fsInfo.max_id; ++devid) {
+        struct btrfs_ioctl_dev_info_args devInfo = {};
+        devInfo.devid = devid;
+        if (ioctl(fd, BTRFS_IOC_DEV_INFO, &devInfo) == 0) {
+            btrfs.totalSize += devInfo.total_bytes;
+            btrfs.allocatedSize += devInfo.bytes_used;
+        }
+    }
+
+    // With no slots the kernel only reports how many are needed
+    struct btrfs_ioctl_space_args spaceCount = {};
+    QByteArray spaceBuffer;
+    if (ioctl(fd, BTRFS_IOC_SPACE_INFO, &spaceCount) == 0 && spaceCount.total_spaces > 0) {
+        const size_t bufferSize = sizeof(struct btrfs_ioctl_space_args) + spaceCount.total_spaces * sizeof(struct btrfs_ioctl_space_info);
+        spaceBuffer.fill(0, static_cast<qsizetype>(bufferSize));
+        auto *spaceArgs = reinterpret_cast<struct btrfs_ioctl_space_args *>(spaceBuffer.data());
+        spaceArgs->space_slots = spaceCount.total_spaces;
+        if (ioctl(fd, BTRFS_IOC_SPACE_INFO, spaceArgs) != 0) {
+            spaceBuffer.clear();
+        }
+    }
+    close(fd);
+
+    double maxDataRatio = 1.0;
+    uint64_t dataDiskSize = 0;
+
+    if (!spaceBuffer.isEmpty()) {
+        const auto *spaceArgs = reinterpret_cast<const struct btrfs_ioctl_space_args *>(spaceBuffer.constData());
+        for (uint64_t i = 0; i < spaceArgs->total_spaces; ++i) {
+            const struct btrfs_ioctl_space_info &space = spaceArgs->spaces[i];
+
+            // The global reserve is carved out of metadata and isn't a chunk allocation
+            if (space.flags & BTRFS_SPACE_INFO_GLOBAL_RSV) {
+                continue;
+            }
+
+            const double ratio = profileRatio(space.flags, fsInfo.num_devices);
+
+            BtrfsProfileUsage usage;
+            usage.flags = space.flags;
+            usage.profile = profileName(space.flags);
+            usage.size = space.total_bytes;
+            usage.used = space.used_bytes;
+            usage.diskSize = static_cast<uint64_t>(static_cast<double>(space.total_bytes) * ratio);
+
+            if (space.flags & BTRFS_BLOCK_GROUP_DATA) {
+                usage.type = (space.flags & BTRFS_BLOCK_GROUP_METADATA) ? QStringLiteral("Data+Metadata") : QStringLiteral("Data");
+                btrfs.dataSize += space.total_bytes;
+                btrfs.dataUsed += space.used_bytes;
+                dataDiskSize += usage.diskSize;
+                maxDataRatio = std::max(maxDataRatio, ratio);
+            } else if (space.flags & BTRFS_BLOCK_GROUP_METADATA) {
+                usage.type = QStringLiteral("Metadata");
+                btrfs.metaSize += space.total_bytes;
+                btrfs.metaUsed += space.used_bytes;
+            } else if (space.flags & BTRFS_BLOCK_GROUP_SYSTEM) {
+                usage.type = QStringLiteral("System");
+                btrfs.sysSize += space.total_bytes;
+                btrfs.sysUsed += space.used_bytes;
+            }
+
+            btrfs.usedSize += static_cast<uint64_t>(static_cast<double>(space.used_bytes) * ratio);
+            btrfs.profiles.append(usage);
+        }
+    }
+
+    // sysfs has the exact on-disk numbers which are better than the estimates above for the parity profiles
+    const QString allocationPath = QStringLiteral("/sys/fs/btrfs/") + uuid + QStringLiteral("/allocation/");
+    const QStringList types = {QStringLiteral("data"), QStringLiteral("metadata"), QStringLiteral("system")};
+    uint64_t sysfsDiskUsed = 0;
+    bool hasSysfsDiskUsed = true;
+    for (const QString &type : types) {
+        bool ok = false;
+        sysfsDiskUsed += readSysfsValue(allocationPath + type + QStringLiteral("/disk_used")).toULongLong(&ok);
+        hasSysfsDiskUsed &= ok;
+    }
+    if (hasSysfsDiskUsed) {
+        btrfs.usedSize = sysfsDiskUsed;
+    }
+
+    bool ok = false;
+    const uint64_t sysfsDataDiskTotal = readSysfsValue(allocationPath + QStringLiteral("data/disk_total")).toULongLong(&ok);
+    if (ok) {
+        dataDiskSize = sysfsDataDiskTotal;
+    }
+
+    double dataRatio = 1.0;
+    if (btrfs.dataSize > 0 && dataDiskSize > 0) {
+        dataRatio = static_cast<double>(dataDiskSize) / static_cast<double>(btrfs.dataSize);
+    }
+
+    const uint64_t unallocated = btrfs.totalSize > btrfs.allocatedSize ? btrfs.totalSize - btrfs.allocatedSize : 0;
+    const uint64_t dataFree = btrfs.dataSize > btrfs.dataUsed ? btrfs.dataSize - btrfs.dataUsed : 0;
+    btrfs.freeSize = dataFree + static_cast<uint64_t>(static_cast<double>(unallocated) / dataRatio);
+    btrfs.freeSizeMin = dataFree + static_cast<uint64_t>(static_cast<double>(unallocated) / maxDataRatio);
+
+    return btrfs;
+}
+
+Subvolume infoToSubvolume(const QString &fileSystemUuid, const QString &name, const struct btrfs_util_subvolume_info &subvolInfo)
+{
+    Subvolume ret;
+    ret.subvolName = name;
+    ret.parentId = subvolInfo.parent_id;
+    ret.dirId = subvolInfo.dir_id;
+    ret.id = subvolInfo.id;
+    ret.uuid = toUuid(subvolInfo.uuid);
+    ret.parentUuid = toUuid(subvolInfo.parent_uuid);
+    ret.receivedUuid = toUuid(subvolInfo.received_uuid);
+    ret.generation = subvolInfo.generation;
+    ret.flags = subvolInfo.flags;
+    ret.createdAt = subvolInfo.otime.tv_sec;
+
+    // The checks are done once here so the subvolume filter doesn't have to repeat them for every row
+    ret.kind = Btrfs::kindOf(name);
+    ret.filesystemUuid = fileSystemUuid;
+    return ret;
+}
+
+} // namespace
+
+BtrfsUtilBackend::~BtrfsUtilBackend()
+{
+    for (const QString &mountpoint : std::as_const(m_tempMountpoints)) {
+        umount2(mountpoint.toLocal8Bit(), MNT_DETACH);
+    }
+}
+
+btrfs_util_error BtrfsUtilBackend::createSnapshot(const QString &source, const QString &dest, bool readOnly)
+{
+    return Btrfs::createSnapshot(source, dest, readOnly);
+}
+
+btrfs_util_error BtrfsUtilBackend::deleteSubvolume(const QString &path) { return btrfs_util_delete_subvolume(path.toLocal8Bit(), 0); }
+
+QString BtrfsUtilBackend::findAnyMountpoint(const QString &uuid) { return MountTable::instance().findAnyMountpoint(uuid); }
+
+QStringList BtrfsUtilBackend::listFilesystems() { return Btrfs::listFilesystems(); }
+
+QString BtrfsUtilBackend::mountRoot(const QString &uuid)
+{
+    // Check to see if it is already mounted
+    QString mountpoint = MountTable::instance().findMountpoint(uuid, BTRFS_ROOT_ID);
+
+    // If it isn't mounted we need to mount it
+    if (mountpoint.isEmpty()) {
+        mountpoint = QDir::cleanPath(System::mountPathRoot() + QDir::separator() + uuid);
+
+        // Add this mountpoint to a list so it can be unmounted later
+        m_tempMountpoints.append(mountpoint);
+
+        // Create the mountpoint and mount the volume if successful
+        QDir tempMount;
+        const QString device = QDir::cleanPath(QStringLiteral("/dev/disk/by-uuid/") + uuid);
+        const QString options = "subvolid=" + QString::number(BTRFS_ROOT_ID);
+        if (!(tempMount.mkpath(mountpoint) &&
+              mount(device.toLocal8Bit(), mountpoint.toLocal8Bit(), "btrfs", 0, options.toLocal8Bit()) == 0)) {
+            return QString();
+        }
+    }
+
+    return mountpoint;
+}
+
+BtrfsProgress BtrfsUtilBackend::readBalanceProgress(const QString &mountpoint)
+{
+    BtrfsProgress progress;
+
+    const int fd = open(mountpoint.toLocal8Bit(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return progress;
+    }
+
+    // Fails with ENOTCONN when there is no balance
+    struct btrfs_ioctl_balance_args args = {};
+    if (ioctl(fd, BTRFS_IOC_BALANCE_PROGRESS, &args) == 0) {
+        progress.isRunning = true;
+        progress.isPaused = !(args.state & BTRFS_BALANCE_STATE_RUNNING);
+        progress.done = args.stat.completed;
+        progress.total = args.stat.expected;
+    }
+    close(fd);
+
+    return progress;
+}
+
+int BtrfsUtilBackend::readChangedInodes(const QString &mountpoint, uint64_t subvolId, uint64_t generation, QVector<ChangedInode> &result)
+{
+    // The name of an inode within its directory
+    struct InodeRef {
+        uint64_t parent = 0;
+        QString name;
+    };
+
+    const int fd = open(mountpoint.toLocal8Bit(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+
+    // The kernel skips every tree block older than min_transid, so only the leaves written after the generation are visited.  The
+    // items in those leaves that didn't change themselves are filtered out by their own transid.
+    QHash<uint64_t, ChangedInode> inodes;
+    QHash<uint64_t, InodeRef> refs;
+    struct btrfs_ioctl_search_key key = {};
+    key.tree_id = subvolId;
+    key.min_objectid = BTRFS_FIRST_FREE_OBJECTID;
+    key.max_objectid = BTRFS_LAST_FREE_OBJECTID;
+    key.min_type = BTRFS_INODE_ITEM_KEY;
+    key.max_type = BTRFS_EXTENT_DATA_KEY;
+    key.max_offset = UINT64_MAX;
+    key.min_transid = generation + 1;
+    key.max_transid = UINT64_MAX;
+
+    const auto readRef = [&refs](const struct btrfs_ioctl_search_header &header, const char *data) {
+        if (header.len < sizeof(struct btrfs_inode_ref) || refs.contains(header.objectid)) {
+            return;
+        }
+        const auto *ref = reinterpret_cast<const struct btrfs_inode_ref *>(data);
+        const size_t nameLength = std::min<size_t>(le16toh(ref->name_len), header.len - sizeof(struct btrfs_inode_ref));
+        const QByteArray name(data + sizeof(struct btrfs_inode_ref), static_cast<qsizetype>(nameLength));
+        refs.insert(header.objectid, {header.offset, QString::fromLocal8Bit(name)});
+    };
+
+    // A search that fails, for example because the subvolume was deleted, must not look like a subvolume without changes
+    const bool isSearched =
+        treeSearch(fd, key, [&inodes, &readRef, generation](const struct btrfs_ioctl_search_header &header, const char *data) {
+            if (header.type == BTRFS_INODE_ITEM_KEY && header.len >= sizeof(struct btrfs_inode_item)) {
+                const auto *item = reinterpret_cast<const struct btrfs_inode_item *>(data);
+                const uint64_t transid = le64toh(item->transid);
+                if (transid > generation) {
+                    ChangedInode &inode = inodes[header.objectid];
+                    inode.inode = header.objectid;
+                    inode.transid = std::max(inode.transid, transid);
+                    inode.isNew = le64toh(item->generation) > generation;
+                    inode.isDirectory = S_ISDIR(le32toh(item->mode));
+                }
+            } else if (header.type == BTRFS_INODE_REF_KEY) {
+                readRef(header, data);
+            } else if (header.type == BTRFS_EXTENT_DATA_KEY && header.len >= sizeof(uint64_t)) {
+                // The extent generation catches writes even when the inode item was left in an older leaf
+                const uint64_t extentGeneration = le64toh(reinterpret_cast<const struct btrfs_file_extent_item *>(data)->generation);
+                if (extentGeneration > generation) {
+                    ChangedInode &inode = inodes[header.objectid];
+                    inode.inode = header.objectid;
+                    inode.transid = std::max(inode.transid, extentGeneration);
+                }
+            }
+            return true;
+        });
+    if (!isSearched) {
+        const int error = errno;
+        close(fd);
+        return error;
+    }
+
+    // The names that weren't in the changed leaves are looked up in batches of nearby inode numbers, one search per batch
+    QVector<uint64_t> missing;
+    for (auto it = inodes.cbegin(); it != inodes.cend(); ++it) {
+        if (!refs.contains(it.key()) && it.key() != BTRFS_FIRST_FREE_OBJECTID) {
+            missing.append(it.key());
+        }
+    }
+    std::sort(missing.begin(), missing.end());
+
+    constexpr uint64_t MAX_BATCH_SPAN = 64;
+    for (qsizetype first = 0; first < missing.count();) {
+        qsizetype last = first;
+        while (last + 1 < missing.count() && missing.at(last + 1) - missing.at(first) < MAX_BATCH_SPAN) {
+            ++last;
+        }
+
+        struct btrfs_ioctl_search_key refKey = {};
+        refKey.tree_id = subvolId;
+        refKey.min_objectid = missing.at(first);
+        refKey.max_objectid = missing.at(last);
+        refKey.min_type = BTRFS_INODE_REF_KEY;
+        refKey.max_type = BTRFS_INODE_REF_KEY;
+        refKey.max_offset = UINT64_MAX;
+        refKey.max_transid = UINT64_MAX;
+        const bool isRefSearched =
+            treeSearch(fd, refKey, [&inodes, &readRef](const struct btrfs_ioctl_search_header &header, const char *data) {
+                if (header.type == BTRFS_INODE_REF_KEY && inodes.contains(header.objectid)) {
+                    readRef(header, data);
+                }
+                return true;
+            });
+        if (!isRefSearched) {
+            const int error = errno;
+            close(fd);
+            return error;
+        }
+
+        first = last + 1;
+    }
+
+    // Each directory is resolved once however many of the changed inodes are in it, its path ends with a slash
+    QHash<uint64_t, QString> directories;
+    directories.insert(BTRFS_FIRST_FREE_OBJECTID, QString());
+
+    result.clear();
+    result.reserve(inodes.size());
+    for (auto it = inodes.begin(); it != inodes.end(); ++it) {
+        const auto ref = refs.constFind(it.key());
+        // The root directory only refers to itself and an inode without a name has been unlinked
+        if (it.key() == BTRFS_FIRST_FREE_OBJECTID || ref == refs.cend()) {
+            continue;
+        }
+
+        auto directory = directories.constFind(ref->parent);
+        if (directory == directories.cend()) {
+            struct btrfs_ioctl_ino_lookup_args lookup = {};
+            lookup.treeid = subvolId;
+            lookup.objectid = ref->parent;
+            const QString path = ioctl(fd, BTRFS_IOC_INO_LOOKUP, &lookup) == 0 ? QString::fromLocal8Bit(lookup.name) : QString();
+            directory = directories.insert(ref->parent, path);
+        }
+
+        // Only the root directory has an empty path
+        if (directory->isEmpty() && ref->parent != BTRFS_FIRST_FREE_OBJECTID) {
+            continue;
+        }
+
+        it->path = *directory + ref->name;
+        result.append(*it);
+    }
+    close(fd);
+
+    return 0;
+}
+
+SubvolumeMap BtrfsUtilBackend::readChangedSubvolumes(const QString &uuid, const QString &mountpoint, const SubvolumeMap &previous)
+{
+    // The root tree is scanned for the ROOT_ITEM and ROOT_BACKREF of every subvolume, which is much cheaper than asking
+    // libbtrfsutil for the info and path of each one.  Only new subvolumes and the ones whose generation or flags changed are
+    // looked up.  A rename or move also changes the paths of everything below it so in that case the whole list is read again.
+    //
+    // What the root tree says about a subvolume
+    struct RootState {
+        uint64_t generation = 0;
+        uint64_t flags = 0;
+        uint64_t parentId = 0;
+        uint64_t dirId = 0;
+        QString name;
+        bool hasBackref = false;
+    };
+    QHash<uint64_t, RootState> roots;
+
+    const QByteArray path = mountpoint.toLocal8Bit();
+    const int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return readSubvolumes(uuid, mountpoint);
+    }
+
+    struct btrfs_ioctl_search_key key = {};
+    key.tree_id = BTRFS_ROOT_TREE_OBJECTID;
+    // The top level subvolume is included for its generation, it has no back reference
+    key.min_objectid = BTRFS_FS_TREE_OBJECTID;
+    key.max_objectid = BTRFS_LAST_FREE_OBJECTID;
+    key.min_type = BTRFS_ROOT_ITEM_KEY;
+    key.max_type = BTRFS_ROOT_BACKREF_KEY;
+    key.max_offset = UINT64_MAX;
+    key.max_transid = UINT64_MAX;
+
+    const bool isSearched = treeSearch(fd, key, [&roots](const struct btrfs_ioctl_search_header &header, const char *data) {
+        if (header.type == BTRFS_ROOT_ITEM_KEY && header.len >= offsetof(struct btrfs_root_item, flags) + sizeof(uint64_t)) {
+            const auto *item = reinterpret_cast<const struct btrfs_root_item *>(data);
+            roots[header.objectid].generation = le64toh(item->generation);
+            roots[header.objectid].flags = le64toh(item->flags);
+        } else if (header.type == BTRFS_ROOT_BACKREF_KEY && header.len >= sizeof(struct btrfs_root_ref)) {
+            // The back reference is keyed by the parent and followed by the name of the subvolume in the parent directory
+            const auto *ref = reinterpret_cast<const struct btrfs_root_ref *>(data);
+            const size_t nameLength = std::min<size_t>(le16toh(ref->name_len), header.len - sizeof(struct btrfs_root_ref));
+            RootState &state = roots[header.objectid];
+            state.parentId = header.offset;
+            state.dirId = le64toh(ref->dirid);
+            state.name = QString::fromLocal8Bit(data + sizeof(struct btrfs_root_ref), static_cast<qsizetype>(nameLength));
+            state.hasBackref = true;
+        }
+        return true;
+    });
+
+    if (!isSearched) {
+        close(fd);
+        return readSubvolumes(uuid, mountpoint);
+    }
+
+    // A directory renamed or moved inside a subvolume changes the paths of the subvolumes below it without touching their back
+    // references.  That only shows up in the root item of the parent once the transaction commits, then the directories holding
+    // the children of that parent are looked up again, once per directory.
+    QHash<QPair<uint64_t, uint64_t>, QString> directories;
+    const auto isPathChanged = [fd, &roots, &previous, &directories](const Subvolume &prev) {
+        const Subvolume *parent = previous.constFind(prev.parentId);
+        if (prev.dirId == BTRFS_FIRST_FREE_OBJECTID || parent == nullptr || parent->generation == roots.value(prev.parentId).generation) {
+            return false;
+        }
+
+        const QPair<uint64_t, uint64_t> key(prev.parentId, prev.dirId);
+        auto directory = directories.constFind(key);
+        if (directory == directories.cend()) {
+            struct btrfs_ioctl_ino_lookup_args lookup = {};
+            lookup.treeid = prev.parentId;
+            lookup.objectid = prev.dirId;
+            const QString path = ioctl(fd, BTRFS_IOC_INO_LOOKUP, &lookup) == 0 ? QString::fromLocal8Bit(lookup.name) : QString();
+            directory = directories.insert(key, path);
+        }
+
+        // The looked up path ends with a slash, the top level subvolume has an empty name
+        const QString parentPrefix = parent->subvolName.isEmpty() ? QString() : parent->subvolName + QLatin1Char('/');
+        return directory->isEmpty() || prev.subvolName != parentPrefix + *directory + prev.subvolName.section('/', -1);
+    };
+
+    QVector<Subvolume> subvols;
+    subvols.reserve(roots.size() + 1);
+    for (auto it = roots.cbegin(); it != roots.cend(); ++it) {
+        const RootState &state = it.value();
+
+        // Deleted subvolumes keep their root item until the cleaner gets to them but their back reference is gone right away
+        if (!state.hasBackref) {
+            continue;
+        }
+
+        const Subvolume *prev = previous.constFind(it.key());
+        if (prev != nullptr) {
+            if (prev->parentId != state.parentId || prev->dirId != state.dirId || prev->subvolName.section('/', -1) != state.name ||
+                isPathChanged(*prev)) {
+                close(fd);
+                return readSubvolumes(uuid, mountpoint);
+            }
+
+            if (prev->generation == state.generation && prev->flags == state.flags) {
+                subvols.append(*prev);
+                continue;
+            }
+        }
+
+        struct btrfs_util_subvolume_info subvolInfo;
+        char *subvolPath = nullptr;
+        if (btrfs_util_subvolume_info(path, it.key(), &subvolInfo) == BTRFS_UTIL_OK &&
+            btrfs_util_subvolume_path(path, it.key(), &subvolPath) == BTRFS_UTIL_OK) {
+            subvols.append(infoToSubvolume(uuid, QString::fromLocal8Bit(subvolPath), subvolInfo));
+        }
+        free(subvolPath);
+    }
+
+    close(fd);
+
+    // The top level subvolume has no back reference so it is always read
+    struct btrfs_util_subvolume_info subvolInfo;
+    if (btrfs_util_subvolume_info(path, BTRFS_ROOT_ID, &subvolInfo) == BTRFS_UTIL_OK) {
+        subvols.append(infoToSubvolume(uuid, QString(), subvolInfo));
+    }
+
+    return SubvolumeMap(subvols);
+}
+
+void BtrfsUtilBackend::readQgroups(const QString &mountpoint, SubvolumeMap &subvolumes)
+{
+    if (!Btrfs::isQuotaEnabled(mountpoint)) {
+        // If qgroups aren't enabled we need to abort
+        return;
+    }
+
+    const int fd = open(mountpoint.toLocal8Bit(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    // The usage of every qgroup is stored at (0, QGROUP_INFO, qgroupid)
+    struct btrfs_ioctl_search_key key = {};
+    key.tree_id = BTRFS_QUOTA_TREE_OBJECTID;
+    key.min_type = key.max_type = BTRFS_QGROUP_INFO_KEY;
+    key.max_offset = UINT64_MAX;
+    key.max_transid = UINT64_MAX;
+
+    treeSearch(fd, key, [&subvolumes](const struct btrfs_ioctl_search_header &header, const char *data) {
+        // Higher level qgroups have the level in the top 16 bits, the subvolume qgroups are level 0 and use the subvolume id
+        if (header.len < sizeof(struct btrfs_qgroup_info_item) || (header.offset >> 48) != 0) {
+            return true;
+        }
+
+        if (Subvolume *subvol = subvolumes.find(header.offset)) {
+            const auto *info = reinterpret_cast<const struct btrfs_qgroup_info_item *>(data);
+            subvol->size = le64toh(info->rfer);
+            subvol->exclusive = le64toh(info->excl);
+        }
+        return true;
+    });
+    close(fd);
+}
+
+BtrfsProgress BtrfsUtilBackend::readScrubProgress(const QString &mountpoint)
+{
+    BtrfsProgress progress;
+
+    const int fd = open(mountpoint.toLocal8Bit(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return progress;
+    }
+
+    struct btrfs_ioctl_fs_info_args fsInfo = {};
+    if (ioctl(fd, BTRFS_IOC_FS_INFO, &fsInfo) != 0) {
+        close(fd);
+        return progress;
+    }
+
+    // Each device is scrubbed separately so the progress is the sum over the devices.  A device that has finished while others
+    // are still going fails with ENOTCONN like one that was never scrubbed, it is counted as done since there is no way to tell.
+    uint64_t allocated = 0;
+    uint64_t finished = 0;
+    for (uint64_t devid = 1; devid <= fsInfo.max_id; ++devid) {
+        struct btrfs_ioctl_dev_info_args devInfo = {};
+        devInfo.devid = devid;
+        if (ioctl(fd, BTRFS_IOC_DEV_INFO, &devInfo) != 0) {
+            continue;
+        }
+        allocated += devInfo.bytes_used;
+
+        struct btrfs_ioctl_scrub_args scrub = {};
+        scrub.devid = devid;
+        if (ioctl(fd, BTRFS_IOC_SCRUB_PROGRESS, &scrub) != 0) {
+            finished += devInfo.bytes_used;
+            continue;
+        }
+
+        const struct btrfs_scrub_progress &stats = scrub.progress;
+        progress.isRunning = true;
+        progress.done += stats.data_bytes_scrubbed + stats.tree_bytes_scrubbed;
+        progress.errors += stats.read_errors + stats.csum_errors + stats.verify_errors + stats.super_errors;
+    }
+    close(fd);
+
+    // Scrub only reads the used part of the chunks, so like `btrfs scrub status` the total is the used bytes on disk rather than
+    // what the devices have allocated.  A finished device is assumed to have the same share of used bytes as the whole filesystem.
+    const uint64_t used = readFilesystemUsage(toUuid(fsInfo.fsid).toString(QUuid::WithoutBraces), mountpoint).usedSize;
+    progress.total = used > 0 ? used : allocated;
+    if (progress.isRunning) {
+        if (allocated > 0) {
+            const double usedShare = static_cast<double>(progress.total) / static_cast<double>(allocated);
+            finished = static_cast<uint64_t>(static_cast<double>(finished) * usedShare);
+        }
+        progress.done = std::min(progress.done + finished, progress.total);
+    }
+
+    return progress;
+}
+
+std::optional<Subvolume> BtrfsUtilBackend::readSubvolume(const QString &uuid, const QString &path)
+{
+    struct btrfs_util_subvolume_info subvolInfo;
+    const SubvolResult name = Btrfs::subvolumeName(path);
+    if (!name.success || btrfs_util_subvolume_info(path.toLocal8Bit(), 0, &subvolInfo) != BTRFS_UTIL_OK) {
+        return std::nullopt;
+    }
+
+    return infoToSubvolume(uuid, name.name, subvolInfo);
+}
+
+SubvolumeMap BtrfsUtilBackend::readSubvolumes(const QString &uuid, const QString &mountpoint)
+{
+    QVector<Subvolume> subvols;
+    btrfs_util_subvolume_iterator *iter;
+
+    btrfs_util_error returnCode = btrfs_util_create_subvolume_iterator(mountpoint.toLocal8Bit(), BTRFS_ROOT_ID, 0, &iter);
+    if (returnCode != BTRFS_UTIL_OK) {
+        return SubvolumeMap();
+    }
+
+    while (returnCode != BTRFS_UTIL_ERROR_STOP_ITERATION) {
+        char *path = nullptr;
+        struct btrfs_util_subvolume_info subvolInfo;
+        returnCode = btrfs_util_subvolume_iterator_next_info(iter, &path, &subvolInfo);
+        if (returnCode == BTRFS_UTIL_OK) {
+            subvols.append(infoToSubvolume(uuid, QString::fromLocal8Bit(path), subvolInfo));
+            free(path);
+        }
+    }
+    btrfs_util_destroy_subvolume_iterator(iter);
+
+    // We need to add the root at subvolid 5
+    struct btrfs_util_subvolume_info subvolInfo;
+    returnCode = btrfs_util_subvolume_info(mountpoint.toLocal8Bit(), BTRFS_ROOT_ID, &subvolInfo);
+    if (returnCode == BTRFS_UTIL_OK) {
+        subvols.append(infoToSubvolume(uuid, QString(), subvolInfo));
+    }
+
+    return SubvolumeMap(std::move(subvols));
+}
+
+QString BtrfsUtilBackend::readSysfsValue(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+
+    return QString::fromUtf8(file.readAll()).trimmed();
+}
+
+BtrfsFilesystem BtrfsUtilBackend::readUsage(const QString &uuid, const QString &mountpoint)
+{
+    return readFilesystemUsage(uuid, mountpoint);
+}
+
+bool BtrfsUtilBackend::renameSubvolume(const QString &source, const QString &target) { return Btrfs::renameSubvolume(source, target); }
+
+int BtrfsUtilBackend::send(const QString &parentPath, const QString &childPath, uint64_t flags,
+                           const std::function<void(const char *, qsizetype)> &consumer)
+{
+    const uint64_t parentId = subvolumeId(parentPath);
+    if (parentId == 0) {
+        return ENOENT;
+    }
+
+    const int childFd = open(childPath.toLocal8Bit(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (childFd < 0) {
+        return errno;
+    }
+
+    int pipeFds[2];
+    if (pipe2(pipeFds, O_CLOEXEC) != 0) {
+        const int error = errno;
+        close(childFd);
+        return error;
+    }
+
+    // The ioctl only returns once the whole stream has been written so it runs on its own thread while this one reads the pipe
+    int sendError = 0;
+    std::unique_ptr<QThread> sender(QThread::create([childFd, writeFd = pipeFds[1], parentId, flags, &sendError]() {
+        struct btrfs_ioctl_send_args args = {};
+        args.send_fd = writeFd;
+        args.parent_root = parentId;
+        args.flags = flags;
+        if (ioctl(childFd, BTRFS_IOC_SEND, &args) != 0) {
+            sendError = errno;
+        }
+
+        // Closing the write end is what ends the stream for the reader
+        close(writeFd);
+    }));
+    sender->start();
+
+    // The reader never stops early, a closed pipe would end the send with SIGPIPE
+    std::vector<char> buffer(64 * 1024);
+    for (;;) {
+        const ssize_t bytesRead = read(pipeFds[0], buffer.data(), buffer.size());
+        if (bytesRead > 0) {
+            consumer(buffer.data(), bytesRead);
+        } else if (bytesRead == 0 || errno != EINTR) {
+            break;
+        }
+    }
+
+    sender->wait();
+    close(pipeFds[0]);
+    close(childFd);
+
+    return sendError;
+}
+
+bool BtrfsUtilBackend::setSubvolumeReadOnly(const QString &path, bool readOnly) { return Btrfs::setSubvolumeReadOnly(path, readOnly); }
+
+uint64_t BtrfsUtilBackend::subvolumeId(const QString &path)
+{
+    uint64_t id;
+    if (btrfs_util_subvolume_id(path.toLocal8Bit(), &id) != BTRFS_UTIL_OK) {
+        return 0;
+    }
+
+    return id;
+}
+
+bool BtrfsUtilBackend::treeSearch(const int fd, const struct btrfs_ioctl_search_key &initialKey,
+                                  const std::function<bool(const struct btrfs_ioctl_search_header &, const char *)> &callback)
+{
+    struct btrfs_ioctl_search_key key = initialKey;
+
+    // Each call returns as many items as fit in the buffer, 64KiB holds a few thousand small items
+    constexpr size_t bufferSize = 64 * 1024;
+    QByteArray buffer(static_cast<qsizetype>(sizeof(struct btrfs_ioctl_search_args_v2) + bufferSize), '\0');
+    auto *args = reinterpret_cast<struct btrfs_ioctl_search_args_v2 *>(buffer.data());
+
+    while (true) {
+        args->key = key;
+        args->key.nr_items = UINT32_MAX;
+        args->buf_size = bufferSize;
+        if (ioctl(fd, BTRFS_IOC_TREE_SEARCH_V2, args) != 0) {
+            return false;
+        }
+
+        if (args->key.nr_items == 0) {
+            return true;
+        }
+
+        // Items are packed back to back and are not necessarily aligned
+        const char *item = reinterpret_cast<const char *>(args->buf);
+        struct btrfs_ioctl_search_header header = {};
+        for (uint32_t i = 0; i < args->key.nr_items; ++i) {
+            memcpy(&header, item, sizeof(header));
+            item += sizeof(header);
+            if (!callback(header, item)) {
+                return true;
+            }
+            item += header.len;
+        }
+
+        // The keys are searched as a single 136 bit number so the next search starts right after the last key returned
+        key.min_objectid = header.objectid;
+        key.min_type = header.type;
+        key.min_offset = header.offset;
+        if (key.min_offset < UINT64_MAX) {
+            ++key.min_offset;
+        } else if (key.min_type < UINT8_MAX) {
+            ++key.min_type;
+            key.min_offset = 0;
+        } else if (key.min_objectid < UINT64_MAX) {
+            ++key.min_objectid;
+            key.min_type = 0;
+            key.min_offset = 0;
+        } else {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef BTRFSBACKEND_H
+#define BTRFSBACKEND_H
+
+#include "util/Btrfs.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+#include <optional>
+
+struct btrfs_ioctl_search_header;
+struct btrfs_ioctl_search_key;
+
+/**
+ * @brief The BtrfsBackend class is everything the Btrfs class needs from the system to read and change subvolumes.
+ *
+ * Paths passed to and returned from a backend are absolute, the subvolume names stored in a SubvolumeMap are relative to the root
+ * of the filesystem.  A backend is only used from the thread that owns the Btrfs object, except for the read functions which are
+ * called for several filesystems at once while the volumes are loaded, and createSnapshot(), deleteSubvolume() and send() which
+ * are called in the background while two subvolumes are compared.  readChangedInodes() is also called in the background.
+ */
+class BtrfsBackend {
+  public:
+    virtual ~BtrfsBackend() = default;
+
+    /**
+     * @brief Creates a snapshot of the subvolume at @p source at @p dest
+     */
+    virtual btrfs_util_error createSnapshot(const QString &source, const QString &dest, bool readOnly) = 0;
+
+    /**
+     * @brief Deletes the subvolume at @p path
+     */
+    virtual btrfs_util_error deleteSubvolume(const QString &path) = 0;
+
+    /**
+     * @brief Returns any mountpoint of the filesystem with @p uuid or an empty string if it isn't mounted
+     */
+    virtual QString findAnyMountpoint(const QString &uuid) = 0;
+
+    /**
+     * @brief Returns the UUIDs of the filesystems that can be read
+     */
+    virtual QStringList listFilesystems() = 0;
+
+    /**
+     * @brief Returns a mountpoint of the top level subvolume of @p uuid, mounting it first if it isn't mounted
+     * @return The absolute path to the mountpoint or an empty string if it couldn't be mounted
+     */
+    virtual QString mountRoot(const QString &uuid) = 0;
+
+    /**
+     * @brief Rereads the subvolumes of a filesystem, reusing the entries of @p previous that haven't changed
+     * @return All the subvolumes without the qgroup sizes
+     */
+    virtual SubvolumeMap readChangedSubvolumes(const QString &uuid, const QString &mountpoint, const SubvolumeMap &previous) = 0;
+
+    /**
+     * @brief Reads the progress of the balance on the filesystem mounted at @p mountpoint
+     * @return The progress in chunks with isRunning set to false when there is no balance
+     */
+    virtual BtrfsProgress readBalanceProgress(const QString &mountpoint) = 0;
+
+    /**
+     * @brief Reads the inodes of subvolume @p subvolId that changed after @p generation along with their paths
+     * @param mountpoint - Any mountpoint of the filesystem
+     * @param inodes - Filled with the changed inodes that have a path, in no particular order
+     * @return 0 on success or the errno of the open or search that failed
+     */
+    virtual int readChangedInodes(const QString &mountpoint, uint64_t subvolId, uint64_t generation, QVector<ChangedInode> &inodes) = 0;
+
+    /**
+     * @brief Reads the referenced and exclusive sizes of the subvolumes in @p subvolumes when quotas are enabled
+     *
+     * The qgroup numbers are only updated when a transaction commits, so writes that are still pending aren't included.
+     */
+    virtual void readQgroups(const QString &mountpoint, SubvolumeMap &subvolumes) = 0;
+
+    /**
+     * @brief Reads the subvolume at @p path on the filesystem with @p uuid
+     */
+    virtual std::optional<Subvolume> readSubvolume(const QString &uuid, const QString &path) = 0;
+
+    /**
+     * @brief Reads every subvolume of a filesystem, including the top level subvolume, without the qgroup sizes
+     */
+    virtual SubvolumeMap readSubvolumes(const QString &uuid, const QString &mountpoint) = 0;
+
+    /**
+     * @brief Reads the progress of the scrub on the filesystem mounted at @p mountpoint, summed over all its devices
+     * @return The progress in bytes with isRunning set to false when no device is being scrubbed
+     */
+    virtual BtrfsProgress readScrubProgress(const QString &mountpoint) = 0;
+
+    /**
+     * @brief Reads the space accounting of a filesystem
+     * @return A BtrfsFilesystem with only the size related fields populated
+     */
+    virtual BtrfsFilesystem readUsage(const QString &uuid, const QString &mountpoint) = 0;
+
+    /**
+     * @brief Renames the subvolume at @p source to @p target, an empty directory at @p target is replaced
+     */
+    virtual bool renameSubvolume(const QString &source, const QString &target) = 0;
+
+    /**
+     * @brief Generates the send stream of the read-only subvolume at @p childPath relative to the one at @p parentPath
+     * @param flags - The BTRFS_SEND_FLAG_* values to send with
+     * @param consumer - Called with each chunk of the stream as it is read, the whole stream is always read
+     * @return 0 on success or the errno of the failure
+     */
+    virtual int send(const QString &parentPath, const QString &childPath, uint64_t flags,
+                     const std::function<void(const char *, qsizetype)> &consumer) = 0;
+
+    /**
+     * @brief Sets the read-only flag of the subvolume at @p path
+     */
+    virtual bool setSubvolumeReadOnly(const QString &path, bool readOnly) = 0;
+
+    /**
+     * @brief Returns the id of the subvolume at @p path or 0 if it isn't a subvolume
+     */
+    virtual uint64_t subvolumeId(const QString &path) = 0;
+};
+
+/**
+ * @brief The BtrfsUtilBackend class works on the mounted filesystems using libbtrfsutil and the btrfs ioctls.
+ *
+ * The top level subvolumes it mounts are unmounted again when it is destroyed.
+ */
+class BtrfsUtilBackend : public BtrfsBackend {
+  public:
+    ~BtrfsUtilBackend() override;
+
+    btrfs_util_error createSnapshot(const QString &source, const QString &dest, bool readOnly) override;
+    btrfs_util_error deleteSubvolume(const QString &path) override;
+    QString findAnyMountpoint(const QString &uuid) override;
+    QStringList listFilesystems() override;
+    QString mountRoot(const QString &uuid) override;
+    BtrfsProgress readBalanceProgress(const QString &mountpoint) override;
+    int readChangedInodes(const QString &mountpoint, uint64_t subvolId, uint64_t generation, QVector<ChangedInode> &inodes) override;
+    SubvolumeMap readChangedSubvolumes(const QString &uuid, const QString &mountpoint, const SubvolumeMap &previous) override;
+    void readQgroups(const QString &mountpoint, SubvolumeMap &subvolumes) override;
+    BtrfsProgress readScrubProgress(const QString &mountpoint) override;
+    std::optional<Subvolume> readSubvolume(const QString &uuid, const QString &path) override;
+    SubvolumeMap readSubvolumes(const QString &uuid, const QString &mountpoint) override;
+    BtrfsFilesystem readUsage(const QString &uuid, const QString &mountpoint) override;
+    bool renameSubvolume(const QString &source, const QString &target) override;
+    int send(const QString &parentPath, const QString &childPath, uint64_t flags,
+             const std::function<void(const char *, qsizetype)> &consumer) override;
+    bool setSubvolumeReadOnly(const QString &path, bool readOnly) override;
+    uint64_t subvolumeId(const QString &path) override;
+
+    /**
+     * @brief Reads a single value from a sysfs attribute file
+     * @param path - The absolute path to the attribute
+     * @return The trimmed contents of the file or an empty string if it couldn't be read
+     */
+    static QString readSysfsValue(const QString &path);
+
+    /**
+     * @brief Visits every item in the key range described by @p key using BTRFS_IOC_TREE_SEARCH_V2
+     * @param fd - An open file descriptor anywhere on the filesystem to search
+     * @param key - The tree and the range of keys and transids to search
+     * @param callback - Called with the header and data of each item, returning false stops the search
+     * @return false if the ioctl failed, for example because the tree doesn't exist, true otherwise
+     */
+    static bool treeSearch(int fd, const struct btrfs_ioctl_search_key &key,
+                           const std::function<bool(const struct btrfs_ioctl_search_header &, const char *)> &callback);
+
+  private:
+    // The mountpoints created by mountRoot()
+    QVector<QString> m_tempMountpoints;
+};
+
+#endif // BTRFSBACKEND_H
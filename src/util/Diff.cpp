@@ -0,0 +1,466 @@
+#include "util/Diff.h"
+#include "util/Tracer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Like git, a file is treated as binary when there is a NUL byte in this many bytes at its start
+constexpr qint64 BINARY_CHECK_SIZE = 8000;
+
+// The number of search steps between polls of the cancellation callback
+constexpr qsizetype CANCEL_CHECK_INTERVAL = 256;
+
+// The least number of search steps before a range is considered too expensive to compare exactly, the same as GNU diff
+constexpr qsizetype MIN_TOO_EXPENSIVE = 4096;
+
+struct Split {
+    qsizetype x = 0;
+    qsizetype y = 0;
+};
+
+/**
+ * @brief Marks the elements of two sequences that are not part of a longest common subsequence of both
+ *
+ * This is the linear space variant of Myers' algorithm as used by GNU diff: the middle snake of a range is found by searching
+ * forward and backward at the same time and both halves are then compared separately.  The ranges still to be compared are kept
+ * on a stack instead of recursing so very long inputs can't exhaust the call stack.
+ */
+class EditScript {
+  public:
+    EditScript(const int *a, qsizetype n, const int *b, qsizetype m, const std::function<bool()> &isCanceled)
+        : m_a(a), m_b(b), m_n(n), m_m(m), m_isCanceledCallback(isCanceled),
+          m_fd(static_cast<size_t>(n + m + 3)), m_bd(static_cast<size_t>(n + m + 3))
+    {
+        qsizetype tooExpensive = 1;
+        for (qsizetype diagonals = n + m + 3; diagonals != 0; diagonals >>= 2) {
+            tooExpensive <<= 1;
+        }
+        m_tooExpensive = std::max(MIN_TOO_EXPENSIVE, tooExpensive);
+    }
+
+    /**
+     * @brief Sets the elements of @p aChanged and @p bChanged that are not in the common subsequence to true
+     * @return false if the comparison was canceled
+     */
+    bool run(bool *aChanged, bool *bChanged)
+    {
+        struct Range {
+            qsizetype xoff, xlim, yoff, ylim;
+        };
+
+        QVector<Range> stack = {{0, m_n, 0, m_m}};
+        while (!stack.isEmpty() && !m_isCanceled) {
+            Range range = stack.takeLast();
+
+            // The lines at both ends of the range that match don't need to be searched
+            while (range.xoff < range.xlim && range.yoff < range.ylim && m_a[range.xoff] == m_b[range.yoff]) {
+                ++range.xoff;
+                ++range.yoff;
+            }
+            while (range.xoff < range.xlim && range.yoff < range.ylim && m_a[range.xlim - 1] == m_b[range.ylim - 1]) {
+                --range.xlim;
+                --range.ylim;
+            }
+
+            if (range.xoff == range.xlim) {
+                std::fill(bChanged + range.yoff, bChanged + range.ylim, true);
+            } else if (range.yoff == range.ylim) {
+                std::fill(aChanged + range.xoff, aChanged + range.xlim, true);
+            } else {
+                const Split split = findSplit(range.xoff, range.xlim, range.yoff, range.ylim);
+                stack.append({split.x, range.xlim, split.y, range.ylim});
+                stack.append({range.xoff, split.x, range.yoff, split.y});
+            }
+        }
+
+        return !m_isCanceled;
+    }
+
+  private:
+    /**
+     * @brief Returns the point where the shortest edit script of the range crosses its middle, or a point close to the ends of the
+     * furthest reaching paths when finding it would be too expensive
+     */
+    Split findSplit(qsizetype xoff, qsizetype xlim, qsizetype yoff, qsizetype ylim)
+    {
+        // The furthest x reached on each diagonal, x - y, going forward and backward
+        qsizetype *const fd = m_fd.data() + m_m + 1;
+        qsizetype *const bd = m_bd.data() + m_m + 1;
+
+        const qsizetype dmin = xoff - ylim;
+        const qsizetype dmax = xlim - yoff;
+        const qsizetype fmid = xoff - yoff;
+        const qsizetype bmid = xlim - ylim;
+        qsizetype fmin = fmid;
+        qsizetype fmax = fmid;
+        qsizetype bmin = bmid;
+        qsizetype bmax = bmid;
+        const bool isOdd = ((fmid - bmid) & 1) != 0;
+
+        fd[fmid] = xoff;
+        bd[bmid] = xlim;
+
+        for (qsizetype cost = 1;; ++cost) {
+            // Extend the forward search by one edit
+            if (fmin > dmin) {
+                fd[--fmin - 1] = -1;
+            } else {
+                ++fmin;
+            }
+            if (fmax < dmax) {
+                fd[++fmax + 1] = -1;
+            } else {
+                --fmax;
+            }
+            for (qsizetype d = fmax; d >= fmin; d -= 2) {
+                const qsizetype tlo = fd[d - 1];
+                const qsizetype thi = fd[d + 1];
+                qsizetype x = tlo >= thi ? tlo + 1 : thi;
+                qsizetype y = x - d;
+                while (x < xlim && y < ylim && m_a[x] == m_b[y]) {
+                    ++x;
+                    ++y;
+                }
+                fd[d] = x;
+                if (isOdd && bmin <= d && d <= bmax && bd[d] <= x) {
+                    return {x, y};
+                }
+            }
+
+            // Extend the backward search by one edit
+            if (bmin > dmin) {
+                bd[--bmin - 1] = std::numeric_limits<qsizetype>::max();
+            } else {
+                ++bmin;
+            }
+            if (bmax < dmax) {
+                bd[++bmax + 1] = std::numeric_limits<qsizetype>::max();
+            } else {
+                --bmax;
+            }
+            for (qsizetype d = bmax; d >= bmin; d -= 2) {
+                const qsizetype tlo = bd[d - 1];
+                const qsizetype thi = bd[d + 1];
+                qsizetype x = tlo < thi ? tlo : thi - 1;
+                qsizetype y = x - d;
+                while (xoff < x && yoff < y && m_a[x - 1] == m_b[y - 1]) {
+                    --x;
+                    --y;
+                }
+                bd[d] = x;
+                if (!isOdd && fmin <= d && d <= fmax && x <= fd[d]) {
+                    return {x, y};
+                }
+            }
+
+            if (cost % CANCEL_CHECK_INTERVAL == 0 && m_isCanceledCallback && m_isCanceledCallback()) {
+                m_isCanceled = true;
+            }
+            if (cost < m_tooExpensive && !m_isCanceled) {
+                continue;
+            }
+
+            // Give up on the optimal split and use whichever of the forward and backward paths got further
+            qsizetype forwardBest = -1;
+            qsizetype forwardBestX = xoff;
+            for (qsizetype d = fmax; d >= fmin; d -= 2) {
+                qsizetype x = std::min(fd[d], xlim);
+                qsizetype y = x - d;
+                if (ylim < y) {
+                    x = ylim + d;
+                    y = ylim;
+                }
+                if (forwardBest < x + y) {
+                    forwardBest = x + y;
+                    forwardBestX = x;
+                }
+            }
+
+            qsizetype backwardBest = std::numeric_limits<qsizetype>::max();
+            qsizetype backwardBestX = xlim;
+            for (qsizetype d = bmax; d >= bmin; d -= 2) {
+                qsizetype x = std::max(xoff, bd[d]);
+                qsizetype y = x - d;
+                if (y < yoff) {
+                    x = yoff + d;
+                    y = yoff;
+                }
+                if (x + y < backwardBest) {
+                    backwardBest = x + y;
+                    backwardBestX = x;
+                }
+            }
+
+            if ((xlim + ylim) - backwardBest < forwardBest - (xoff + yoff)) {
+                return {forwardBestX, forwardBest - forwardBestX};
+            }
+            return {backwardBestX, backwardBest - backwardBestX};
+        }
+    }
+
+    const int *m_a;
+    const int *m_b;
+    const qsizetype m_n;
+    const qsizetype m_m;
+    const std::function<bool()> &m_isCanceledCallback;
+    bool m_isCanceled = false;
+    qsizetype m_tooExpensive = MIN_TOO_EXPENSIVE;
+    std::vector<qsizetype> m_fd;
+    std::vector<qsizetype> m_bd;
+};
+
+// A run of removed and added lines between two unchanged ones, the ends are exclusive
+struct Change {
+    qsizetype oldStart = 0;
+    qsizetype oldEnd = 0;
+    qsizetype newStart = 0;
+    qsizetype newEnd = 0;
+};
+
+} // namespace
+
+bool DiffText::open(const QString &path, Access access)
+{
+    m_path = path;
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    if (access == Access::Copy) {
+        // Read until the end rather than up to the size seen at open so a file that changes in between is still read whole
+        m_copy = m_file.readAll();
+        if (m_file.error() != QFileDevice::NoError) {
+            return false;
+        }
+        m_file.close();
+        m_data = m_copy.constData();
+        m_size = m_copy.size();
+    } else {
+        m_size = m_file.size();
+        if (m_size > 0) {
+            m_data = reinterpret_cast<const char *>(m_file.map(0, m_size));
+            if (m_data == nullptr) {
+                return false;
+            }
+        }
+    }
+
+    // Like diff, a final line without a line break still counts as a line
+    for (qint64 start = 0; start < m_size;) {
+        m_lineStarts.append(start);
+        const void *end = std::memchr(m_data + start, '\n', static_cast<size_t>(m_size - start));
+        start = end == nullptr ? m_size : static_cast<const char *>(end) - m_data + 1;
+    }
+
+    return true;
+}
+
+bool DiffText::isBinary() const
+{
+    return m_size > 0 && std::memchr(m_data, '\0', static_cast<size_t>(std::min(m_size, BINARY_CHECK_SIZE))) != nullptr;
+}
+
+bool DiffText::hasSameContents(const DiffText &other) const
+{
+    return m_size == other.m_size && (m_size == 0 || std::memcmp(m_data, other.m_data, static_cast<size_t>(m_size)) == 0);
+}
+
+QByteArrayView DiffText::line(qsizetype index) const
+{
+    const qint64 start = m_lineStarts.at(index);
+    qint64 end = index + 1 < m_lineStarts.count() ? m_lineStarts.at(index + 1) : m_size;
+    if (end > start && m_data[end - 1] == '\n') {
+        --end;
+    }
+
+    return QByteArrayView(m_data + start, end - start);
+}
+
+DiffResult Diff::compare(const QString &oldPath, const QString &newPath, DiffText::Access oldAccess, DiffText::Access newAccess,
+                         const std::function<bool()> &isCanceled)
+{
+    TraceSpan span(QStringLiteral("Diff::compare"));
+
+    DiffResult result;
+
+    auto oldText = std::make_shared<DiffText>();
+    auto newText = std::make_shared<DiffText>();
+    if (!oldText->open(oldPath, oldAccess)) {
+        result.error = tr("Failed to read %1: %2").arg(oldPath, oldText->errorString());
+        return result;
+    }
+    if (!newText->open(newPath, newAccess)) {
+        result.error = tr("Failed to read %1: %2").arg(newPath, newText->errorString());
+        return result;
+    }
+    result.oldText = oldText;
+    result.newText = newText;
+
+    // Like diff, binary files are only compared as a whole
+    if (oldText->isBinary() || newText->isBinary()) {
+        result.isBinary = !oldText->hasSameContents(*newText);
+        return result;
+    }
+
+    // Every distinct line is given a number so the lines are compared as integers from here on
+    const qsizetype n = oldText->lineCount();
+    const qsizetype m = newText->lineCount();
+    QVector<int> a;
+    QVector<int> b;
+    qsizetype distinctLines = 0;
+    {
+        std::unordered_map<std::string_view, int> lineNumbers;
+        lineNumbers.reserve(static_cast<size_t>(n + m));
+        const auto numberLines = [&lineNumbers](const DiffText &text) {
+            QVector<int> numbers(text.lineCount());
+            for (qsizetype i = 0; i < text.lineCount(); ++i) {
+                const QByteArrayView line = text.line(i);
+                const std::string_view key(line.data(), static_cast<size_t>(line.size()));
+                numbers[i] = lineNumbers.emplace(key, static_cast<int>(lineNumbers.size())).first->second;
+            }
+            return numbers;
+        };
+        a = numberLines(*oldText);
+        b = numberLines(*newText);
+        distinctLines = static_cast<qsizetype>(lineNumbers.size());
+    }
+
+    if (isCanceled && isCanceled()) {
+        return DiffResult();
+    }
+
+    // The common start and end are skipped before anything is allocated for the search, they are usually most of a file
+    qsizetype prefix = 0;
+    while (prefix < n && prefix < m && a.at(prefix) == b.at(prefix)) {
+        ++prefix;
+    }
+    qsizetype suffix = 0;
+    while (suffix < n - prefix && suffix < m - prefix && a.at(n - suffix - 1) == b.at(m - suffix - 1)) {
+        ++suffix;
+    }
+
+    // A line that only appears in one of the files can't be in common so it is marked right away, as GNU diff does.  Only the
+    // remaining lines are searched, which keeps the search short when most lines were replaced.
+    QVector<bool> inOld(distinctLines, false);
+    QVector<bool> inNew(distinctLines, false);
+    for (qsizetype i = prefix; i < n - suffix; ++i) {
+        inOld[a.at(i)] = true;
+    }
+    for (qsizetype j = prefix; j < m - suffix; ++j) {
+        inNew[b.at(j)] = true;
+    }
+
+    QVector<bool> oldChanged(n, false);
+    QVector<bool> newChanged(m, false);
+    QVector<int> oldSearched;
+    QVector<qsizetype> oldSearchedLines;
+    for (qsizetype i = prefix; i < n - suffix; ++i) {
+        if (inNew.at(a.at(i))) {
+            oldSearched.append(a.at(i));
+            oldSearchedLines.append(i);
+        } else {
+            oldChanged[i] = true;
+        }
+    }
+    QVector<int> newSearched;
+    QVector<qsizetype> newSearchedLines;
+    for (qsizetype j = prefix; j < m - suffix; ++j) {
+        if (inOld.at(b.at(j))) {
+            newSearched.append(b.at(j));
+            newSearchedLines.append(j);
+        } else {
+            newChanged[j] = true;
+        }
+    }
+
+    QVector<bool> oldSearchedChanged(oldSearched.count(), false);
+    QVector<bool> newSearchedChanged(newSearched.count(), false);
+    EditScript script(oldSearched.constData(), oldSearched.count(), newSearched.constData(), newSearched.count(), isCanceled);
+    if (!script.run(oldSearchedChanged.data(), newSearchedChanged.data())) {
+        return DiffResult();
+    }
+    for (qsizetype k = 0; k < oldSearched.count(); ++k) {
+        oldChanged[oldSearchedLines.at(k)] = oldSearchedChanged.at(k);
+    }
+    for (qsizetype k = 0; k < newSearched.count(); ++k) {
+        newChanged[newSearchedLines.at(k)] = newSearchedChanged.at(k);
+    }
+
+    // Collect the runs of changed lines, the unchanged lines between them pair up one to one
+    QVector<Change> changes;
+    for (qsizetype i = 0, j = 0; i < n || j < m;) {
+        if (i < n && j < m && !oldChanged.at(i) && !newChanged.at(j)) {
+            ++i;
+            ++j;
+            continue;
+        }
+
+        Change change{i, i, j, j};
+        while (i < n && oldChanged.at(i)) {
+            ++i;
+        }
+        while (j < m && newChanged.at(j)) {
+            ++j;
+        }
+        if (i == change.oldStart && j == change.newStart) {
+            break;
+        }
+        change.oldEnd = i;
+        change.newEnd = j;
+        changes.append(change);
+    }
+
+    if (changes.isEmpty()) {
+        return result;
+    }
+
+    result.lines.append({DiffLine::OldFile, 0});
+    result.lines.append({DiffLine::NewFile, 0});
+
+    // Changes that are close enough for their context to touch are shown in the same hunk
+    for (qsizetype first = 0; first < changes.count();) {
+        qsizetype last = first;
+        while (last + 1 < changes.count() && changes.at(last + 1).oldStart - changes.at(last).oldEnd <= 2 * CONTEXT_LINES) {
+            ++last;
+        }
+
+        const qsizetype leading = std::min(CONTEXT_LINES, changes.at(first).oldStart);
+        const qsizetype trailing = std::min(CONTEXT_LINES, n - changes.at(last).oldEnd);
+
+        DiffHunk hunk;
+        hunk.oldStart = changes.at(first).oldStart - leading;
+        hunk.oldCount = changes.at(last).oldEnd + trailing - hunk.oldStart;
+        hunk.newStart = changes.at(first).newStart - leading;
+        hunk.newCount = changes.at(last).newEnd + trailing - hunk.newStart;
+        result.lines.append({DiffLine::Hunk, result.hunks.count()});
+        result.hunks.append(hunk);
+
+        qsizetype oldLine = hunk.oldStart;
+        for (qsizetype k = first; k <= last; ++k) {
+            const Change &change = changes.at(k);
+            for (; oldLine < change.oldStart; ++oldLine) {
+                result.lines.append({DiffLine::Context, oldLine});
+            }
+            for (; oldLine < change.oldEnd; ++oldLine) {
+                result.lines.append({DiffLine::Removed, oldLine});
+            }
+            for (qsizetype newLine = change.newStart; newLine < change.newEnd; ++newLine) {
+                result.lines.append({DiffLine::Added, newLine});
+            }
+        }
+        for (; oldLine < hunk.oldStart + hunk.oldCount; ++oldLine) {
+            result.lines.append({DiffLine::Context, oldLine});
+        }
+
+        first = last + 1;
+    }
+
+    return result;
+}
@@ -0,0 +1,120 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <QByteArrayView>
+#include <QCoreApplication>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+#include <memory>
+
+/**
+ * @brief The lines of a file that stays memory-mapped, or is copied into memory, for as long as the instance exists
+ */
+class DiffText {
+  public:
+    // A mapped file that shrinks while it is shown raises SIGBUS on the next read past its new end, so only files that can't
+    // change, such as the ones in a read-only snapshot, are mapped
+    enum class Access { Map, Copy };
+
+    /**
+     * @brief Maps or copies the file at @p path depending on @p access and finds the start of each line
+     * @return true on success, false if the file couldn't be read
+     */
+    bool open(const QString &path, Access access);
+
+    /**
+     * @brief Returns why the file couldn't be read
+     */
+    QString errorString() const { return m_file.errorString(); }
+
+    /**
+     * @brief Returns true if the start of the file contains a NUL byte, which diff treats as binary
+     */
+    bool isBinary() const;
+
+    /**
+     * @brief Returns true if the file has exactly the same bytes as @p other
+     */
+    bool hasSameContents(const DiffText &other) const;
+
+    /**
+     * @brief Returns the line at @p index without its line break
+     */
+    QByteArrayView line(qsizetype index) const;
+
+    qsizetype lineCount() const { return m_lineStarts.count(); }
+
+    const QString &path() const { return m_path; }
+
+  private:
+    QFile m_file;
+    QString m_path;
+    QByteArray m_copy;
+    const char *m_data = nullptr;
+    qint64 m_size = 0;
+    // The offset of the first byte of each line
+    QVector<qint64> m_lineStarts;
+};
+
+// A range of lines that is shown together with the lines around the changes in it, the starts are 0 based
+struct DiffHunk {
+    qsizetype oldStart = 0;
+    qsizetype oldCount = 0;
+    qsizetype newStart = 0;
+    qsizetype newCount = 0;
+};
+
+struct DiffLine {
+    enum Type : uint8_t { OldFile, NewFile, Hunk, Context, Removed, Added };
+
+    Type type = Context;
+    // The line in the old file for Context and Removed lines, in the new file for Added lines or the hunk for Hunk lines
+    qsizetype index = 0;
+};
+
+// The result of comparing two files, the text of the lines is read from the mapped or copied files when it is shown
+struct DiffResult {
+    // Set when either file couldn't be read, nothing else is filled in then
+    QString error;
+    // Set when the files differ and at least one of them is binary, no lines are filled in then
+    bool isBinary = false;
+    std::shared_ptr<const DiffText> oldText;
+    std::shared_ptr<const DiffText> newText;
+    QVector<DiffHunk> hunks;
+    // The lines in unified diff order, empty when the files are the same
+    QVector<DiffLine> lines;
+
+    /** @brief Returns true if the files could be compared and don't differ */
+    bool isIdentical() const { return error.isEmpty() && !isBinary && lines.isEmpty(); }
+};
+
+/**
+ * @brief The Diff class compares files line by line without running the diff command.
+ *
+ * Both files are memory-mapped or copied into memory and each distinct line is replaced by a number, then the shortest edit script
+ * between the two sequences is found with Myers' algorithm in linear space.  Like GNU diff, lines that only appear in one file are
+ * left out of the search and the search gives up on an optimal result for a range once it becomes too expensive, so very different
+ * inputs still finish in reasonable time.
+ */
+class Diff {
+    Q_DECLARE_TR_FUNCTIONS(Diff)
+
+  public:
+    // The number of unchanged lines shown around each change, the same as diff -u
+    static constexpr qsizetype CONTEXT_LINES = 3;
+
+    /**
+     * @brief Compares the file at @p oldPath with the one at @p newPath
+     * @param oldAccess - How the old file is read, only a file that can't change while the result is shown may be mapped
+     * @param newAccess - How the new file is read, likewise
+     * @param isCanceled - Polled while comparing, the comparison stops early with an empty result once it returns true
+     * @return The changes grouped into hunks as diff -u would show them
+     */
+    static DiffResult compare(const QString &oldPath, const QString &newPath, DiffText::Access oldAccess, DiffText::Access newAccess,
+                              const std::function<bool()> &isCanceled = {});
+};
+
+#endif // DIFF_H
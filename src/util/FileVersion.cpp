@@ -0,0 +1,111 @@
+#include "util/FileVersion.h"
+
+#include <QFile>
+
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// The number of extents asked for in each FIEMAP call
+constexpr quint32 EXTENT_BATCH = 64;
+
+// Inline extents only hold a fraction of a page, anything larger is not read to compare it
+constexpr qint64 MAX_INLINE_SIZE = 64 * 1024;
+
+} // namespace
+
+FileVersion FileVersion::read(const QString &path)
+{
+    FileVersion version;
+
+    // Checking the type first keeps special files such as FIFOs from ever being opened
+    struct statx stx;
+    const QByteArray name = QFile::encodeName(path);
+    if (statx(AT_FDCWD, name.constData(), AT_STATX_DONT_SYNC, STATX_TYPE | STATX_SIZE | STATX_MTIME, &stx) != 0 ||
+        !S_ISREG(stx.stx_mode)) {
+        return version;
+    }
+
+    version.m_exists = true;
+    version.m_size = static_cast<qint64>(stx.stx_size);
+    version.m_modified = static_cast<qint64>(stx.stx_mtime.tv_sec) * 1000000000 + stx.stx_mtime.tv_nsec;
+
+    const int fd = open(name.constData(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0) {
+        return version;
+    }
+
+    // The header is followed by room for a batch of extents, uint64_t keeps both suitably aligned
+    std::vector<uint64_t> buffer((sizeof(fiemap) + EXTENT_BATCH * sizeof(fiemap_extent)) / sizeof(uint64_t) + 1);
+    auto *map = reinterpret_cast<fiemap *>(buffer.data());
+
+    bool isComparable = true;
+    bool hasInline = false;
+    bool isLast = false;
+    quint64 start = 0;
+    while (isComparable && !isLast) {
+        std::memset(map, 0, buffer.size() * sizeof(uint64_t));
+        map->fm_start = start;
+        map->fm_length = FIEMAP_MAX_OFFSET - start;
+        map->fm_extent_count = EXTENT_BATCH;
+
+        if (ioctl(fd, FS_IOC_FIEMAP, map) != 0) {
+            isComparable = false;
+            break;
+        }
+
+        // No more extents after start, the rest of the file is a hole
+        if (map->fm_mapped_extents == 0) {
+            break;
+        }
+
+        for (quint32 i = 0; i < map->fm_mapped_extents; ++i) {
+            const fiemap_extent &extent = map->fm_extents[i];
+
+            // Data that hasn't been written out yet has no location to compare
+            if ((extent.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC)) != 0) {
+                isComparable = false;
+                break;
+            }
+
+            hasInline = hasInline || (extent.fe_flags & FIEMAP_EXTENT_DATA_INLINE) != 0;
+
+            // Whether an extent is shared depends on how many snapshots still reference it, not on the data
+            version.m_extents.append({extent.fe_logical, extent.fe_physical, extent.fe_length,
+                                      extent.fe_flags & ~static_cast<quint32>(FIEMAP_EXTENT_SHARED)});
+
+            start = extent.fe_logical + extent.fe_length;
+            isLast = (extent.fe_flags & FIEMAP_EXTENT_LAST) != 0;
+        }
+    }
+
+    // An inline extent has no location of its own, the few bytes it holds are compared directly
+    if (isComparable && hasInline) {
+        if (version.m_size > MAX_INLINE_SIZE) {
+            isComparable = false;
+        } else {
+            version.m_inlineData.resize(version.m_size);
+            const ssize_t bytesRead = pread(fd, version.m_inlineData.data(), static_cast<size_t>(version.m_size), 0);
+            isComparable = bytesRead == version.m_size;
+        }
+    }
+
+    close(fd);
+
+    version.m_isComparable = isComparable;
+    return version;
+}
+
+bool FileVersion::isSameAs(const FileVersion &other) const
+{
+    return m_isComparable && other.m_isComparable && m_size == other.m_size && m_modified == other.m_modified &&
+           m_extents == other.m_extents && m_inlineData == other.m_inlineData;
+}
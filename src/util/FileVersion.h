@@ -0,0 +1,57 @@
+#ifndef FILEVERSION_H
+#define FILEVERSION_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// A range of a file and where its data is stored on the device, as reported by FIEMAP
+struct FileExtent {
+    quint64 logical = 0;
+    quint64 physical = 0;
+    quint64 length = 0;
+    quint32 flags = 0;
+
+    bool operator==(const FileExtent &other) const
+    {
+        return logical == other.logical && physical == other.physical && length == other.length && flags == other.flags;
+    }
+};
+
+/**
+ * @brief The FileVersion class tells whether copies of a file in different snapshots hold the same data without reading them.
+ *
+ * Snapshots share the extents of every file that didn't change between them, so two copies with the same size, modification time
+ * and extent map are the same version.  Files small enough to be stored inline in the metadata have no extent of their own, their
+ * few bytes are compared instead.
+ */
+class FileVersion {
+  public:
+    /**
+     * @brief Reads the size, the modification time and the extents of the file at @p path, symlinks are followed
+     */
+    static FileVersion read(const QString &path);
+
+    /**
+     * @brief Returns true if @p path is a regular file
+     */
+    bool exists() const { return m_exists; }
+
+    /**
+     * @brief Returns true if both files are known to hold the same data, false if they differ or either extent map was unusable
+     */
+    bool isSameAs(const FileVersion &other) const;
+
+  private:
+    bool m_exists = false;
+    // False when the extents couldn't be read or include ranges whose location isn't known yet
+    bool m_isComparable = false;
+    qint64 m_size = 0;
+    // The modification time in nanoseconds since the epoch
+    qint64 m_modified = 0;
+    QVector<FileExtent> m_extents;
+    // The contents of a file with an inline extent
+    QByteArray m_inlineData;
+};
+
+#endif // FILEVERSION_H
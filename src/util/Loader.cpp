@@ -0,0 +1,110 @@
+#include "util/Loader.h"
+#include "util/MetadataCache.h"
+#include "util/Tracer.h"
+
+Loader::Loader(const QString &snapperCommand, QObject *parent) : QObject(parent), m_snapperCommand(snapperCommand)
+{
+    m_worker = new QObject;
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    m_thread.setObjectName(QStringLiteral("Loader"));
+    m_thread.start();
+}
+
+Loader::~Loader()
+{
+    // Skip whatever is still queued, the worker instances are destroyed on their own thread once the running load is done
+    ++m_serial;
+    QMetaObject::invokeMethod(
+        m_worker,
+        [this]() {
+            m_snapper.reset();
+            m_btrfs.reset();
+        },
+        Qt::BlockingQueuedConnection);
+
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void Loader::reload(bool includeSnapper)
+{
+    m_isSnapperPending = m_isSnapperPending || includeSnapper;
+    m_isLoading = true;
+
+    const quint64 serial = ++m_serial;
+    const bool withSnapper = m_isSnapperPending && !m_snapperCommand.isEmpty();
+    QMetaObject::invokeMethod(m_worker, [this, serial, withSnapper]() { run(serial, withSnapper); }, Qt::QueuedConnection);
+}
+
+void Loader::run(quint64 serial, bool includeSnapper)
+{
+    // A newer request is queued behind this one and covers everything this one would load
+    if (serial != m_serial) {
+        return;
+    }
+
+    TraceSpan span(QStringLiteral("Loader::run"));
+
+    QMap<QString, BtrfsFilesystem> cached;
+    if (m_btrfs == nullptr) {
+        // The saved subvolumes are shown right away and then checked against the disk, which can take a while on a large list
+        cached = MetadataCache::readFilesystems();
+        if (!cached.isEmpty()) {
+            QMetaObject::invokeMethod(
+                this,
+                [this, serial, cached]() {
+                    if (serial == m_serial) {
+                        emit subvolumesCached(cached);
+                    }
+                },
+                Qt::QueuedConnection);
+        }
+
+        m_btrfs = std::make_unique<Btrfs>(InitialLoad::Later);
+    }
+
+    // Only what was actually read is handed over, a filesystem that couldn't be read keeps what the GUI already has
+    const QStringList loaded = m_btrfs->loadVolumes(cached);
+    QMap<QString, BtrfsFilesystem> filesystems;
+    for (const QString &uuid : loaded) {
+        filesystems.insert(uuid, m_btrfs->filesystems().value(uuid));
+    }
+    QMetaObject::invokeMethod(
+        this,
+        [this, serial, filesystems]() {
+            if (serial == m_serial) {
+                emit btrfsLoaded(filesystems);
+            }
+        },
+        Qt::QueuedConnection);
+
+    if (includeSnapper && serial == m_serial) {
+        if (m_snapper == nullptr) {
+            m_snapper = std::make_unique<Snapper>(m_btrfs.get(), m_snapperCommand);
+        } else {
+            m_snapper->load();
+        }
+
+        const Snapper::LoadedData data = m_snapper->loadedData();
+        QMetaObject::invokeMethod(
+            this,
+            [this, serial, data]() {
+                if (serial == m_serial) {
+                    emit snapperLoaded(data);
+                }
+            },
+            Qt::QueuedConnection);
+    }
+
+    QMetaObject::invokeMethod(
+        this,
+        [this, serial]() {
+            if (serial == m_serial) {
+                m_isLoading = false;
+                m_isSnapperPending = false;
+                emit finished();
+            }
+        },
+        Qt::QueuedConnection);
+}
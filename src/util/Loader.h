@@ -0,0 +1,100 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "util/Btrfs.h"
+#include "util/Snapper.h"
+
+#include <QMap>
+#include <QObject>
+#include <QThread>
+
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief The Loader class reads the btrfs filesystems and the snapper data on a worker thread.
+ *
+ * The worker keeps a Btrfs and a Snapper instance of its own so the instances used by the UI are never touched off the GUI thread,
+ * the results are handed over as copies through the signals.  A request that is still queued when a newer one comes in is skipped
+ * and the results of one that was overtaken while running are dropped, so only the latest data reaches the UI.
+ */
+class Loader : public QObject {
+    Q_OBJECT
+
+  public:
+    /**
+     * @param snapperCommand - The absolute path to the snapper command or an empty string when snapper isn't installed
+     */
+    explicit Loader(const QString &snapperCommand, QObject *parent = nullptr);
+    ~Loader();
+
+    /**
+     * @brief Returns true from the time a load is requested until the results of the latest request are in
+     */
+    bool isLoading() const { return m_isLoading; }
+
+    /**
+     * @brief Reloads the btrfs filesystems
+     */
+    void reloadBtrfs() { reload(false); }
+
+    /**
+     * @brief Reloads the btrfs filesystems and then the snapper data, which depends on them
+     */
+    void reloadAll() { reload(true); }
+
+  signals:
+    /**
+     * @brief Emitted on the GUI thread before the first load with the subvolumes saved by the previous run
+     *
+     * Only the subvolumes are set in @p filesystems.  They haven't been checked against the disk yet, btrfsLoaded() follows with
+     * the current data.
+     */
+    void subvolumesCached(const QMap<QString, BtrfsFilesystem> &filesystems);
+
+    /**
+     * @brief Emitted on the GUI thread with the filesystems as soon as they have been read
+     *
+     * Only the filesystems that were read are in @p filesystems, one that couldn't be read is left out rather than emptied.
+     */
+    void btrfsLoaded(const QMap<QString, BtrfsFilesystem> &filesystems);
+
+    /**
+     * @brief Emitted on the GUI thread with the snapper data after btrfsLoaded() when it was requested
+     */
+    void snapperLoaded(const Snapper::LoadedData &data);
+
+    /**
+     * @brief Emitted on the GUI thread once everything requested so far has been loaded
+     */
+    void finished();
+
+  private:
+    /**
+     * @brief Queues a load on the worker thread, the snapper data is included if @p includeSnapper is true or a pending request
+     * included it
+     */
+    void reload(bool includeSnapper);
+
+    /**
+     * @brief Runs the load identified by @p serial on the worker thread
+     */
+    void run(quint64 serial, bool includeSnapper);
+
+    const QString m_snapperCommand;
+    QThread m_thread;
+    // Lives on the worker thread, the loads are queued on it
+    QObject *m_worker = nullptr;
+
+    // Only used on the worker thread, created by the first load
+    std::unique_ptr<Btrfs> m_btrfs;
+    std::unique_ptr<Snapper> m_snapper;
+
+    // Identifies the latest request, read by the worker to skip requests that have been overtaken
+    std::atomic<quint64> m_serial{0};
+    bool m_isLoading = false;
+    // Whether the snapper data was requested since the last load finished
+    bool m_isSnapperPending = false;
+};
+
+#endif // LOADER_H
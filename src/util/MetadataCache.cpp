@@ -0,0 +1,217 @@
+#include "util/MetadataCache.h"
+#include "util/Settings.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+#include <functional>
+
+namespace {
+
+constexpr const char *CACHE_DIR = "/var/cache/btrfs-assistant";
+constexpr const char *FILESYSTEMS_FILE = "subvolumes.cache";
+constexpr const char *SNAPPER_FILE = "snapper.cache";
+
+// "BAMC" followed by the version of the layout below, bump the version whenever the layout changes
+constexpr quint32 CACHE_MAGIC = 0x42414d43;
+constexpr quint16 CACHE_VERSION = 2;
+
+// The least a stored Subvolume can take up: the seven 64 bit numbers, the length of an empty name and the three UUIDs
+constexpr qint64 MIN_SUBVOLUME_BYTES = 7 * 8 + 4 + 3 * 16;
+
+// Set by MetadataCache::disable(), the cache is only used at startup and exit so this doesn't need to be atomic
+bool isDisabled = false;
+
+/**
+ * @brief Opens the cache file @p name and checks its header
+ * @return true if @p file is open and positioned after a header that matches the current format
+ */
+bool openForRead(QFile &file, QDataStream &stream, const QString &name)
+{
+    file.setFileName(QDir(CACHE_DIR).filePath(name));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    stream.setDevice(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    return stream.status() == QDataStream::Ok && magic == CACHE_MAGIC && version == CACHE_VERSION;
+}
+
+/**
+ * @brief Writes the cache file @p name, @p write is called to add the data after the header
+ * @return true if the file was completely written and replaced the old one
+ */
+bool writeFile(const QString &name, const std::function<void(QDataStream &)> &write)
+{
+    if (!MetadataCache::isEnabled() || !QDir().mkpath(CACHE_DIR)) {
+        return false;
+    }
+
+    // QSaveFile only replaces the old file once everything has been written
+    QSaveFile file(QDir(CACHE_DIR).filePath(name));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << CACHE_MAGIC << CACHE_VERSION;
+    write(stream);
+
+    if (stream.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+
+    return file.commit();
+}
+
+} // namespace
+
+// The streaming operators are outside of the anonymous namespace so the QHash operators can find them
+
+QDataStream &operator<<(QDataStream &stream, const Subvolume &subvol)
+{
+    stream << static_cast<quint64>(subvol.id) << static_cast<quint64>(subvol.parentId) << static_cast<quint64>(subvol.dirId)
+           << subvol.subvolName << subvol.uuid
+           << subvol.parentUuid << subvol.receivedUuid << static_cast<quint64>(subvol.generation) << static_cast<quint64>(subvol.size)
+           << static_cast<quint64>(subvol.exclusive) << static_cast<quint64>(subvol.flags) << subvol.createdAt << subvol.kind;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, Subvolume &subvol)
+{
+    quint64 id = 0, parentId = 0, dirId = 0, generation = 0, size = 0, exclusive = 0, flags = 0;
+    stream >> id >> parentId >> dirId >> subvol.subvolName >> subvol.uuid >> subvol.parentUuid >> subvol.receivedUuid >> generation >>
+        size >> exclusive >> flags >> subvol.createdAt >> subvol.kind;
+    subvol.id = id;
+    subvol.parentId = parentId;
+    subvol.dirId = dirId;
+    subvol.generation = generation;
+    subvol.size = size;
+    subvol.exclusive = exclusive;
+    subvol.flags = flags;
+    return stream;
+}
+
+QDataStream &operator<<(QDataStream &stream, const SnapperMetaCacheEntry &entry)
+{
+    stream << entry.modified << entry.snapshot.number << entry.snapshot.time << entry.snapshot.desc << entry.snapshot.type
+           << entry.snapshot.cleanup;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, SnapperMetaCacheEntry &entry)
+{
+    stream >> entry.modified >> entry.snapshot.number >> entry.snapshot.time >> entry.snapshot.desc >> entry.snapshot.type >>
+        entry.snapshot.cleanup;
+    return stream;
+}
+
+void MetadataCache::disable() { isDisabled = true; }
+
+bool MetadataCache::isEnabled() { return !isDisabled && Settings::instance().value("metadata_cache", true).toBool(); }
+
+QMap<QString, BtrfsFilesystem> MetadataCache::readFilesystems()
+{
+    QMap<QString, BtrfsFilesystem> filesystems;
+
+    QFile file;
+    QDataStream stream;
+    if (!isEnabled() || !openForRead(file, stream, FILESYSTEMS_FILE)) {
+        return filesystems;
+    }
+
+    quint32 filesystemCount = 0;
+    stream >> filesystemCount;
+    for (quint32 i = 0; i < filesystemCount && stream.status() == QDataStream::Ok; ++i) {
+        QString uuid;
+        quint32 subvolCount = 0;
+        stream >> uuid >> subvolCount;
+
+        // A count that can't fit in the rest of the file is corrupt, it must not be trusted with an allocation
+        if (stream.status() != QDataStream::Ok || subvolCount > (file.size() - file.pos()) / MIN_SUBVOLUME_BYTES) {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+
+        QVector<Subvolume> subvols;
+        subvols.reserve(subvolCount);
+        for (quint32 j = 0; j < subvolCount && stream.status() == QDataStream::Ok; ++j) {
+            Subvolume subvol;
+            stream >> subvol;
+            // The filesystem UUID is the same for every subvolume so it isn't stored with each one
+            subvol.filesystemUuid = uuid;
+            subvols.append(subvol);
+        }
+
+        BtrfsFilesystem btrfs;
+        btrfs.subvolumes = SubvolumeMap(subvols);
+        filesystems.insert(uuid, btrfs);
+    }
+
+    // A truncated or corrupt file is thrown away as a whole
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Ignoring the corrupt cache file" << file.fileName();
+        return QMap<QString, BtrfsFilesystem>();
+    }
+
+    return filesystems;
+}
+
+QHash<QString, SnapperMetaCacheEntry> MetadataCache::readSnapperMeta()
+{
+    QHash<QString, SnapperMetaCacheEntry> metas;
+
+    QFile file;
+    QDataStream stream;
+    if (!isEnabled() || !openForRead(file, stream, SNAPPER_FILE)) {
+        return metas;
+    }
+
+    stream >> metas;
+
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Ignoring the corrupt cache file" << file.fileName();
+        return QHash<QString, SnapperMetaCacheEntry>();
+    }
+
+    return metas;
+}
+
+bool MetadataCache::writeFilesystems(const QMap<QString, BtrfsFilesystem> &filesystems)
+{
+    return writeFile(FILESYSTEMS_FILE, [&filesystems](QDataStream &stream) {
+        quint32 filesystemCount = 0;
+        for (const BtrfsFilesystem &btrfs : filesystems) {
+            if (btrfs.isPopulated) {
+                ++filesystemCount;
+            }
+        }
+
+        stream << filesystemCount;
+        for (auto it = filesystems.cbegin(); it != filesystems.cend(); ++it) {
+            if (!it->isPopulated) {
+                continue;
+            }
+
+            stream << it.key() << static_cast<quint32>(it->subvolumes.count());
+            for (const Subvolume &subvol : it->subvolumes) {
+                stream << subvol;
+            }
+        }
+    });
+}
+
+bool MetadataCache::writeSnapperMeta(const QHash<QString, SnapperMetaCacheEntry> &metas)
+{
+    return writeFile(SNAPPER_FILE, [&metas](QDataStream &stream) { stream << metas; });
+}
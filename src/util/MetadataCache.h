@@ -0,0 +1,55 @@
+#ifndef METADATACACHE_H
+#define METADATACACHE_H
+
+#include "util/Btrfs.h"
+#include "util/Snapper.h"
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+
+/**
+ * @brief The MetadataCache class stores the subvolume and snapshot metadata between runs so startup doesn't have to read all of it.
+ *
+ * The data is written with QDataStream to one file per kind under /var/cache/btrfs-assistant.  Each file starts with a magic
+ * number and a format version, a file that doesn't match is ignored.  The entries are not validated here, the callers compare
+ * them against the root tree and the file modification times before using them.
+ */
+class MetadataCache {
+  public:
+    /**
+     * @brief Returns true unless the cache has been turned off in the settings
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Turns the cache off for the rest of the run regardless of the settings, used when the data doesn't come from disk
+     */
+    static void disable();
+
+    /**
+     * @brief Reads the subvolumes saved for each filesystem
+     * @return A map keyed by filesystem UUID where only the subvolumes are set, or an empty map
+     */
+    static QMap<QString, BtrfsFilesystem> readFilesystems();
+
+    /**
+     * @brief Reads the saved contents of the snapper info.xml files
+     * @return A hash keyed by the absolute path of each info.xml file or an empty hash
+     */
+    static QHash<QString, SnapperMetaCacheEntry> readSnapperMeta();
+
+    /**
+     * @brief Saves the subvolumes of each populated filesystem in @p filesystems
+     * @return true on success, false if the cache is disabled or the file could not be written
+     */
+    static bool writeFilesystems(const QMap<QString, BtrfsFilesystem> &filesystems);
+
+    /**
+     * @brief Saves the contents of the snapper info.xml files in @p metas
+     * @return true on success, false if the cache is disabled or the file could not be written
+     */
+    static bool writeSnapperMeta(const QHash<QString, SnapperMetaCacheEntry> &metas);
+};
+
+#endif // METADATACACHE_H
@@ -0,0 +1,275 @@
+#include "util/MountTable.h"
+#include "util/Tracer.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief Decodes the octal escapes (\040 etc) the kernel uses for whitespace and backslashes in mountinfo fields
+ * @param field - The raw field from mountinfo
+ * @return The decoded field
+ */
+QString decodeField(const QByteArray &field)
+{
+    if (!field.contains('\\')) {
+        return QString::fromLocal8Bit(field);
+    }
+
+    QByteArray decoded;
+    decoded.reserve(field.size());
+    for (int i = 0; i < field.size(); ++i) {
+        if (field.at(i) == '\\' && i + 3 < field.size()) {
+            bool ok = false;
+            const int value = field.mid(i + 1, 3).toInt(&ok, 8);
+            if (ok) {
+                decoded.append(static_cast<char>(value));
+                i += 3;
+                continue;
+            }
+        }
+        decoded.append(field.at(i));
+    }
+
+    return QString::fromLocal8Bit(decoded);
+}
+
+/**
+ * @brief Builds a map of device nodes to filesystem UUIDs
+ *
+ * Btrfs filesystems register all their member devices in sysfs so those are used first.  /dev/disk/by-uuid is used to fill in
+ * the UUID for any other filesystems.
+ *
+ * @return A QHash where the key is the canonical path to the device node and the value is the UUID
+ */
+QHash<QString, QString> loadDeviceUuids()
+{
+    QHash<QString, QString> deviceUuids;
+
+    const QDir btrfsDir(QStringLiteral("/sys/fs/btrfs"));
+    const QStringList uuids = btrfsDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &uuid : uuids) {
+        const QDir devicesDir(btrfsDir.filePath(uuid + QStringLiteral("/devices")));
+        const QStringList devices = devicesDir.entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot);
+        for (const QString &device : devices) {
+            deviceUuids.insert(QStringLiteral("/dev/") + device, uuid);
+        }
+    }
+
+    const QDir byUuidDir(QStringLiteral("/dev/disk/by-uuid"));
+    const QFileInfoList links = byUuidDir.entryInfoList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot);
+    for (const QFileInfo &link : links) {
+        const QString device = link.canonicalFilePath();
+        if (!device.isEmpty() && !deviceUuids.contains(device)) {
+            deviceUuids.insert(device, link.fileName());
+        }
+    }
+
+    return deviceUuids;
+}
+
+} // namespace
+
+MountTable &MountTable::instance()
+{
+    static MountTable instance;
+    return instance;
+}
+
+MountTable::MountTable() { m_fd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC); }
+
+MountTable::~MountTable()
+{
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+QVector<MountEntry> MountTable::entries(const QString &fsType)
+{
+    QMutexLocker lock(&m_mutex);
+    refresh();
+
+    if (fsType.isEmpty()) {
+        return m_entries;
+    }
+
+    QVector<MountEntry> ret;
+    for (const MountEntry &entry : std::as_const(m_entries)) {
+        if (entry.fsType == fsType) {
+            ret.append(entry);
+        }
+    }
+    return ret;
+}
+
+QString MountTable::findAnyMountpoint(const QString &uuid)
+{
+    QMutexLocker lock(&m_mutex);
+    refresh();
+
+    // QMultiHash returns the most recent values first, we want the first mount to be consistent with findmnt
+    int first = -1;
+    const QList<int> rows = m_byUuid.values(uuid);
+    for (const int row : rows) {
+        if (first == -1 || row < first) {
+            first = row;
+        }
+    }
+
+    return first == -1 ? QString() : m_entries.at(first).target;
+}
+
+QString MountTable::findMountpoint(const QString &uuid, uint64_t subvolId)
+{
+    QMutexLocker lock(&m_mutex);
+    refresh();
+
+    int first = -1;
+    const QList<int> rows = m_bySubvolId.values(subvolId);
+    for (const int row : rows) {
+        if (m_entries.at(row).uuid == uuid && (first == -1 || row < first)) {
+            first = row;
+        }
+    }
+
+    return first == -1 ? QString() : m_entries.at(first).target;
+}
+
+quint64 MountTable::generation()
+{
+    QMutexLocker lock(&m_mutex);
+    refresh();
+
+    return m_generation;
+}
+
+bool MountTable::hasFilesystemType(const QString &fsType)
+{
+    QMutexLocker lock(&m_mutex);
+    refresh();
+
+    return std::any_of(m_entries.cbegin(), m_entries.cend(), [&fsType](const MountEntry &entry) { return entry.fsType == fsType; });
+}
+
+bool MountTable::isMounted(const QString &uuid, uint64_t subvolId) { return !findMountpoint(uuid, subvolId).isEmpty(); }
+
+QString MountTable::uuid(const QString &target)
+{
+    QMutexLocker lock(&m_mutex);
+    refresh();
+
+    const int row = m_byTarget.value(QDir::cleanPath(target), -1);
+    return row == -1 ? QString() : m_entries.at(row).uuid;
+}
+
+QString MountTable::containingUuid(const QString &path)
+{
+    QMutexLocker lock(&m_mutex);
+    refresh();
+
+    QString current = QDir::cleanPath(path);
+    while (!current.isEmpty()) {
+        const int row = m_byTarget.value(current, -1);
+        if (row != -1) {
+            return m_entries.at(row).uuid;
+        }
+        if (current == QStringLiteral("/")) {
+            break;
+        }
+
+        const qsizetype slash = current.lastIndexOf(QLatin1Char('/'));
+        current = slash <= 0 ? QStringLiteral("/") : current.left(slash);
+    }
+
+    return QString();
+}
+
+void MountTable::refresh()
+{
+    if (!m_isLoaded || m_fd < 0) {
+        reload();
+        return;
+    }
+
+    // The kernel flags POLLPRI/POLLERR on mountinfo whenever a mount or unmount happens in our namespace
+    struct pollfd pfd = {m_fd, POLLPRI, 0};
+    if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLPRI | POLLERR))) {
+        reload();
+    }
+}
+
+void MountTable::reload()
+{
+    TraceSpan span(QStringLiteral("MountTable::reload"));
+
+    m_entries.clear();
+    m_byUuid.clear();
+    m_bySubvolId.clear();
+    m_byTarget.clear();
+
+    QFile file(QStringLiteral("/proc/self/mountinfo"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const QHash<QString, QString> deviceUuids = loadDeviceUuids();
+    // Resolving symlinks like /dev/mapper/* requires a stat so we only want to do it once per device
+    QHash<QString, QString> canonicalDevices;
+
+    // The format is documented in proc(5):
+    // 36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+    const QList<QByteArray> lines = file.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        const QList<QByteArray> fields = line.split(' ');
+        const int separator = static_cast<int>(fields.indexOf("-", 6));
+        if (separator == -1 || separator + 2 >= fields.count()) {
+            continue;
+        }
+
+        MountEntry entry;
+        entry.root = decodeField(fields.at(3));
+        entry.target = decodeField(fields.at(4));
+        entry.fsType = decodeField(fields.at(separator + 1));
+        entry.source = decodeField(fields.at(separator + 2));
+
+        // Only the super options contain the btrfs specific subvolume information
+        const QList<QByteArray> superOptions = fields.value(separator + 3).split(',');
+        for (const QByteArray &option : superOptions) {
+            if (option.startsWith("subvolid=")) {
+                entry.subvolId = option.mid(9).toULongLong();
+            } else if (option.startsWith("subvol=")) {
+                entry.subvol = decodeField(option.mid(7));
+            }
+        }
+
+        if (entry.source.startsWith(QStringLiteral("/dev/"))) {
+            if (!canonicalDevices.contains(entry.source)) {
+                const QString canonical = QFileInfo(entry.source).canonicalFilePath();
+                canonicalDevices.insert(entry.source, canonical.isEmpty() ? entry.source : canonical);
+            }
+            entry.uuid = deviceUuids.value(canonicalDevices.value(entry.source));
+        }
+
+        const int row = static_cast<int>(m_entries.count());
+        m_entries.append(entry);
+        if (!entry.uuid.isEmpty()) {
+            m_byUuid.insert(entry.uuid, row);
+        }
+        if (entry.subvolId != 0) {
+            m_bySubvolId.insert(entry.subvolId, row);
+        }
+        // When something is mounted over an existing mountpoint the last one is the visible one
+        m_byTarget.insert(entry.target, row);
+    }
+
+    m_isLoaded = true;
+    ++m_generation;
+}
@@ -0,0 +1,115 @@
+#ifndef MOUNTTABLE_H
+#define MOUNTTABLE_H
+
+#include <QHash>
+#include <QMultiHash>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+
+// A single line from /proc/self/mountinfo
+struct MountEntry {
+    QString source;
+    QString target;
+    QString fsType;
+    QString root;
+    QString uuid;
+    QString subvol;
+    uint64_t subvolId = 0;
+};
+
+/**
+ * @brief The MountTable class is a singleton that provides an in-process view of the mount table.
+ *
+ * The data is parsed from /proc/self/mountinfo and is only reloaded when the kernel reports that the mount table has changed.
+ */
+class MountTable {
+  public:
+    /**
+     * @brief Gets a reference to the MountTable object
+     */
+    static MountTable &instance();
+
+    /**
+     * @brief Returns all the entries in the mount table in the order they were mounted
+     * @param fsType - When not empty, only entries with a matching filesystem type are returned
+     * @return A QVector of MountEntry
+     */
+    QVector<MountEntry> entries(const QString &fsType = QString());
+
+    /**
+     * @brief Finds a single mountpoint for a filesystem
+     * @param uuid - The UUID of the filesystem to find the mountpoint for
+     * @return The absolute path to the mountpoint or an empty string if the filesystem isn't mounted
+     */
+    QString findAnyMountpoint(const QString &uuid);
+
+    /**
+     * @brief Finds a mountpoint where a specific btrfs subvolume is mounted
+     * @param uuid - The UUID of the filesystem
+     * @param subvolId - The ID of the subvolume
+     * @return The absolute path to the mountpoint or an empty string if the subvolume isn't mounted
+     */
+    QString findMountpoint(const QString &uuid, uint64_t subvolId);
+
+    /**
+     * @brief Returns a counter that is incremented every time the mount table is reloaded
+     *
+     * This can be used by callers to invalidate data that is derived from the set of mounted filesystems.
+     */
+    quint64 generation();
+
+    /**
+     * @brief Checks if at least one filesystem of type @p fsType is mounted
+     */
+    bool hasFilesystemType(const QString &fsType);
+
+    /**
+     * @brief Returns true if the subvolume with ID @p subvolId on filesystem @p uuid is mounted
+     */
+    bool isMounted(const QString &uuid, uint64_t subvolId);
+
+    /**
+     * @brief Finds the UUID of the filesystem mounted at @p target
+     * @param target - The absolute path of a mountpoint
+     * @return The UUID or an empty string if nothing is mounted at @p target
+     */
+    QString uuid(const QString &target);
+
+    /**
+     * @brief Finds the UUID of the filesystem that holds @p path, which doesn't need to be a mountpoint itself
+     * @param path - An absolute path
+     * @return The UUID of the closest mount at or above @p path or an empty string if that mount has no UUID
+     */
+    QString containingUuid(const QString &path);
+
+  private:
+    MountTable();
+    ~MountTable();
+    // Delete the copy constructor and the assignment operator
+    MountTable(MountTable const &) = delete;
+    void operator=(MountTable const &) = delete;
+
+    /**
+     * @brief Reloads the table if it has never been loaded or the kernel has signaled a change. Must be called with m_mutex held.
+     */
+    void refresh();
+
+    /**
+     * @brief Parses /proc/self/mountinfo and rebuilds the indexes. Must be called with m_mutex held.
+     */
+    void reload();
+
+    QMutex m_mutex;
+    // A file descriptor for /proc/self/mountinfo that is polled for changes
+    int m_fd = -1;
+    bool m_isLoaded = false;
+    quint64 m_generation = 0;
+    QVector<MountEntry> m_entries;
+    // Indexes into m_entries, values are stored in mount order
+    QMultiHash<QString, int> m_byUuid;
+    QMultiHash<uint64_t, int> m_bySubvolId;
+    QHash<QString, int> m_byTarget;
+};
+
+#endif // MOUNTTABLE_H
@@ -0,0 +1,97 @@
+#include "util/ProgressMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Polled at least this far apart, also used until the rate is known
+constexpr qint64 MIN_INTERVAL_MS = 1000;
+
+// Polled at least this often, even when the time left can't be worked out because nothing moved
+constexpr qint64 MAX_INTERVAL_MS = 60000;
+
+// The number of polls spread over the time left
+constexpr qint64 POLLS_LEFT = 200;
+
+// The weight of the latest poll in the rate, the rest comes from the earlier ones so short stalls don't swing the time left
+constexpr double RATE_WEIGHT = 0.3;
+
+} // namespace
+
+ProgressMonitor::ProgressMonitor(std::function<QFuture<BtrfsProgress>()> read, QObject *parent)
+    : QObject(parent), m_read(std::move(read))
+{
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::VeryCoarseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &ProgressMonitor::poll);
+}
+
+bool ProgressMonitor::isActive() const { return m_isActive; }
+
+void ProgressMonitor::start()
+{
+    m_timer.stop();
+    m_isActive = true;
+    m_lastPoll.invalidate();
+    m_lastDone = 0;
+    m_rate = 0;
+    poll();
+}
+
+void ProgressMonitor::stop()
+{
+    m_timer.stop();
+    m_isActive = false;
+    ++m_serial;
+}
+
+void ProgressMonitor::poll()
+{
+    const quint64 serial = ++m_serial;
+    m_read().then(this, [this, serial](BtrfsProgress progress) {
+        if (serial != m_serial) {
+            return;
+        }
+
+        if (!progress.isRunning) {
+            m_isActive = false;
+            emit progressChanged(progress);
+            return;
+        }
+
+        updateRate(progress);
+        emit progressChanged(progress);
+
+        // Poll in proportion to the time left, a paused or stalled operation backs off to the longest interval
+        qint64 interval = MAX_INTERVAL_MS;
+        if (progress.secondsLeft >= 0) {
+            interval = std::clamp(progress.secondsLeft * 1000 / POLLS_LEFT, MIN_INTERVAL_MS, MAX_INTERVAL_MS);
+        } else if (!progress.isPaused && m_rate == 0) {
+            interval = MIN_INTERVAL_MS;
+        }
+        m_timer.start(static_cast<int>(interval));
+    });
+}
+
+void ProgressMonitor::updateRate(BtrfsProgress &progress)
+{
+    // Going backwards means a new operation was started since the last poll
+    if (m_lastPoll.isValid() && progress.done >= m_lastDone) {
+        const double seconds = static_cast<double>(m_lastPoll.elapsed()) / 1000.0;
+        if (seconds > 0) {
+            const double rate = static_cast<double>(progress.done - m_lastDone) / seconds;
+            m_rate = m_rate == 0 ? rate : RATE_WEIGHT * rate + (1.0 - RATE_WEIGHT) * m_rate;
+        }
+    } else {
+        m_rate = 0;
+    }
+    m_lastPoll.start();
+    m_lastDone = progress.done;
+
+    progress.rate = m_rate;
+    if (m_rate > 0 && !progress.isPaused) {
+        const uint64_t left = progress.total > progress.done ? progress.total - progress.done : 0;
+        progress.secondsLeft = static_cast<qint64>(std::ceil(static_cast<double>(left) / m_rate));
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef PROGRESSMONITOR_H
+#define PROGRESSMONITOR_H
+
+#include "util/Btrfs.h"
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QObject>
+#include <QTimer>
+
+#include <functional>
+
+/**
+ * @brief The ProgressMonitor class follows a running balance or scrub and works out its rate and the time left.
+ *
+ * The progress is polled right away when the monitor is started and then at an interval based on the time left, so a scrub
+ * that takes hours is only read about once a minute while a short one still updates every second.  Polling stops by itself once
+ * the operation isn't running anymore.
+ */
+class ProgressMonitor : public QObject {
+    Q_OBJECT
+
+  public:
+    /**
+     * @param read - Called on every poll to start reading the progress
+     */
+    explicit ProgressMonitor(std::function<QFuture<BtrfsProgress>()> read, QObject *parent = nullptr);
+
+    /**
+     * @brief Returns true while the operation is being followed
+     */
+    bool isActive() const;
+
+    /**
+     * @brief Reads the progress now and keeps polling for as long as the operation is running
+     *
+     * The rate is worked out from scratch, which makes this the right call whenever a different filesystem is shown or an
+     * operation was started or stopped.
+     */
+    void start();
+
+    /**
+     * @brief Stops polling, a read that is still in flight is ignored
+     */
+    void stop();
+
+  signals:
+    /**
+     * @brief Emitted after every poll with the rate and time left filled in, the last one has isRunning set to false
+     */
+    void progressChanged(const BtrfsProgress &progress);
+
+  private:
+    /**
+     * @brief Reads the progress and schedules the next poll once it is in
+     */
+    void poll();
+
+    /**
+     * @brief Updates the rate from @p progress and fills in the rate and time left
+     */
+    void updateRate(BtrfsProgress &progress);
+
+    std::function<QFuture<BtrfsProgress>()> m_read;
+    QTimer m_timer;
+    // Identifies the latest poll so results that come in after a restart or a stop are ignored
+    quint64 m_serial = 0;
+    bool m_isActive = false;
+
+    // The previous poll, used to work out the rate
+    QElapsedTimer m_lastPoll;
+    uint64_t m_lastDone = 0;
+    double m_rate = 0;
+};
+
+#endif // PROGRESSMONITOR_H
@@ -0,0 +1,268 @@
+#include "util/SendStream.h"
+
+#include <QFile>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// The layout of the stream as defined in fs/btrfs/send.h, which isn't part of the kernel headers
+constexpr char STREAM_MAGIC[] = "btrfs-stream";
+constexpr qsizetype STREAM_HEADER_SIZE = sizeof(STREAM_MAGIC) + sizeof(quint32);
+// The length of the attributes, the command and a checksum
+constexpr qsizetype COMMAND_HEADER_SIZE = sizeof(quint32) + sizeof(quint16) + sizeof(quint32);
+// The type and the length of an attribute
+constexpr quint32 ATTRIBUTE_HEADER_SIZE = sizeof(quint16) + sizeof(quint16);
+// Version 2 only adds commands for file data, which isn't asked for
+constexpr quint32 MAX_STREAM_VERSION = 2;
+
+enum Command : quint16 {
+    SUBVOL = 1,
+    SNAPSHOT = 2,
+    MKFILE = 3,
+    MKDIR = 4,
+    MKNOD = 5,
+    MKFIFO = 6,
+    MKSOCK = 7,
+    SYMLINK = 8,
+    RENAME = 9,
+    LINK = 10,
+    UNLINK = 11,
+    RMDIR = 12,
+    SET_XATTR = 13,
+    REMOVE_XATTR = 14,
+    WRITE = 15,
+    CLONE = 16,
+    TRUNCATE = 17,
+    CHMOD = 18,
+    CHOWN = 19,
+    UTIMES = 20,
+    END = 21,
+    UPDATE_EXTENT = 22,
+    FALLOCATE = 23,
+    FILEATTR = 24,
+    ENCODED_WRITE = 25,
+};
+
+enum Attribute : quint16 {
+    PATH = 15,
+    PATH_TO = 16,
+};
+
+} // namespace
+
+void SendStreamParser::append(const char *data, qsizetype size)
+{
+    if (!m_error.isEmpty()) {
+        return;
+    }
+
+    m_buffer.append(data, size);
+
+    qsizetype offset = 0;
+    if (!m_hasHeader) {
+        if (m_buffer.size() < STREAM_HEADER_SIZE) {
+            return;
+        }
+
+        const quint32 version = qFromLittleEndian<quint32>(m_buffer.constData() + sizeof(STREAM_MAGIC));
+        if (std::memcmp(m_buffer.constData(), STREAM_MAGIC, sizeof(STREAM_MAGIC)) != 0 || version == 0 || version > MAX_STREAM_VERSION) {
+            m_error = tr("The send stream has an unknown format");
+            return;
+        }
+
+        m_hasHeader = true;
+        offset = STREAM_HEADER_SIZE;
+    }
+
+    while (m_error.isEmpty() && m_buffer.size() - offset >= COMMAND_HEADER_SIZE) {
+        const char *header = m_buffer.constData() + offset;
+        const quint32 length = qFromLittleEndian<quint32>(header);
+        if (m_buffer.size() - offset - COMMAND_HEADER_SIZE < static_cast<qsizetype>(length)) {
+            break;
+        }
+
+        parseCommand(qFromLittleEndian<quint16>(header + sizeof(quint32)), header + COMMAND_HEADER_SIZE, length);
+        offset += COMMAND_HEADER_SIZE + length;
+    }
+
+    m_buffer.remove(0, offset);
+}
+
+FileChanges SendStreamParser::finish() const
+{
+    FileChanges result;
+    if (!m_error.isEmpty()) {
+        result.error = m_error;
+        return result;
+    }
+
+    if (!m_hasEnded) {
+        result.error = tr("The send stream ended early");
+        return result;
+    }
+
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        if (it->isCreated) {
+            result.changes.append({FileChange::Created, it.key(), {}});
+            continue;
+        }
+
+        if (it->originalPath != it.key()) {
+            result.changes.append({FileChange::Renamed, it.key(), it->originalPath});
+        }
+        if (it->isModified) {
+            result.changes.append({FileChange::Modified, it.key(), {}});
+        }
+    }
+
+    for (const QString &path : m_deleted) {
+        result.changes.append({FileChange::Deleted, path, {}});
+    }
+
+    std::stable_sort(result.changes.begin(), result.changes.end(),
+                     [](const FileChange &a, const FileChange &b) { return a.path < b.path; });
+
+    return result;
+}
+
+void SendStreamParser::parseCommand(quint16 command, const char *data, quint32 size)
+{
+    QString path;
+    QString pathTo;
+
+    for (quint32 offset = 0; offset < size;) {
+        if (size - offset < ATTRIBUTE_HEADER_SIZE) {
+            m_error = tr("The send stream is corrupt");
+            return;
+        }
+
+        const quint16 type = qFromLittleEndian<quint16>(data + offset);
+        const quint16 length = qFromLittleEndian<quint16>(data + offset + sizeof(quint16));
+        offset += ATTRIBUTE_HEADER_SIZE;
+        if (size - offset < length) {
+            m_error = tr("The send stream is corrupt");
+            return;
+        }
+
+        if (type == PATH) {
+            path = QFile::decodeName(QByteArray(data + offset, length));
+        } else if (type == PATH_TO) {
+            pathTo = QFile::decodeName(QByteArray(data + offset, length));
+        }
+        offset += length;
+    }
+
+    switch (command) {
+    case MKFILE:
+    case MKDIR:
+    case MKNOD:
+    case MKFIFO:
+    case MKSOCK:
+    case SYMLINK:
+    case LINK:
+        create(path);
+        break;
+    case RENAME:
+        rename(path, pathTo);
+        break;
+    case UNLINK:
+    case RMDIR:
+        remove(path);
+        break;
+    case SET_XATTR:
+    case REMOVE_XATTR:
+    case WRITE:
+    case CLONE:
+    case TRUNCATE:
+    case CHMOD:
+    case CHOWN:
+    case UPDATE_EXTENT:
+    case FALLOCATE:
+    case FILEATTR:
+    case ENCODED_WRITE:
+        modify(path);
+        break;
+    case END:
+        m_hasEnded = true;
+        break;
+    default:
+        // The subvolume header and the timestamps don't change what is reported
+        break;
+    }
+}
+
+void SendStreamParser::create(const QString &path)
+{
+    Entry &entry = m_entries[path];
+    entry.originalPath.clear();
+    entry.isCreated = true;
+}
+
+void SendStreamParser::modify(const QString &path)
+{
+    auto it = m_entries.find(path);
+    if (it == m_entries.end()) {
+        it = m_entries.insert(path, {originalPathOf(path), false, false});
+    }
+
+    // A new file is reported as created, whatever was written to it
+    if (!it->isCreated) {
+        it->isModified = true;
+    }
+}
+
+void SendStreamParser::remove(const QString &path)
+{
+    const auto it = m_entries.constFind(path);
+    if (it == m_entries.cend()) {
+        m_deleted.append(originalPathOf(path));
+        return;
+    }
+
+    // A path that was created by the stream and then removed again was only a step on the way
+    if (!it->isCreated) {
+        m_deleted.append(it->originalPath);
+    }
+    m_entries.erase(it);
+}
+
+void SendStreamParser::rename(const QString &from, const QString &to)
+{
+    const auto it = m_entries.constFind(from);
+    Entry entry;
+    if (it == m_entries.cend()) {
+        entry.originalPath = originalPathOf(from);
+    } else {
+        entry = *it;
+        m_entries.erase(it);
+    }
+
+    // The tracked paths below a directory move with it, they sort right after it
+    const QString prefix = from + QLatin1Char('/');
+    QVector<std::pair<QString, Entry>> moved;
+    for (auto child = m_entries.lowerBound(prefix); child != m_entries.end() && child.key().startsWith(prefix);) {
+        moved.append({to + QLatin1Char('/') + child.key().mid(prefix.length()), child.value()});
+        child = m_entries.erase(child);
+    }
+    for (const auto &[path, childEntry] : std::as_const(moved)) {
+        m_entries.insert(path, childEntry);
+    }
+
+    m_entries.insert(to, entry);
+}
+
+QString SendStreamParser::originalPathOf(const QString &path) const
+{
+    // The closest tracked directory above the path tells where it was in the parent
+    for (qsizetype slash = path.lastIndexOf(QLatin1Char('/')); slash > 0; slash = path.lastIndexOf(QLatin1Char('/'), slash - 1)) {
+        const auto it = m_entries.constFind(path.left(slash));
+        if (it != m_entries.cend()) {
+            return it->originalPath + path.mid(slash);
+        }
+    }
+
+    return path;
+}
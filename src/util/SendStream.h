@@ -0,0 +1,67 @@
+#ifndef SENDSTREAM_H
+#define SENDSTREAM_H
+
+#include "util/Btrfs.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The SendStreamParser class turns an incremental btrfs send stream into the list of files that changed.
+ *
+ * The stream replays the changes on a copy of the parent, so new files first appear under temporary orphan names and existing
+ * files can be moved out of the way before they reach their final names.  Every path the stream touches is tracked under its
+ * current name along with the name it had in the parent, a rename moves the tracked paths below it as well.  Only the commands
+ * that describe a change are looked at, timestamp updates are ignored since they follow every change to a directory.
+ */
+class SendStreamParser {
+    Q_DECLARE_TR_FUNCTIONS(SendStreamParser)
+
+  public:
+    /**
+     * @brief Parses the next chunk of the stream, a command split between chunks is kept until the rest of it arrives
+     */
+    void append(const char *data, qsizetype size);
+
+    /**
+     * @brief Returns the changes found in the stream, or an error if it was malformed or ended early
+     */
+    FileChanges finish() const;
+
+  private:
+    // A path the stream touched, keyed by its current name
+    struct Entry {
+        // The name in the parent, empty for a path that didn't exist there
+        QString originalPath;
+        bool isCreated = false;
+        bool isModified = false;
+    };
+
+    /**
+     * @brief Handles a single command with @p size bytes of attributes at @p data
+     */
+    void parseCommand(quint16 command, const char *data, quint32 size);
+
+    void create(const QString &path);
+    void modify(const QString &path);
+    void remove(const QString &path);
+    void rename(const QString &from, const QString &to);
+
+    /**
+     * @brief Returns the name @p path had in the parent, following the renames of the directories above it
+     */
+    QString originalPathOf(const QString &path) const;
+
+    QByteArray m_buffer;
+    QString m_error;
+    bool m_hasHeader = false;
+    bool m_hasEnded = false;
+    QMap<QString, Entry> m_entries;
+    // The names in the parent of the paths that were removed
+    QVector<QString> m_deleted;
+};
+
+#endif // SENDSTREAM_H
@@ -1,29 +1,172 @@
 #include "util/Snapper.h"
 #include "CsvParser.h"
+#include "util/MetadataCache.h"
+#include "util/MountTable.h"
 #include "util/Settings.h"
 #include "util/System.h"
+#include "util/Tracer.h"
 
 #include <unistd.h>
 
 #include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QPromise>
 #include <QRegularExpression>
+#include <QThread>
+#include <QThreadPool>
 #include <QXmlStreamReader>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <memory>
 
 constexpr const char *DEFAULT_SNAP_PATH = "/.snapshots";
 constexpr const char *DEFAULT_SNAP_SUBVOL = ".snapshots";
 constexpr const char *ROOT_PATH = "/";
 
-Snapper::Snapper(Btrfs *btrfs, QString snapperCommand, QObject *parent) : QObject{parent}, m_btrfs(btrfs), m_snapperCommand(snapperCommand)
+namespace {
+
+// A snapshot subvolume along with the metadata snapper keeps for it
+struct SnapshotMeta {
+    QString uuid;
+    uint64_t subvolId = 0;
+    QString subvolName;
+    // The absolute path to the info.xml file of the snapshot
+    QString filename;
+    // The modification time of the file in milliseconds since the epoch
+    qint64 modified = 0;
+    SnapperSnapshot snapshot;
+};
+
+/**
+ * @brief Collapses @p numbers into the space separated ranges accepted by snapper delete, e.g. "1-5 8 10-11"
+ */
+QString collapseRanges(const QList<uint> &numbers)
+{
+    QStringList ranges;
+    for (qsizetype i = 0; i < numbers.count(); ++i) {
+        const uint first = numbers.at(i);
+        while (i + 1 < numbers.count() && numbers.at(i + 1) == numbers.at(i) + 1) {
+            ++i;
+        }
+
+        if (numbers.at(i) == first) {
+            ranges.append(QString::number(first));
+        } else {
+            ranges.append(QString::number(first) + "-" + QString::number(numbers.at(i)));
+        }
+    }
+
+    return ranges.join(' ');
+}
+
+// Creating or deleting snapshots and configs can take minutes on a busy filesystem, the same limit as the D-Bus calls
+constexpr std::chrono::minutes MUTATING_COMMAND_TIMEOUT(10);
+
+/**
+ * @brief Converts the output of a snapper command run with --machine-readable csv into a SnapperResult
+ */
+SnapperResult toSnapperResult(const Result &result)
+{
+    SnapperResult snapperResult;
+    snapperResult.exitCode = result.exitCode;
+
+    if (result.exitCode != 0 || result.output.isEmpty()) {
+        snapperResult.outputList = QStringList() << result.output;
+    } else {
+        QStringList outputList = result.output.split('\n');
+
+        // Remove the header
+        outputList.removeFirst();
+
+        snapperResult.outputList = outputList;
+    }
+
+    return snapperResult;
+}
+
+} // namespace
+
+Snapper::Snapper(Btrfs *btrfs, QString snapperCommand, InitialLoad initialLoad, QObject *parent)
+    : QObject{parent}, m_btrfs(btrfs), m_snapperCommand(snapperCommand)
 {
+    // The bus and service can be changed in the settings to run against a mock snapperd
+    if (Settings::instance().value("snapper_dbus", true).toBool()) {
+        m_dbus = std::make_unique<SnapperDBus>(Settings::instance().value("snapper_dbus_address", QString()).toString(),
+                                               Settings::instance().value("snapper_dbus_service", "org.opensuse.Snapper").toString());
+    }
+
+    if (initialLoad == InitialLoad::Later) {
+        return;
+    }
+
+    m_metaCache = MetadataCache::readSnapperMeta();
     load();
 }
 
+Snapper::~Snapper()
+{
+    if (m_isLoaded) {
+        MetadataCache::writeSnapperMeta(m_metaCache);
+    }
+}
+
+QFuture<SnapperResult> Snapper::changeSnapshotDescription(const QString &name, const int num, const QString &desc) const
+{
+    QString asciiDesc = desc.toLatin1(); // Ensure only ASCII chars
+    // Snapper does not recommend using any non ASCII chars (it's ok if you use utf-8 everywhere, but better safe than sorry)
+
+    // Escape Single quotes since they are used to delimit the description
+    QString quotedDesc = asciiDesc;
+    quotedDesc.replace("'", "'\\''");
+
+    return runWithFallback(
+        [this, name, num, asciiDesc]() { return m_dbus->setSnapshot(name, static_cast<uint>(num), asciiDesc, std::nullopt); },
+        "modify --description '" + quotedDesc + "' " + QString::number(num), name);
+}
+
+QMap<uint, SnapperSnapshot> Snapper::cachedSnapshots(const QString &snapshotDir) const
+{
+    // The cache is keyed by the path of each info.xml so only <snapshotDir>/<number>/info.xml entries belong to the directory
+    const QString prefix = QDir::cleanPath(snapshotDir) + QDir::separator();
+    const QString suffix = QStringLiteral("/info.xml");
+
+    QMap<uint, SnapperSnapshot> snapshots;
+    for (auto it = m_metaCache.cbegin(); it != m_metaCache.cend(); ++it) {
+        const QString &filename = it.key();
+        if (filename.length() <= prefix.length() + suffix.length() || !filename.startsWith(prefix) || !filename.endsWith(suffix)) {
+            continue;
+        }
+
+        const QStringView number = QStringView(filename).sliced(prefix.length(), filename.length() - prefix.length() - suffix.length());
+        if (number == QString::number(it->snapshot.number)) {
+            snapshots.insert(it->snapshot.number, it->snapshot);
+        }
+    }
+
+    return snapshots;
+}
+
 Snapper::Config Snapper::config(const QString &name) { return m_configs.value(name); }
 
+QFuture<SnapperResult> Snapper::createConfig(const QString &name, const QString &path) const
+{
+    return runWithFallback([this, name, path]() { return m_dbus->createConfig(name, path); }, "create-config " + path, name,
+                           MUTATING_COMMAND_TIMEOUT);
+}
+
+QFuture<SnapperResult> Snapper::createSnapshot(const QString &name, const QString &desc) const
+{
+    return runWithFallback([this, name, desc]() { return m_dbus->createSingleSnapshot(name, desc, QString()); }, "create -d '" + desc + "'",
+                           name, MUTATING_COMMAND_TIMEOUT);
+}
+
 void Snapper::createSubvolMap()
 {
+    TraceSpan span(QStringLiteral("Snapper::createSubvolMap"));
+
     for (const QVector<SnapperSubvolume> &subvol : std::as_const(m_subvols)) {
         const SubvolResult sr = findSnapshotSubvolume(subvol.at(0).subvol);
         const QString snapshotSubvol = sr.name;
@@ -44,6 +187,45 @@ void Snapper::createSubvolMap()
     }
 }
 
+QFuture<SnapperResult> Snapper::deleteConfig(const QString &name) const
+{
+    return runWithFallback([this, name]() { return m_dbus->deleteConfig(name); }, "delete-config", name, MUTATING_COMMAND_TIMEOUT);
+}
+
+QFuture<SnapperDeleteResult> Snapper::deleteSnapshots(const QString &name, const QSet<uint> &numbers)
+{
+    QList<uint> sorted = numbers.values();
+    std::sort(sorted.begin(), sorted.end());
+
+    return runWithFallback([this, name, sorted]() { return m_dbus->deleteSnapshots(name, sorted); }, "delete " + collapseRanges(sorted),
+                           name, MUTATING_COMMAND_TIMEOUT)
+        .then(this, [this, name, sorted](const SnapperResult &result) {
+            reloadSnapshots(name);
+
+            // snapper stops at the first snapshot it can't delete so the list is checked rather than trusting the exit code
+            QSet<uint> remaining;
+            const QVector<SnapperSnapshot> snapshots = m_snapshots.value(name);
+            for (const SnapperSnapshot &snapshot : snapshots) {
+                remaining.insert(snapshot.number);
+            }
+
+            const QString error = result.exitCode != 0 ? result.outputList.join('\n').trimmed() : QString();
+
+            SnapperDeleteResult deleteResult;
+            for (const uint number : sorted) {
+                if (!remaining.contains(number)) {
+                    deleteResult.deleted.append(number);
+                } else if (!error.isEmpty()) {
+                    deleteResult.failed.insert(number, error);
+                } else {
+                    deleteResult.failed.insert(number, tr("Snapshot %1 was not deleted").arg(number));
+                }
+            }
+
+            return deleteResult;
+        });
+}
+
 SubvolResult Snapper::findSnapshotSubvolume(const QString &subvol)
 {
     static QRegularExpression re("\\/[0-9]*\\/snapshot$");
@@ -99,87 +281,78 @@ SubvolResult Snapper::findTargetSubvol(const QString &snapshotSubvol, const QStr
 
 void Snapper::load()
 {
+    TraceSpan span(QStringLiteral("Snapper::load"));
+
     // Load the subvol map from config
     loadSubvolMap();
 
     // Load the list of valid configs
     m_configs.clear();
     m_snapshots.clear();
-    const SnapperResult result = runSnapper("list-configs --columns config");
-
-    if (result.exitCode != 0) {
-        return;
-    }
-
-    for (const QString &line : std::as_const(result.outputList)) {
-        // for each config, add to the map and add it's snapshots to the vector
-        SnapperResult listResult;
-        QString name = line.trimmed();
-
-        loadConfig(name);
-
-        // The root needs special handling because we may be booted off a snapshot
-        if (name == "root") {
-            listResult = runSnapper("list --columns number,date,description,type,cleanup");
-
-            if (listResult.exitCode != 0) {
-                continue;
+    m_isLoaded = true;
+
+    QStringList names;
+    QVector<SnapperDBusConfig> dbusConfigs;
+    if (isDBusConnected() && m_dbus->listConfigs(dbusConfigs).isSuccess) {
+        // The config data comes with the list so there is no need to ask for each one separately
+        for (const SnapperDBusConfig &dbusConfig : std::as_const(dbusConfigs)) {
+            Config config;
+            for (auto it = dbusConfig.raw.cbegin(); it != dbusConfig.raw.cend(); ++it) {
+                config.insert(it.key(), it.value());
             }
+            if (!config.isEmpty()) {
+                m_configs[dbusConfig.name] = config;
+            }
+            names.append(dbusConfig.name);
+        }
+    } else {
+        const SnapperResult result = runSnapper("list-configs --columns config");
 
-            if (listResult.outputList.isEmpty()) {
-                // This means that either there are no snapshots or the root is mounted on non-btrfs filesystem like an overlayfs
-                // Let's check the latter case first
-                if (!m_btrfs->subvolumeName(DEFAULT_SNAP_SUBVOL).success) {
-                    // This probably means there are just no snapshots or we are using a nested subvol in another place
-                    continue;
-                }
-
-                // Now we need to find out where the snapshots are actually stored
-                const uint64_t parentId = m_btrfs->subvolParent(DEFAULT_SNAP_SUBVOL);
-
-                // It shouldn't be possible for the parent to not exist but we check anyway
-                if (parentId == 0) {
-                    continue;
-                }
-
-                const QString uuid = System::runCmd("findmnt", {"-no", "uuid", DEFAULT_SNAP_PATH}, false).output;
-
-                // Make sure the root of the partition is mounted
-                QString mountpoint = m_btrfs->mountRoot(uuid);
-                if (mountpoint.isEmpty()) {
-                    continue;
-                }
-
-                const QString parentName = m_btrfs->subvolumeName(uuid, parentId).name;
+        if (result.exitCode != 0) {
+            return;
+        }
 
-                listResult = runSnapper("--no-dbus -r " + QDir::cleanPath(mountpoint + QDir::separator() + parentName) +
-                                        " list --columns number,date,description,type");
-                if (listResult.exitCode != 0 || listResult.outputList.isEmpty()) {
-                    // If this is still empty, give up
-                    continue;
-                }
-            }
-        } else {
-            listResult = runSnapper("list --columns number,date,description,type,cleanup", name);
-            if (listResult.exitCode != 0 || listResult.outputList.isEmpty()) {
-                continue;
-            }
+        for (const QString &line : std::as_const(result.outputList)) {
+            names.append(line.trimmed());
+            loadConfig(names.last());
         }
+    }
 
-        for (const QString &snap : std::as_const(listResult.outputList)) {
-            // Parse `complex` CSV where ',' and '"' in the description are possible
-            QStringList cols = parseCsvLine(snap);
+    // Reading the snapshot subvolumes also fills in the snapshots of each config from their info.xml files
+    loadSubvols();
 
-            const uint number = cols.at(0).toUInt();
-            // Snapshot 0 is not a real snapshot
-            if (number == 0) {
-                continue;
-            }
+    // Ask snapper for the configs that couldn't be matched to their snapshot subvolumes, such as when booted off a snapshot
+    for (const QString &name : std::as_const(names)) {
+        if (m_snapshots.contains(name)) {
+            continue;
+        }
 
-            m_snapshots[name].append({number, QDateTime::fromString(cols.at(1), Qt::ISODate), cols.at(2), cols.at(3), cols.at(4)});
+        const QVector<SnapperSnapshot> snapshots = listSnapshots(name);
+        if (!snapshots.isEmpty()) {
+            m_snapshots[name] = snapshots;
         }
     }
-    loadSubvols();
+}
+
+Snapper::LoadedData Snapper::loadedData() const
+{
+    LoadedData data;
+    data.configs = m_configs;
+    data.metaCache = m_metaCache;
+    data.snapshots = m_snapshots;
+    data.subvols = m_subvols;
+    data.subvolMap = m_subvolMap;
+    return data;
+}
+
+void Snapper::setLoadedData(const LoadedData &data)
+{
+    m_configs = data.configs;
+    m_metaCache = data.metaCache;
+    m_snapshots = data.snapshots;
+    m_subvols = data.subvols;
+    m_subvolMap = data.subvolMap;
+    m_isLoaded = true;
 }
 
 void Snapper::loadConfig(const QString &name)
@@ -189,6 +362,19 @@ void Snapper::loadConfig(const QString &name)
         m_configs.remove(name);
     }
 
+    Config config;
+
+    SnapperDBusConfig dbusConfig;
+    if (isDBusConnected() && m_dbus->getConfig(name, dbusConfig).isSuccess) {
+        for (auto it = dbusConfig.raw.cbegin(); it != dbusConfig.raw.cend(); ++it) {
+            config.insert(it.key(), it.value());
+        }
+        if (!config.isEmpty()) {
+            m_configs[name] = config;
+        }
+        return;
+    }
+
     // Call Snapper to get the config data
     const SnapperResult result = runSnapper("get-config", name);
 
@@ -197,7 +383,6 @@ void Snapper::loadConfig(const QString &name)
     }
 
     // Iterate over the data adding the name/value pairs to the map
-    Config config;
     for (const QString &line : result.outputList) {
         if (line.trimmed().isEmpty()) {
             continue;
@@ -239,11 +424,14 @@ void Snapper::loadSubvolMap()
 
 void Snapper::loadSubvols()
 {
+    TraceSpan span(QStringLiteral("Snapper::loadSubvols"));
+
     // Clear the existing info
     m_subvols.clear();
 
-    // Get a list of the btrfs filesystems and loop over them
-    const QStringList btrfsFilesystems = Btrfs::listFilesystems();
+    // Collect the snapshot subvolumes of every filesystem first so all of their metadata files can be read at once
+    QVector<SnapshotMeta> metas;
+    const QStringList btrfsFilesystems = m_btrfs->filesystems().keys();
     for (const QString &uuid : btrfsFilesystems) {
         // We need to ensure the root is mounted and get the mountpoint
         QString mountpoint = m_btrfs->mountRoot(uuid);
@@ -260,52 +448,96 @@ void Snapper::loadSubvols()
                 continue;
             }
 
-            SnapperSubvolume snapperSubvol;
+            // The snapper XML sits next to the snapshot subvolume
+            const QString end = "snapshot";
+            const QString filename = subvol.subvolName.left(subvol.subvolName.length() - end.length()) + "info.xml";
 
-            snapperSubvol.uuid = uuid;
-            snapperSubvol.subvolid = subvol.id;
-            snapperSubvol.subvol = subvol.subvolName;
+            metas.append({uuid, subvol.id, subvol.subvolName, QDir::cleanPath(mountpoint + QDir::separator() + filename), 0, {}});
+        }
+    }
 
-            // It is a snapshot so now we parse it and read the snapper XML
-            const QString end = "snapshot";
-            QString filename = snapperSubvol.subvol.left(snapperSubvol.subvol.length() - end.length()) + "info.xml";
+    // Parsing the XML is independent for each snapshot so it is spread over a bounded pool, small batches stay on one thread
+    QThreadPool pool;
+    pool.setMaxThreadCount(std::clamp(static_cast<int>(metas.count() / 64), 1, QThread::idealThreadCount()));
+    // A file that hasn't been modified since it was cached only costs a stat
+    const QHash<QString, SnapperMetaCacheEntry> &cache = m_metaCache;
+    QtConcurrent::blockingMap(&pool, metas, [&cache](SnapshotMeta &meta) {
+        meta.modified = QFileInfo(meta.filename).lastModified().toMSecsSinceEpoch();
+        const auto cached = cache.constFind(meta.filename);
+        if (cached != cache.cend() && cached->modified == meta.modified) {
+            meta.snapshot = cached->snapshot;
+        } else {
+            meta.snapshot = readSnapperMeta(meta.filename);
+        }
+    });
+
+    // Only the files that still exist are kept for the next load
+    m_metaCache.clear();
+    m_metaCache.reserve(metas.count());
+    for (const SnapshotMeta &meta : std::as_const(metas)) {
+        if (meta.snapshot.number != 0) {
+            m_metaCache.insert(meta.filename, {meta.modified, meta.snapshot});
+        }
+    }
 
-            filename = QDir::cleanPath(mountpoint + QDir::separator() + filename);
+    // The snapshots for each target subvolume, keyed by the filesystem UUID followed by the target name
+    QMap<QString, QVector<SnapperSnapshot>> targetSnapshots;
 
-            SnapperSnapshot snap = readSnapperMeta(filename);
+    for (const SnapshotMeta &meta : std::as_const(metas)) {
+        const SnapperSnapshot &snap = meta.snapshot;
 
-            if (snap.number == 0) {
-                continue;
-            }
+        if (snap.number == 0) {
+            continue;
+        }
+
+        SnapperSubvolume snapperSubvol;
 
-            snapperSubvol.desc = snap.desc;
-            snapperSubvol.time = snap.time;
-            snapperSubvol.snapshotNum = snap.number;
-            snapperSubvol.type = snap.type;
+        snapperSubvol.uuid = meta.uuid;
+        snapperSubvol.subvolid = meta.subvolId;
+        snapperSubvol.subvol = meta.subvolName;
+        snapperSubvol.desc = snap.desc;
+        snapperSubvol.time = snap.time;
+        snapperSubvol.snapshotNum = snap.number;
+        snapperSubvol.type = snap.type;
 
-            const SubvolResult subvolResultSnapshot = findSnapshotSubvolume(snapperSubvol.subvol);
-            if (!subvolResultSnapshot.success) {
+        const SubvolResult subvolResultSnapshot = findSnapshotSubvolume(snapperSubvol.subvol);
+        if (!subvolResultSnapshot.success) {
+            continue;
+        }
+
+        // Check the map for the target subvolume
+        const SubvolResult subvolResultTarget = findTargetSubvol(subvolResultSnapshot.name, meta.uuid);
+        QString targetSubvol = subvolResultTarget.name;
+        // If it failed, it may mean the the map isn't loaded yet for the nested subvolumes
+        if (!subvolResultTarget.success) {
+            if (subvolResultSnapshot.name.endsWith(DEFAULT_SNAP_PATH) || subvolResultSnapshot.name == DEFAULT_SNAP_SUBVOL) {
+                const uint64_t targetSubvolId = m_btrfs->subvolId(meta.uuid, subvolResultSnapshot.name);
+                const uint64_t parentId = m_btrfs->subvolParent(meta.uuid, targetSubvolId);
+                targetSubvol = m_btrfs->subvolumeName(meta.uuid, parentId).name;
+            } else {
                 continue;
             }
+        }
 
-            // Check the map for the target subvolume
-            const SubvolResult subvolResultTarget = findTargetSubvol(subvolResultSnapshot.name, uuid);
-            QString targetSubvol = subvolResultTarget.name;
-            // If it failed, it may mean the the map isn't loaded yet for the nested subvolumes
-            if (!subvolResultTarget.success) {
-                if (subvolResultSnapshot.name.endsWith(DEFAULT_SNAP_PATH) || subvolResultSnapshot.name == DEFAULT_SNAP_SUBVOL) {
-                    const uint64_t targetSubvolId = m_btrfs->subvolId(uuid, subvolResultSnapshot.name);
-                    const uint64_t parentId = m_btrfs->subvolParent(uuid, targetSubvolId);
-                    targetSubvol = m_btrfs->subvolumeName(uuid, parentId).name;
-                } else {
-                    continue;
-                }
-            }
+        m_subvols[targetSubvol].append(snapperSubvol);
+        targetSnapshots[meta.uuid + targetSubvol].append(snap);
+    }
+    createSubvolMap();
 
-            m_subvols[targetSubvol].append(snapperSubvol);
+    // The snapshot list of each config comes from the same metadata, configs without a match are left for load() to ask snapper
+    for (auto it = m_configs.cbegin(); it != m_configs.cend(); ++it) {
+        const QString subvolume = it->subvolume();
+        const QString uuid = MountTable::instance().containingUuid(subvolume);
+        const SubvolResult target = m_btrfs->subvolumeName(subvolume);
+        if (uuid.isEmpty() || !target.success || !targetSnapshots.contains(uuid + target.name)) {
+            continue;
         }
+
+        QVector<SnapperSnapshot> snapshots = targetSnapshots.value(uuid + target.name);
+        std::sort(snapshots.begin(), snapshots.end(),
+                  [](const SnapperSnapshot &a, const SnapperSnapshot &b) { return a.number < b.number; });
+        m_snapshots[it.key()] = snapshots;
     }
-    createSubvolMap();
 }
 
 SnapperSnapshot Snapper::readSnapperMeta(const QString &filename)
@@ -363,36 +595,40 @@ bool Snapper::restoreFile(const QString &sourcePath, const QString &destPath) co
     return true;
 }
 
-SnapperResult Snapper::setCleanupAlgorithm(const QString &config, const uint number, const QString &cleanupAlg) const
+QFuture<SnapperResult> Snapper::setCleanupAlgorithm(const QString &config, const uint number, const QString &cleanupAlg) const
 {
-    return runSnapper("modify -c \"" + cleanupAlg + "\" " + QString::number(number), config);
+    return runWithFallback([this, config, number, cleanupAlg]() { return m_dbus->setSnapshot(config, number, std::nullopt, cleanupAlg); },
+                           "modify -c \"" + cleanupAlg + "\" " + QString::number(number), config);
 }
 
-SnapperResult Snapper::setConfig(const QString &name, const Config &configMap)
+QFuture<SnapperResult> Snapper::setConfig(const QString &name, const Config &configMap)
 {
-    SnapperResult result;
-
     const QStringList keys = configMap.keys();
 
     QString command;
+    QMap<QString, QString> raw;
     for (const QString &key : keys) {
         if (configMap[key].isEmpty()) {
             continue;
         }
 
         command += " " + key + "=" + configMap[key];
+        raw.insert(key, configMap[key]);
     }
 
     if (command.isEmpty()) {
-        result.exitCode = -1;
-        result.outputList = QStringList() << tr("Failed to set config");
-    } else {
-        result = runSnapper("set-config" + command, name);
+        QPromise<SnapperResult> promise;
+        promise.start();
+        promise.addResult(SnapperResult{-1, QStringList() << tr("Failed to set config")});
+        promise.finish();
+        return promise.future();
     }
 
-    loadConfig(name);
-
-    return result;
+    return runWithFallback([this, name, raw]() { return m_dbus->setConfig(name, raw); }, "set-config" + command, name)
+        .then(this, [this, name](const SnapperResult &result) {
+            loadConfig(name);
+            return result;
+        });
 }
 
 QVector<SnapperSnapshot> Snapper::snapshots(const QString &config)
@@ -419,31 +655,174 @@ QVector<SnapperSubvolume> Snapper::subvols(const QString &config)
  *
  */
 
-SnapperResult Snapper::runSnapper(const QString &command, const QString &name) const
+QVector<SnapperSnapshot> Snapper::listSnapshots(const QString &name)
 {
-    Result result;
-    SnapperResult snapperResult;
+    QVector<SnapperSnapshot> snapshots;
 
-    if (name.isEmpty()) {
-        result = System::runCmd(m_snapperCommand + " --machine-readable csv -q " + command, true);
+    QVector<SnapperDBusSnapshot> dbusSnapshots;
+    if (isDBusConnected() && m_dbus->listSnapshots(name, dbusSnapshots).isSuccess) {
+        static const QStringList types = {QStringLiteral("single"), QStringLiteral("pre"), QStringLiteral("post")};
+        for (const SnapperDBusSnapshot &dbusSnapshot : std::as_const(dbusSnapshots)) {
+            // Snapshot 0 is not a real snapshot
+            if (dbusSnapshot.number == 0) {
+                continue;
+            }
+
+            snapshots.append({dbusSnapshot.number, QDateTime::fromSecsSinceEpoch(dbusSnapshot.date), dbusSnapshot.description,
+                              types.value(dbusSnapshot.type), dbusSnapshot.cleanup});
+        }
+
+        // An empty root config may mean we are booted off a snapshot which needs the special handling below
+        if (!snapshots.isEmpty() || name != "root") {
+            return snapshots;
+        }
+    }
+
+    SnapperResult listResult;
+
+    // The root needs special handling because we may be booted off a snapshot
+    if (name == "root") {
+        listResult = runSnapper("list --columns number,date,description,type,cleanup");
+
+        if (listResult.exitCode != 0) {
+            return snapshots;
+        }
+
+        if (listResult.outputList.isEmpty()) {
+            // This means that either there are no snapshots or the root is mounted on non-btrfs filesystem like an overlayfs
+            // Let's check the latter case first
+            if (!m_btrfs->subvolumeName(DEFAULT_SNAP_SUBVOL).success) {
+                // This probably means there are just no snapshots or we are using a nested subvol in another place
+                return snapshots;
+            }
+
+            // Now we need to find out where the snapshots are actually stored
+            const uint64_t parentId = m_btrfs->subvolParent(DEFAULT_SNAP_SUBVOL);
+
+            // It shouldn't be possible for the parent to not exist but we check anyway
+            if (parentId == 0) {
+                return snapshots;
+            }
+
+            const QString uuid = System::findUuid(DEFAULT_SNAP_PATH);
+
+            // Make sure the root of the partition is mounted
+            QString mountpoint = m_btrfs->mountRoot(uuid);
+            if (mountpoint.isEmpty()) {
+                return snapshots;
+            }
+
+            const QString parentName = m_btrfs->subvolumeName(uuid, parentId).name;
+
+            listResult = runSnapper("--no-dbus -r " + QDir::cleanPath(mountpoint + QDir::separator() + parentName) +
+                                    " list --columns number,date,description,type");
+            if (listResult.exitCode != 0 || listResult.outputList.isEmpty()) {
+                // If this is still empty, give up
+                return snapshots;
+            }
+        }
     } else {
-        result = System::runCmd(m_snapperCommand + " -c " + name + " --machine-readable csv -q " + command, true);
+        listResult = runSnapper("list --columns number,date,description,type,cleanup", name);
+        if (listResult.exitCode != 0 || listResult.outputList.isEmpty()) {
+            return snapshots;
+        }
     }
 
-    snapperResult.exitCode = result.exitCode;
+    for (const QString &snap : std::as_const(listResult.outputList)) {
+        // Parse `complex` CSV where ',' and '"' in the description are possible
+        QStringList cols = parseCsvLine(snap);
 
-    if (result.exitCode != 0 || result.output.isEmpty()) {
-        snapperResult.outputList = QStringList() << result.output;
+        const uint number = cols.at(0).toUInt();
+        // Snapshot 0 is not a real snapshot
+        if (number == 0) {
+            continue;
+        }
+
+        snapshots.append({number, QDateTime::fromString(cols.at(1), Qt::ISODate), cols.at(2), cols.at(3), cols.value(4)});
+    }
+
+    return snapshots;
+}
+
+void Snapper::reloadSnapshots(const QString &name)
+{
+    const QVector<SnapperSnapshot> snapshots = listSnapshots(name);
+    if (snapshots.isEmpty()) {
+        m_snapshots.remove(name);
     } else {
-        QStringList outputList = result.output.split('\n');
+        m_snapshots[name] = snapshots;
+    }
 
-        // Remove the header
-        outputList.removeFirst();
+    // Only the filesystem holding the config needs to be read again, the subvolume of the config is often not a mountpoint itself
+    const QString uuid = MountTable::instance().containingUuid(config(name).subvolume());
+    if (uuid.isEmpty()) {
+        return;
+    }
 
-        snapperResult.outputList = outputList;
+    m_btrfs->refreshSubvols(uuid);
+    const SubvolumeMap subvols = m_btrfs->listSubvolumes(uuid);
+
+    for (auto it = m_subvols.begin(); it != m_subvols.end();) {
+        it->erase(std::remove_if(it->begin(), it->end(),
+                                 [&uuid, &subvols](const SnapperSubvolume &subvol) {
+                                     return subvol.uuid == uuid && !subvols.contains(subvol.subvolid);
+                                 }),
+                  it->end());
+
+        if (it->isEmpty()) {
+            it = m_subvols.erase(it);
+        } else {
+            ++it;
+        }
     }
+}
 
-    return snapperResult;
+SnapperResult Snapper::runSnapper(const QString &command, const QString &name) const
+{
+    if (name.isEmpty()) {
+        return toSnapperResult(System::runCmd(m_snapperCommand + " --machine-readable csv -q " + command, true));
+    } else {
+        return toSnapperResult(System::runCmd(m_snapperCommand + " -c " + name + " --machine-readable csv -q " + command, true));
+    }
+}
+
+QFuture<SnapperResult> Snapper::runSnapperAsync(const QString &command, const QString &name, std::chrono::milliseconds timeout) const
+{
+    QFuture<Result> future;
+    if (name.isEmpty()) {
+        future = System::runCmdAsync(m_snapperCommand + " --machine-readable csv -q " + command, true, timeout);
+    } else {
+        future = System::runCmdAsync(m_snapperCommand + " -c " + name + " --machine-readable csv -q " + command, true, timeout);
+    }
+
+    return future.then([](const Result &result) { return toSnapperResult(result); });
+}
+
+QFuture<SnapperResult> Snapper::runWithFallback(const std::function<QFuture<SnapperDBusStatus>()> &dbusCall, const QString &command,
+                                                const QString &name, std::chrono::milliseconds timeout) const
+{
+    if (!isDBusConnected()) {
+        return runSnapperAsync(command, name, timeout);
+    }
+
+    auto promise = std::make_shared<QPromise<SnapperResult>>();
+    promise->start();
+
+    dbusCall().then([this, promise, command, name, timeout](const SnapperDBusStatus &status) {
+        if (status.isSuccess || status.isSnapperError) {
+            promise->addResult(SnapperResult{status.isSuccess ? 0 : 1, QStringList() << status.message});
+            promise->finish();
+            return;
+        }
+
+        qWarning() << "Failed to reach snapperd, falling back to the snapper command:" << status.message;
+        runSnapperAsync(command, name, timeout).then([promise](const SnapperResult &result) {
+            promise->addResult(result);
+            promise->finish();
+        });
+    });
+
+    return promise->future();
 }
 
 bool Snapper::Config::isEmpty() const { return QMap<QString, QString>::isEmpty(); }
@@ -2,15 +2,29 @@
 #define SNAPPER_H
 
 #include <QDateTime>
+#include <QFuture>
 #include <QObject>
+#include <QSet>
 
 #include "Btrfs.h"
+#include "util/SnapperDBus.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
 
 struct SnapperResult {
     int exitCode = -1;
     QStringList outputList;
 };
 
+// The outcome of deleting several snapshots in one call
+struct SnapperDeleteResult {
+    QList<uint> deleted;
+    // The snapshots that still exist after the call, with the error reported for each of them
+    QMap<uint, QString> failed;
+};
+
 struct SnapperSnapshot {
     uint number = 0;
     QDateTime time;
@@ -19,6 +33,13 @@ struct SnapperSnapshot {
     QString cleanup;
 };
 
+// The contents of a snapper info.xml file as saved in the metadata cache
+struct SnapperMetaCacheEntry {
+    // The modification time of the file in milliseconds since the epoch
+    qint64 modified = 0;
+    SnapperSnapshot snapshot;
+};
+
 struct SnapperSubvolume {
     QString subvol;
     uint64_t subvolid = 0;
@@ -78,7 +99,31 @@ class Snapper : public QObject {
         friend class Snapper;
     };
 
-    Snapper(Btrfs *btrfs, QString snapperCommand, QObject *parent = nullptr);
+    // Everything load() reads, used to hand the results of a load over to another instance
+    struct LoadedData {
+        QMap<QString, Config> configs;
+        QHash<QString, SnapperMetaCacheEntry> metaCache;
+        QMap<QString, QVector<SnapperSnapshot>> snapshots;
+        QMap<QString, QVector<SnapperSubvolume>> subvols;
+        QMap<QString, MapSubvol> subvolMap;
+    };
+
+    /**
+     * @brief Creates an instance that loads the snapper data right away unless @p initialLoad is InitialLoad::Later
+     *
+     * A deferred instance holds no data until load() or setLoadedData() is called and doesn't write the metadata cache before
+     * then either.
+     */
+    Snapper(Btrfs *btrfs, QString snapperCommand, InitialLoad initialLoad = InitialLoad::Now, QObject *parent = nullptr);
+
+    ~Snapper();
+
+    /**
+     * @brief Returns the cached metadata of the snapshots directly inside @p snapshotDir, such as /.snapshots
+     * @param snapshotDir - The absolute path to the directory that holds the numbered snapshot directories
+     * @return A QMap of the snapshot number to its metadata, empty if nothing under @p snapshotDir has been loaded
+     */
+    QMap<uint, SnapperSnapshot> cachedSnapshots(const QString &snapshotDir) const;
 
     /**
      * @brief Gets the list of configuration settings for a given config
@@ -99,50 +144,55 @@ class Snapper : public QObject {
      * @brief Creates a new Snapper config
      * @param name - The name of the new config
      * @param path - The absolute path to the mountpoint of the subvolume that will be snapshotted by the config
+     * @return A QFuture that finishes with the result of the snapper command
      */
-    SnapperResult createConfig(const QString &name, const QString &path) const { return runSnapper("create-config " + path, name); }
+    QFuture<SnapperResult> createConfig(const QString &name, const QString &path) const;
 
     /**
      * @brief Creates a new manual snapshot with the given description
      * @param name - The name of the Snapper config
      * @param description - A string holding the description to be saved
+     * @return A QFuture that finishes with the result of the snapper command
      */
-    SnapperResult createSnapshot(const QString &name, const QString &desc) const { return runSnapper("create -d '" + desc + "'", name); }
+    QFuture<SnapperResult> createSnapshot(const QString &name, const QString &desc) const;
 
     /**
      * @brief Reads the list of subvols to create mapping between the snapshot subvolume and the source subvolume
      */
     void createSubvolMap();
 
+    /**
+     * @brief Drops the D-Bus connection so everything goes through the snapper command regardless of the settings
+     */
+    void disableDBus() { m_dbus.reset(); }
+
     /**
      * @brief Deletes the given snapper config
      * @param name - The name of the Snapper config to delete
+     * @return A QFuture that finishes with the result of the snapper command
      */
-    SnapperResult deleteConfig(const QString &name) const { return runSnapper("delete-config", name); }
+    QFuture<SnapperResult> deleteConfig(const QString &name) const;
 
     /**
-     * @brief Deletes a given Snapper snapshot
-     * @param name - The name of the config that contains the snapshot to delete
-     * @param num - The number of the snapshot to delete
+     * @brief Deletes several snapshots from a config with a single snapper call
+     *
+     * Consecutive numbers are collapsed into ranges so the command line stays short.  Once the call finishes, the snapshots
+     * and snapshot subvolumes of @p name are reloaded, the other configs are left untouched.
+     *
+     * @param name - The name of the config that contains the snapshots to delete
+     * @param numbers - The numbers of the snapshots to delete
+     * @return A QFuture that finishes with the snapshots that were deleted and the ones that failed
      */
-    SnapperResult deleteSnapshot(const QString &name, const int num) const { return runSnapper("delete " + QString::number(num), name); }
+    QFuture<SnapperDeleteResult> deleteSnapshots(const QString &name, const QSet<uint> &numbers);
 
     /**
      * @brief Changes the description of a given Snapper snapshot
      * @param name - The name of the config that contains the snapshot to change
      * @param num - The number of the snapshot to change
      * @param desc - The new description for the snapshot
+     * @return A QFuture that finishes with the result of the snapper command
      */
-    SnapperResult changeSnapshotDescription(const QString &name, const int num, const QString &desc) const
-    {
-        QString asciiDesc = desc.toLatin1(); // Ensure only ASCII chars
-        // Snapper does not recommend using any non ASCII chars (it's ok if you use utf-8 everywhere, but better safe than sorry)
-
-        // Escape Single quotes since they are used to delimit the description
-        asciiDesc.replace("'", "'\\''");
-
-        return runSnapper("modify --description '" + asciiDesc + "' " + QString::number(num), name);
-    }
+    QFuture<SnapperResult> changeSnapshotDescription(const QString &name, const int num, const QString &desc) const;
 
     /**
      * @brief Finds the subvolume that is used by snapper to hold the snapshots for @p subvol
@@ -176,6 +226,16 @@ class Snapper : public QObject {
      */
     void load();
 
+    /**
+     * @brief Returns a copy of everything read by the last load
+     */
+    LoadedData loadedData() const;
+
+    /**
+     * @brief Replaces the snapper data with @p data loaded by another instance
+     */
+    void setLoadedData(const LoadedData &data);
+
     /**
      * @brief loads the data for a single Snapper config
      * @param name - A QString that holds the name of the config to load
@@ -206,16 +266,17 @@ class Snapper : public QObject {
     /**
      * @brief setCleanupAlgorithm changes the cleanup algorithm for a snapshot
      * @param cleanupAlg The cleanup algorithm to use
-     * @return The result of the snapper command
+     * @return A QFuture that finishes with the result of the snapper command
      */
-    SnapperResult setCleanupAlgorithm(const QString &config, const uint number, const QString &cleanupAlg) const;
+    QFuture<SnapperResult> setCleanupAlgorithm(const QString &config, const uint number, const QString &cleanupAlg) const;
 
     /**
      * @brief Updates the settings for a given Snapper config described by @p name
      * @param name - The name of the Snapper config to be updated
      * @param configMap - A QMap of name/value pairs that holds the settings to update
+     * @return A QFuture that finishes with the result of the snapper command once the config has been reloaded
      */
-    SnapperResult setConfig(const QString &name, const Config &configMap);
+    QFuture<SnapperResult> setConfig(const QString &name, const Config &configMap);
 
     /**
      * @brief Returns a list of metadata for each snapshot in @p config
@@ -224,6 +285,11 @@ class Snapper : public QObject {
      */
     QVector<SnapperSnapshot> snapshots(const QString &config);
 
+    /**
+     * @brief Returns the absolute path to the snapper command
+     */
+    const QString &snapperCommand() const { return m_snapperCommand; }
+
     /**
      * @brief Gets the list of targets where a Snapper snapshot can be restored to
      * @return A QStringList that is a list of paths relative to the root of the Btrfs filesystem
@@ -238,11 +304,27 @@ class Snapper : public QObject {
     QVector<SnapperSubvolume> subvols(const QString &config);
 
   private:
+    /**
+     * @brief Returns true when snapperd is used directly over D-Bus instead of through the snapper command
+     */
+    bool isDBusConnected() const { return m_dbus != nullptr && m_dbus->isConnected(); }
+
+    /**
+     * @brief Reads the snapshots in config @p name, over D-Bus when possible
+     * @return A QVector of the snapshots, excluding snapshot 0, or an empty QVector on failure
+     */
+    QVector<SnapperSnapshot> listSnapshots(const QString &name);
+
     /**
      * @brief Loads the subvol map from the config file and manually mounted /.snapshots
      */
     void loadSubvolMap();
 
+    /**
+     * @brief Reloads the snapshots of config @p name and drops the snapshot subvolumes that no longer exist on its filesystem
+     */
+    void reloadSnapshots(const QString &name);
+
     Btrfs *m_btrfs = nullptr;
     // The outer map is keyed with the config name, the inner map is the name, value pairs of the configuration settings
     QMap<QString, Config> m_configs;
@@ -250,6 +332,15 @@ class Snapper : public QObject {
     // The absolute path to the snapper command
     QString m_snapperCommand;
 
+    // The connection to snapperd, this is null when D-Bus has been disabled in the settings
+    std::unique_ptr<SnapperDBus> m_dbus;
+
+    // The parsed info.xml files from the last load or from the metadata cache, the key is the absolute path of the file
+    QHash<QString, SnapperMetaCacheEntry> m_metaCache;
+
+    // False until the data has been loaded or handed over, the metadata cache is only written after that
+    bool m_isLoaded = false;
+
     // A map of snapper snapshots.  The key is the snapper config name
     QMap<QString, QVector<SnapperSnapshot>> m_snapshots;
 
@@ -260,6 +351,23 @@ class Snapper : public QObject {
     QMap<QString, MapSubvol> m_subvolMap;
 
     SnapperResult runSnapper(const QString &command, const QString &name = "") const;
+
+    /**
+     * @brief The asynchronous version of runSnapper, the command runs without blocking the calling thread
+     * @param timeout - How long the command may run before it is killed
+     */
+    QFuture<SnapperResult> runSnapperAsync(const QString &command, const QString &name = "",
+                                           std::chrono::milliseconds timeout = std::chrono::minutes(1)) const;
+
+    /**
+     * @brief Runs @p dbusCall and falls back to running @p command with the snapper command if snapperd can't be reached
+     *
+     * Errors reported by snapperd itself are returned as is since the snapper command would fail the same way.
+     *
+     * @param timeout - How long the snapper command may run before it is killed
+     */
+    QFuture<SnapperResult> runWithFallback(const std::function<QFuture<SnapperDBusStatus>()> &dbusCall, const QString &command,
+                                           const QString &name, std::chrono::milliseconds timeout = std::chrono::minutes(1)) const;
 };
 
 #endif // SNAPPER_H
@@ -0,0 +1,212 @@
+#include "util/SnapperDBus.h"
+
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusReply>
+#include <QPromise>
+
+#include <memory>
+
+namespace {
+
+constexpr const char *SNAPPER_INTERFACE = "org.opensuse.Snapper";
+constexpr const char *SNAPPER_PATH = "/org/opensuse/Snapper";
+
+// Deleting or creating snapshots can take much longer than the default D-Bus timeout on a busy filesystem
+constexpr int MUTATING_CALL_TIMEOUT_MS = 10 * 60 * 1000;
+
+/**
+ * @brief Converts a D-Bus error into a SnapperDBusStatus
+ *
+ * snapperd reports its own failures with error names like "error.unknown_config", everything else is a problem reaching it.
+ */
+SnapperDBusStatus errorStatus(const QDBusError &error)
+{
+    SnapperDBusStatus status;
+    status.isSnapperError = error.name().startsWith(QStringLiteral("error."));
+    status.message = error.message().isEmpty() ? error.name() : error.name() + QStringLiteral(": ") + error.message();
+    return status;
+}
+
+} // namespace
+
+QDBusArgument &operator<<(QDBusArgument &argument, const SnapperDBusConfig &config)
+{
+    argument.beginStructure();
+    argument << config.name << config.subvolume << config.raw;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, SnapperDBusConfig &config)
+{
+    argument.beginStructure();
+    argument >> config.name >> config.subvolume >> config.raw;
+    argument.endStructure();
+    return argument;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const SnapperDBusSnapshot &snapshot)
+{
+    argument.beginStructure();
+    argument << snapshot.number << snapshot.type << snapshot.preNumber << snapshot.date << snapshot.uid << snapshot.description
+             << snapshot.cleanup << snapshot.userdata;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, SnapperDBusSnapshot &snapshot)
+{
+    argument.beginStructure();
+    argument >> snapshot.number >> snapshot.type >> snapshot.preNumber >> snapshot.date >> snapshot.uid >> snapshot.description >>
+        snapshot.cleanup >> snapshot.userdata;
+    argument.endStructure();
+    return argument;
+}
+
+SnapperDBus::SnapperDBus(const QString &address, const QString &service)
+    : m_connection(address.isEmpty() ? QDBusConnection::systemBus() : QDBusConnection::connectToBus(address, QStringLiteral("snapper"))),
+      m_service(service)
+{
+    qDBusRegisterMetaType<QList<uint>>();
+    qDBusRegisterMetaType<QMap<QString, QString>>();
+    qDBusRegisterMetaType<SnapperDBusConfig>();
+    qDBusRegisterMetaType<QList<SnapperDBusConfig>>();
+    qDBusRegisterMetaType<SnapperDBusSnapshot>();
+    qDBusRegisterMetaType<QList<SnapperDBusSnapshot>>();
+}
+
+QFuture<SnapperDBusStatus> SnapperDBus::createConfig(const QString &name, const QString &subvolume) const
+{
+    QDBusMessage message = createCall(QStringLiteral("CreateConfig"));
+    message << name << subvolume << QStringLiteral("btrfs") << QStringLiteral("default");
+    return asyncCall(message);
+}
+
+QFuture<SnapperDBusStatus> SnapperDBus::createSingleSnapshot(const QString &name, const QString &description, const QString &cleanup) const
+{
+    QDBusMessage message = createCall(QStringLiteral("CreateSingleSnapshot"));
+    message << name << description << cleanup << QVariant::fromValue(QMap<QString, QString>());
+    return asyncCall(message);
+}
+
+QFuture<SnapperDBusStatus> SnapperDBus::deleteConfig(const QString &name) const
+{
+    QDBusMessage message = createCall(QStringLiteral("DeleteConfig"));
+    message << name;
+    return asyncCall(message);
+}
+
+QFuture<SnapperDBusStatus> SnapperDBus::deleteSnapshots(const QString &name, const QList<uint> &numbers) const
+{
+    QDBusMessage message = createCall(QStringLiteral("DeleteSnapshots"));
+    message << name << QVariant::fromValue(numbers);
+    return asyncCall(message);
+}
+
+SnapperDBusStatus SnapperDBus::getConfig(const QString &name, SnapperDBusConfig &config) const
+{
+    QDBusMessage message = createCall(QStringLiteral("GetConfig"));
+    message << name;
+
+    const QDBusReply<SnapperDBusConfig> reply = m_connection.call(message);
+    if (!reply.isValid()) {
+        return errorStatus(reply.error());
+    }
+
+    config = reply.value();
+    return {true, false, QString()};
+}
+
+SnapperDBusStatus SnapperDBus::listConfigs(QVector<SnapperDBusConfig> &configs) const
+{
+    const QDBusReply<QList<SnapperDBusConfig>> reply = m_connection.call(createCall(QStringLiteral("ListConfigs")));
+    if (!reply.isValid()) {
+        return errorStatus(reply.error());
+    }
+
+    configs = reply.value();
+    return {true, false, QString()};
+}
+
+SnapperDBusStatus SnapperDBus::listSnapshots(const QString &name, QVector<SnapperDBusSnapshot> &snapshots) const
+{
+    QDBusMessage message = createCall(QStringLiteral("ListSnapshots"));
+    message << name;
+
+    const QDBusReply<QList<SnapperDBusSnapshot>> reply = m_connection.call(message);
+    if (!reply.isValid()) {
+        return errorStatus(reply.error());
+    }
+
+    snapshots = reply.value();
+    return {true, false, QString()};
+}
+
+QFuture<SnapperDBusStatus> SnapperDBus::setConfig(const QString &name, const QMap<QString, QString> &raw) const
+{
+    QDBusMessage message = createCall(QStringLiteral("SetConfig"));
+    message << name << QVariant::fromValue(raw);
+    return asyncCall(message);
+}
+
+QFuture<SnapperDBusStatus> SnapperDBus::setSnapshot(const QString &name, uint number, const std::optional<QString> &description,
+                                                    const std::optional<QString> &cleanup) const
+{
+    auto promise = std::make_shared<QPromise<SnapperDBusStatus>>();
+    promise->start();
+
+    QDBusMessage getMessage = createCall(QStringLiteral("GetSnapshot"));
+    getMessage << name << number;
+
+    // Read the current values first so the fields that aren't being changed are written back as they were
+    auto *watcher = new QDBusPendingCallWatcher(m_connection.asyncCall(getMessage));
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished, [this, watcher, promise, name, number, description, cleanup]() {
+        watcher->deleteLater();
+
+        const QDBusPendingReply<SnapperDBusSnapshot> reply = *watcher;
+        if (reply.isError()) {
+            promise->addResult(errorStatus(reply.error()));
+            promise->finish();
+            return;
+        }
+
+        const SnapperDBusSnapshot snapshot = reply.value();
+        QDBusMessage setMessage = createCall(QStringLiteral("SetSnapshot"));
+        setMessage << name << number << description.value_or(snapshot.description) << cleanup.value_or(snapshot.cleanup)
+                   << QVariant::fromValue(snapshot.userdata);
+        asyncCall(setMessage).then([promise](const SnapperDBusStatus &status) {
+            promise->addResult(status);
+            promise->finish();
+        });
+    });
+
+    return promise->future();
+}
+
+QFuture<SnapperDBusStatus> SnapperDBus::asyncCall(const QDBusMessage &message) const
+{
+    auto promise = std::make_shared<QPromise<SnapperDBusStatus>>();
+    promise->start();
+
+    auto *watcher = new QDBusPendingCallWatcher(m_connection.asyncCall(message, MUTATING_CALL_TIMEOUT_MS));
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished, [watcher, promise]() {
+        watcher->deleteLater();
+
+        if (watcher->isError()) {
+            promise->addResult(errorStatus(watcher->error()));
+        } else {
+            promise->addResult({true, false, QString()});
+        }
+        promise->finish();
+    });
+
+    return promise->future();
+}
+
+QDBusMessage SnapperDBus::createCall(const QString &method) const
+{
+    return QDBusMessage::createMethodCall(m_service, QString::fromLatin1(SNAPPER_PATH), QString::fromLatin1(SNAPPER_INTERFACE), method);
+}
@@ -0,0 +1,146 @@
+#ifndef SNAPPERDBUS_H
+#define SNAPPERDBUS_H
+
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QFuture>
+#include <QMap>
+#include <QObject>
+
+#include <optional>
+
+// A config as returned by the ListConfigs and GetConfig methods of snapperd
+struct SnapperDBusConfig {
+    QString name;
+    QString subvolume;
+    QMap<QString, QString> raw;
+};
+Q_DECLARE_METATYPE(SnapperDBusConfig)
+
+// A snapshot as returned by the ListSnapshots and GetSnapshot methods of snapperd
+struct SnapperDBusSnapshot {
+    uint number = 0;
+    // 0 is single, 1 is pre and 2 is post
+    quint16 type = 0;
+    uint preNumber = 0;
+    // Seconds since the epoch
+    qint64 date = 0;
+    uint uid = 0;
+    QString description;
+    QString cleanup;
+    QMap<QString, QString> userdata;
+};
+Q_DECLARE_METATYPE(SnapperDBusSnapshot)
+
+// The outcome of a call to snapperd
+struct SnapperDBusStatus {
+    bool isSuccess = false;
+    // True when snapperd itself rejected the call.  When false, snapperd couldn't be reached and the CLI might still work.
+    bool isSnapperError = false;
+    QString message;
+};
+
+QDBusArgument &operator<<(QDBusArgument &argument, const SnapperDBusConfig &config);
+const QDBusArgument &operator>>(const QDBusArgument &argument, SnapperDBusConfig &config);
+QDBusArgument &operator<<(QDBusArgument &argument, const SnapperDBusSnapshot &snapshot);
+const QDBusArgument &operator>>(const QDBusArgument &argument, SnapperDBusSnapshot &snapshot);
+
+/**
+ * @brief The SnapperDBus class calls the org.opensuse.Snapper D-Bus API provided by snapperd.
+ *
+ * The read-only calls block while the mutating calls return a QFuture that finishes on the thread that made the call.  The bus
+ * and the service name can be changed so the class can be pointed at a mock service.
+ */
+class SnapperDBus {
+  public:
+    /**
+     * @brief Connects to snapperd
+     * @param address - The address of the bus to use, the system bus is used when this is empty
+     * @param service - The name snapperd is registered under on the bus
+     */
+    SnapperDBus(const QString &address, const QString &service);
+
+    /**
+     * @brief Creates a new config for @p subvolume using the default template
+     */
+    QFuture<SnapperDBusStatus> createConfig(const QString &name, const QString &subvolume) const;
+
+    /**
+     * @brief Creates a new single snapshot in config @p name
+     * @param name - The name of the config
+     * @param description - The description of the snapshot
+     * @param cleanup - The cleanup algorithm for the snapshot, an empty string means the snapshot is never cleaned up
+     */
+    QFuture<SnapperDBusStatus> createSingleSnapshot(const QString &name, const QString &description, const QString &cleanup) const;
+
+    /**
+     * @brief Deletes the config @p name
+     */
+    QFuture<SnapperDBusStatus> deleteConfig(const QString &name) const;
+
+    /**
+     * @brief Deletes the snapshots in @p numbers from config @p name in a single call
+     */
+    QFuture<SnapperDBusStatus> deleteSnapshots(const QString &name, const QList<uint> &numbers) const;
+
+    /**
+     * @brief Reads the settings of a single config
+     * @param name - The name of the config
+     * @param config - Set to the config on success
+     */
+    SnapperDBusStatus getConfig(const QString &name, SnapperDBusConfig &config) const;
+
+    /**
+     * @brief Returns true if the bus connection was established
+     */
+    bool isConnected() const { return m_connection.isConnected(); }
+
+    /**
+     * @brief Reads the list of configs
+     * @param configs - Set to the configs on success
+     */
+    SnapperDBusStatus listConfigs(QVector<SnapperDBusConfig> &configs) const;
+
+    /**
+     * @brief Reads the list of snapshots in a config
+     * @param name - The name of the config
+     * @param snapshots - Set to the snapshots on success, this includes the "current" snapshot 0
+     */
+    SnapperDBusStatus listSnapshots(const QString &name, QVector<SnapperDBusSnapshot> &snapshots) const;
+
+    /**
+     * @brief Changes settings of config @p name, settings that aren't in @p raw are left untouched
+     */
+    QFuture<SnapperDBusStatus> setConfig(const QString &name, const QMap<QString, QString> &raw) const;
+
+    /**
+     * @brief Changes the description and/or cleanup algorithm of a snapshot
+     *
+     * snapperd replaces all the snapshot fields at once so the current values are read first and only the fields that are set here
+     * are changed.
+     *
+     * @param name - The name of the config
+     * @param number - The number of the snapshot
+     * @param description - The new description or std::nullopt to keep the current one
+     * @param cleanup - The new cleanup algorithm or std::nullopt to keep the current one
+     */
+    QFuture<SnapperDBusStatus> setSnapshot(const QString &name, uint number, const std::optional<QString> &description,
+                                           const std::optional<QString> &cleanup) const;
+
+  private:
+    /**
+     * @brief Sends @p message without waiting for the reply
+     * @return A QFuture that finishes when snapperd replies
+     */
+    QFuture<SnapperDBusStatus> asyncCall(const QDBusMessage &message) const;
+
+    /**
+     * @brief Creates a method call message for the snapper interface
+     */
+    QDBusMessage createCall(const QString &method) const;
+
+    QDBusConnection m_connection;
+    QString m_service;
+};
+
+#endif // SNAPPERDBUS_H
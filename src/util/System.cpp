@@ -1,9 +1,15 @@
 #include "System.h"
+#include "util/MountTable.h"
+#include "util/Tracer.h"
 
 #include <QFile>
+#include <QFutureWatcher>
 #include <QProcess>
+#include <QPromise>
 #include <QRegularExpression>
 #include <QTextStream>
+#include <QTimer>
+#include <memory>
 #include <unistd.h>
 
 bool System::checkRootUid() { return geteuid() == 0; }
@@ -35,6 +41,8 @@ QStringList System::findEnabledUnits()
     return serviceList;
 }
 
+QString System::findUuid(const QString path) { return MountTable::instance().uuid(path); }
+
 bool System::hasSystemd()
 {
     // /proc/1/comm contains the command use to run the init system
@@ -79,6 +87,7 @@ Result System::runCmd(const QString &cmd, bool includeStderr, milliseconds timeo
 Result System::runCmd(const QString &cmd, const QStringList &args, bool includeStderr, milliseconds timeout)
 {
     QProcess proc;
+    const qint64 start = Tracer::instance().timestamp();
 
     if (includeStderr)
         proc.setProcessChannelMode(QProcess::MergedChannels);
@@ -86,7 +95,79 @@ Result System::runCmd(const QString &cmd, const QStringList &args, bool includeS
     proc.start(cmd, args);
 
     proc.waitForFinished(static_cast<int>(timeout.count()));
-    return {proc.exitCode(), proc.readAllStandardOutput().trimmed()};
+    const QByteArray output = proc.readAllStandardOutput();
+    Tracer::instance().recordCommand(cmd, args, start, proc.exitCode(), output.size());
+
+    return {proc.exitCode(), output.trimmed()};
+}
+
+QFuture<Result> System::runCmdAsync(const QString &cmd, bool includeStderr, milliseconds timeout,
+                                    const std::function<void(const QByteArray &)> &outputCallback)
+{
+    return runCmdAsync("/usr/bin/env",
+                       QStringList() << "bash"
+                                     << "-c" << cmd,
+                       includeStderr, timeout, outputCallback);
+}
+
+QFuture<Result> System::runCmdAsync(const QString &cmd, const QStringList &args, bool includeStderr, milliseconds timeout,
+                                    const std::function<void(const QByteArray &)> &outputCallback)
+{
+    // The promise and the output buffer are shared by the slots below, they are released when the process is deleted
+    auto promise = std::make_shared<QPromise<Result>>();
+    auto output = std::make_shared<QByteArray>();
+    QFuture<Result> future = promise->future();
+    promise->start();
+    const qint64 start = Tracer::instance().timestamp();
+
+    auto *proc = new QProcess;
+
+    if (includeStderr) {
+        proc->setProcessChannelMode(QProcess::MergedChannels);
+    }
+
+    QObject::connect(proc, &QProcess::readyReadStandardOutput, proc, [proc, output, outputCallback]() {
+        const QByteArray chunk = proc->readAllStandardOutput();
+        output->append(chunk);
+        if (outputCallback) {
+            outputCallback(chunk);
+        }
+    });
+
+    QObject::connect(proc, &QProcess::finished, proc,
+                     [cmd, args, start, proc, promise, output, outputCallback](int exitCode, QProcess::ExitStatus exitStatus) {
+                         const QByteArray chunk = proc->readAllStandardOutput();
+                         output->append(chunk);
+                         if (outputCallback && !chunk.isEmpty()) {
+                             outputCallback(chunk);
+                         }
+                         Tracer::instance().recordCommand(cmd, args, start, exitCode, output->size());
+                         // A process that was killed because of a timeout or a cancel has no meaningful exit code
+                         const int resultCode = exitStatus == QProcess::NormalExit ? exitCode : -1;
+                         promise->addResult(Result{resultCode, QString::fromUtf8(output->trimmed())});
+                         promise->finish();
+                         proc->deleteLater();
+                     });
+
+    QObject::connect(proc, &QProcess::errorOccurred, proc, [cmd, args, start, proc, promise](QProcess::ProcessError error) {
+        // Every other error is followed by finished()
+        if (error == QProcess::FailedToStart) {
+            Tracer::instance().recordCommand(cmd, args, start, -1, 0);
+            promise->addResult(Result{-1, QString()});
+            promise->finish();
+            proc->deleteLater();
+        }
+    });
+
+    auto *watcher = new QFutureWatcher<Result>(proc);
+    QObject::connect(watcher, &QFutureWatcher<Result>::canceled, proc, [proc]() { proc->kill(); });
+    watcher->setFuture(future);
+
+    QTimer::singleShot(timeout, proc, [proc]() { proc->kill(); });
+
+    proc->start(cmd, args);
+
+    return future;
 }
 
 QString System::toHumanReadable(const uint64_t number)
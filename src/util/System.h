@@ -1,8 +1,10 @@
 #ifndef SYSTEM_H
 #define SYSTEM_H
 
+#include <QFuture>
 #include <QObject>
 #include <chrono>
+#include <functional>
 
 // Stores the results from runCmd
 struct Result {
@@ -45,7 +47,7 @@ class System {
      *  @return Returns a QString containing the UUID or an empty string if not found
      *
      */
-    static QString findUuid(const QString path) { return runCmd("findmnt", {"-no", "uuid", path}, false).output; }
+    static QString findUuid(const QString path);
 
     /**
      * @brief Checks if the system is running systemd
@@ -83,6 +85,34 @@ class System {
      */
     static Result runCmd(const QString &cmd, const QStringList &args, bool includeStderr, milliseconds timeout = minutes(1));
 
+    /**
+     * @brief An overloaded version of runCmdAsync which takes a string and runs it with bash -c
+     * @param cmd - The command to pass to bash -c
+     * @param includeStderr - When true stderr is included in the Result.output
+     * @param timeout - How long (in milliseconds resolution) the command should run before it is killed
+     * @param outputCallback - When set, called on the calling thread with each chunk of stdout as it arrives
+     * @return A QFuture that finishes with the Result once the command exits
+     */
+    static QFuture<Result> runCmdAsync(const QString &cmd, bool includeStderr, milliseconds timeout = minutes(1),
+                                       const std::function<void(const QByteArray &)> &outputCallback = {});
+
+    /**
+     * @brief Starts a command on the host system without waiting for it to finish
+     *
+     * The process is owned by the thread that calls this, which needs to run an event loop.  Cancelling the returned future kills
+     * the process.
+     *
+     * @param cmd - The absolute path to the binary/script to run
+     * @param args - A list of arguments for @p cmd
+     * @param includeStderr - When true stderr is included in the Result.output
+     * @param timeout - How long (in milliseconds resolution) the command should run before it is killed
+     * @param outputCallback - When set, called on the calling thread with each chunk of stdout as it arrives
+     * @return A QFuture that finishes with the Result once the command exits
+     */
+    static QFuture<Result> runCmdAsync(const QString &cmd, const QStringList &args, bool includeStderr,
+                                       milliseconds timeout = minutes(1),
+                                       const std::function<void(const QByteArray &)> &outputCallback = {});
+
     /** @brief Starts the systemd unit with the unit name of @p unit
      *
      *  Returns a Result struct from runCmd()
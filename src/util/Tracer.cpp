@@ -0,0 +1,250 @@
+#include "util/Tracer.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief Splits a shell command line into words, honoring single and double quotes
+ */
+QStringList splitShellWords(const QString &command)
+{
+    QStringList words;
+    QString word;
+    QChar quote;
+    bool inWord = false;
+
+    for (const QChar c : command) {
+        if (!quote.isNull()) {
+            if (c == quote) {
+                quote = QChar();
+            } else {
+                word.append(c);
+            }
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+            inWord = true;
+        } else if (c.isSpace()) {
+            if (inWord) {
+                words.append(word);
+                word.clear();
+                inWord = false;
+            }
+        } else {
+            word.append(c);
+            inWord = true;
+        }
+    }
+
+    if (inWord) {
+        words.append(word);
+    }
+
+    return words;
+}
+
+/**
+ * @brief Builds the key used to group commands in the summary
+ *
+ * Commands run through bash -c are split into words first.  Paths, numbers and anything with whitespace in it are replaced with
+ * placeholders so that the same operation on different subvolumes or snapshots ends up in the same group.
+ *
+ * @return The program name followed by the normalized arguments
+ */
+QString commandKey(const QString &program, const QStringList &args)
+{
+    QStringList words = QStringList() << program << args;
+    if (words.count() >= 4 && words.at(1) == QStringLiteral("bash") && words.at(2) == QStringLiteral("-c")) {
+        words = splitShellWords(words.at(3));
+    }
+
+    if (words.isEmpty()) {
+        return QString();
+    }
+
+    QStringList key = {QFileInfo(words.takeFirst()).fileName()};
+    for (const QString &word : std::as_const(words)) {
+        bool isNumber = false;
+        word.toLongLong(&isNumber);
+        if (word.startsWith('/')) {
+            key.append(QStringLiteral("<path>"));
+        } else if (isNumber) {
+            key.append(QStringLiteral("<n>"));
+        } else if (word.contains(' ')) {
+            key.append(QStringLiteral("<text>"));
+        } else {
+            key.append(word);
+        }
+    }
+
+    return key.join(' ');
+}
+
+} // namespace
+
+Tracer &Tracer::instance()
+{
+    static Tracer instance;
+    return instance;
+}
+
+Tracer::Tracer() { m_timer.start(); }
+
+Tracer::~Tracer()
+{
+    if (!m_isEnabled || m_outputPath.isEmpty()) {
+        return;
+    }
+
+    if (!write()) {
+        QTextStream(stderr) << "Failed to write trace to " << m_outputPath << Qt::endl;
+    }
+    QTextStream(stderr) << summary();
+}
+
+QVector<TraceEvent> Tracer::events(const QString &category, qint64 since) const
+{
+    QVector<TraceEvent> ret;
+
+    QMutexLocker lock(&m_mutex);
+    for (const TraceEvent &event : m_events) {
+        if (event.category == category && event.start >= since) {
+            ret.append(event);
+        }
+    }
+
+    return ret;
+}
+
+void Tracer::recordCommand(const QString &program, const QStringList &args, qint64 start, int exitCode, qint64 outputSize)
+{
+    if (!m_isEnabled) {
+        return;
+    }
+
+    QJsonObject eventArgs;
+    eventArgs.insert(QStringLiteral("command"), (QStringList() << program << args).join(' '));
+    eventArgs.insert(QStringLiteral("exitCode"), exitCode);
+    eventArgs.insert(QStringLiteral("outputBytes"), outputSize);
+    recordSpan(commandKey(program, args), QStringLiteral("process"), start, eventArgs);
+}
+
+void Tracer::recordSpan(const QString &name, const QString &category, qint64 start, const QJsonObject &args)
+{
+    if (!m_isEnabled) {
+        return;
+    }
+
+    TraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.start = start;
+    event.duration = timestamp() - start;
+    event.threadId = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    event.args = args;
+
+    QMutexLocker lock(&m_mutex);
+    m_events.append(event);
+}
+
+void Tracer::setOutputPath(const QString &path)
+{
+    QMutexLocker lock(&m_mutex);
+    m_outputPath = path;
+    if (!path.isEmpty()) {
+        m_isEnabled = true;
+    }
+}
+
+QString Tracer::summary() const
+{
+    struct Group {
+        QString name;
+        int count = 0;
+        qint64 total = 0;
+        qint64 max = 0;
+        qint64 outputSize = 0;
+    };
+
+    QHash<QString, Group> groups;
+    {
+        QMutexLocker lock(&m_mutex);
+        for (const TraceEvent &event : m_events) {
+            if (event.category != QStringLiteral("process")) {
+                continue;
+            }
+
+            Group &group = groups[event.name];
+            group.name = event.name;
+            group.count++;
+            group.total += event.duration;
+            group.max = std::max(group.max, event.duration);
+            group.outputSize += event.args.value(QStringLiteral("outputBytes")).toInteger();
+        }
+    }
+
+    QVector<Group> sorted(groups.cbegin(), groups.cend());
+    std::sort(sorted.begin(), sorted.end(), [](const Group &a, const Group &b) { return a.total > b.total; });
+
+    QString ret;
+    QTextStream stream(&ret);
+    stream << QStringLiteral("%1 %2 %3 %4 %5  %6\n")
+                  .arg(QStringLiteral("Count"), 7)
+                  .arg(QStringLiteral("Total ms"), 11)
+                  .arg(QStringLiteral("Mean ms"), 10)
+                  .arg(QStringLiteral("Max ms"), 10)
+                  .arg(QStringLiteral("Output"), 10)
+                  .arg(QStringLiteral("Command"));
+    for (const Group &group : std::as_const(sorted)) {
+        stream << QStringLiteral("%1 %2 %3 %4 %5  %6\n")
+                      .arg(group.count, 7)
+                      .arg(static_cast<double>(group.total) / 1000.0, 11, 'f', 1)
+                      .arg(static_cast<double>(group.total) / 1000.0 / group.count, 10, 'f', 1)
+                      .arg(static_cast<double>(group.max) / 1000.0, 10, 'f', 1)
+                      .arg(group.outputSize, 10)
+                      .arg(group.name);
+    }
+
+    return ret;
+}
+
+bool Tracer::write() const
+{
+    QMutexLocker lock(&m_mutex);
+
+    QJsonArray traceEvents;
+    const qint64 pid = getpid();
+    for (const TraceEvent &event : m_events) {
+        // "X" is a complete event which has both a start time and a duration
+        QJsonObject json;
+        json.insert(QStringLiteral("name"), event.name);
+        json.insert(QStringLiteral("cat"), event.category);
+        json.insert(QStringLiteral("ph"), QStringLiteral("X"));
+        json.insert(QStringLiteral("ts"), event.start);
+        json.insert(QStringLiteral("dur"), event.duration);
+        json.insert(QStringLiteral("pid"), pid);
+        json.insert(QStringLiteral("tid"), static_cast<qint64>(event.threadId));
+        json.insert(QStringLiteral("args"), event.args);
+        traceEvents.append(json);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("traceEvents"), traceEvents);
+    root.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+    QFile file(m_outputPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+
+    return file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) != -1;
+}
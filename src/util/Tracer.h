@@ -0,0 +1,125 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QMutex>
+#include <QVector>
+
+#include <atomic>
+
+// A single timed event, timestamps are in microseconds since the tracer was created
+struct TraceEvent {
+    QString name;
+    QString category;
+    qint64 start = 0;
+    qint64 duration = 0;
+    quint64 threadId = 0;
+    QJsonObject args;
+};
+
+/**
+ * @brief The Tracer class is a singleton that records how long the application spends running external commands and in each
+ * phase of startup.
+ *
+ * Recording is disabled until an output path is set or enable() is called.  When the tracer is destroyed at exit and an output
+ * path is set, the events are written to that path in the Chrome trace-event format, which can be loaded in chrome://tracing or
+ * Perfetto, and a summary of the commands is printed to stderr.
+ */
+class Tracer {
+  public:
+    /**
+     * @brief Gets a reference to the Tracer object
+     */
+    static Tracer &instance();
+
+    /**
+     * @brief Enables recording without writing a trace at exit
+     */
+    void enable() { m_isEnabled = true; }
+
+    /**
+     * @brief Returns a copy of the recorded events
+     * @param category - Only events in this category are returned
+     * @param since - Only events that began at or after this timestamp() are returned
+     */
+    QVector<TraceEvent> events(const QString &category, qint64 since = 0) const;
+
+    /**
+     * @brief Returns true when events are being recorded
+     */
+    bool isEnabled() const { return m_isEnabled; }
+
+    /**
+     * @brief Records an external command that has finished
+     * @param program - The program that was run
+     * @param args - The arguments passed to @p program
+     * @param start - The value of timestamp() when the command was started
+     * @param exitCode - The exit code of the command
+     * @param outputSize - The number of bytes the command wrote to its output channels
+     */
+    void recordCommand(const QString &program, const QStringList &args, qint64 start, int exitCode, qint64 outputSize);
+
+    /**
+     * @brief Records an arbitrary span of time
+     * @param name - The name shown for the span
+     * @param category - The category of the span, used for filtering in the trace viewer
+     * @param start - The value of timestamp() when the span began
+     * @param args - Any additional data to attach to the span
+     */
+    void recordSpan(const QString &name, const QString &category, qint64 start, const QJsonObject &args = QJsonObject());
+
+    /**
+     * @brief Enables recording and sets the file the trace is written to at exit
+     * @param path - The path of the JSON file to write
+     */
+    void setOutputPath(const QString &path);
+
+    /**
+     * @brief Builds a table of the recorded commands grouped by program and subcommand
+     * @return A string with one line per group sorted by the total time spent
+     */
+    QString summary() const;
+
+    /**
+     * @brief Returns the number of microseconds since the tracer was created
+     */
+    qint64 timestamp() const { return m_timer.nsecsElapsed() / 1000; }
+
+    /**
+     * @brief Writes the recorded events to the output path
+     * @return true on success, false if the file could not be written
+     */
+    bool write() const;
+
+  private:
+    Tracer();
+    ~Tracer();
+    // Delete the copy constructor and the assignment operator
+    Tracer(Tracer const &) = delete;
+    void operator=(Tracer const &) = delete;
+
+    std::atomic<bool> m_isEnabled{false};
+    mutable QMutex m_mutex;
+    QString m_outputPath;
+    QElapsedTimer m_timer;
+    QVector<TraceEvent> m_events;
+};
+
+/**
+ * @brief The TraceSpan class records the time from its construction until it goes out of scope as a span in the "phase" category
+ */
+class TraceSpan {
+  public:
+    explicit TraceSpan(const QString &name) : m_name(name), m_start(Tracer::instance().timestamp()) {}
+    ~TraceSpan() { Tracer::instance().recordSpan(m_name, QStringLiteral("phase"), m_start); }
+    // Delete the copy constructor and the assignment operator
+    TraceSpan(TraceSpan const &) = delete;
+    void operator=(TraceSpan const &) = delete;
+
+  private:
+    QString m_name;
+    qint64 m_start;
+};
+
+#endif // TRACER_H